@@ -4,6 +4,7 @@
  * Change Logs:
  * Date          Author       Notes
  * 2023-1-4      tzy          first implementation
+ * 2026-10-16    tzy          port mutex type for the outbound scheduler locks
  */
 
 #ifndef __WEBSOCKET_H__
@@ -14,9 +15,19 @@
 
 #ifdef _WIN32
 #include <winsock2.h>
+#include <windows.h>
+struct iovec
+{
+    void *iov_base;
+    size_t iov_len;
+};
+typedef SRWLOCK ws_mutex_t;
 #else
 #include <netdb.h>
+#include <pthread.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+typedef pthread_mutex_t ws_mutex_t;
 #endif
 
 #ifdef __cplusplus
@@ -26,6 +37,12 @@ extern "C"
 
 #define ws_log      printf
 
+/* control frames waiting for the data frame on the wire to finish */
+#ifndef WEBSOCKET_CONTROL_QUEUE_MAX
+#define WEBSOCKET_CONTROL_QUEUE_MAX         (4)
+#endif
+#define WEBSOCKET_CONTROL_FRAME_MAX         (6 + 125)
+
 enum WEBSOCKET_STATUS
 {
     WEBSOCKET_OK,
@@ -40,7 +57,9 @@ enum WEBSOCKET_STATUS
     WEBSOCKET_CONNECT_FAILED,
     WEBSOCKET_DISCONNECT,
     WEBSOCKET_NOTSUPPORT_WEBSOCKET,
-    WEBSOCKET_NOTSUPPORT_SUBPROTOCOL
+    WEBSOCKET_NOTSUPPORT_SUBPROTOCOL,
+    WEBSOCKET_AGAIN,
+    WEBSOCKET_INVALID_UTF8
 };
 
 typedef enum  websocket_status_code
@@ -88,6 +107,56 @@ struct websocket_frame_info
     uint32_t is_slice;
 };
 
+/* socket tuning applied at connect time, a zero field keeps the system default */
+struct websocket_socket_options
+{
+    int nodelay;            /* TCP_NODELAY */
+    int cork;               /* TCP_CORK around fragmented and multi-chunk writes */
+    int quickack;           /* TCP_QUICKACK, re-armed after every read */
+    int sndbuf;             /* SO_SNDBUF in bytes */
+    int rcvbuf;             /* SO_RCVBUF in bytes */
+    int user_timeout_ms;    /* TCP_USER_TIMEOUT */
+    int keepalive;          /* SO_KEEPALIVE */
+    int keepidle;           /* TCP_KEEPIDLE in seconds */
+    int keepintvl;          /* TCP_KEEPINTVL in seconds */
+    int keepcnt;            /* TCP_KEEPCNT */
+    int timeout_ms;         /* SO_RCVTIMEO and SO_SNDTIMEO */
+};
+
+extern const struct websocket_socket_options websocket_socket_low_latency;
+extern const struct websocket_socket_options websocket_socket_bulk_throughput;
+
+/* permessage-deflate (RFC 7692) offer, it only takes effect when the library is built with zlib */
+struct websocket_deflate_options
+{
+    int enable;
+    int client_max_window_bits;     /* 9..15, 0 offers the parameter without a value (15) */
+    int server_max_window_bits;     /* 9..15, 0 leaves the server window to the server */
+    int client_no_context_takeover; /* reset the compressor after every message */
+    int server_no_context_takeover; /* ask the server to reset its compressor as well */
+    int level;                      /* zlib level 1..9, 0 selects the zlib default */
+    size_t threshold;               /* messages shorter than this are sent uncompressed */
+};
+
+/* an encoded and masked control frame */
+struct websocket_control_frame
+{
+    unsigned char data[WEBSOCKET_CONTROL_FRAME_MAX];
+    unsigned char length;
+    unsigned char opcode;
+};
+
+struct ws_msg
+{
+    const void *data;
+    size_t length;
+    websocket_frame_type_t type;
+};
+
+struct websocket_parser;
+struct websocket_parser_callback;
+struct websocket_deflate;
+
 struct websocket_session
 {
     int socket_fd;
@@ -99,17 +168,71 @@ struct websocket_session
     unsigned char key[36];
     struct websocket_frame_info info;
     void *tls_session;
+    char *recv_buf;
+    size_t recv_buf_len;
+    size_t recv_pos;
+    size_t recv_end;
+    struct websocket_parser *parser;
+    struct websocket_socket_options sockopt;
+    int corked;
+    struct websocket_deflate_options deflate_opt;
+    struct websocket_deflate *deflate;
+    int utf8_validate;
+    size_t max_frame_payload;
+    /* outbound scheduler: tx_lock is held while a frame goes out, control frames that arrive
+     * meanwhile wait in control[] and are sent at the next frame boundary */
+    struct websocket_control_frame control[WEBSOCKET_CONTROL_QUEUE_MAX];
+    int control_count;
+    int close_sent;
+    /* optional transmit sink that replaces send() on plain sockets, e.g. a queue drained elsewhere */
+    int (*send_to)(void *ctx, const void *buf, size_t len, int flags);
+    void *send_ctx;
+    /* the locks stay last: websocket_disconnect resets every field in front of them. data_lock is
+     * held by a data message from its first frame to its last, so the fragments of two messages never
+     * interleave; only control frames go out between them. The slices of a websocket_write_slice
+     * message are separate calls, they have to come from one writer in order. */
+    ws_mutex_t data_lock;
+    ws_mutex_t tx_lock;
+    ws_mutex_t control_lock;
 };
 
+/* init once before the first use of a session, deinit after its last websocket_disconnect */
 int websocket_session_init(struct websocket_session *session);
+void websocket_session_deinit(struct websocket_session *session);
 int websocket_connect(struct websocket_session *session, const char *url, const char *subprotocol);
 int websocket_disconnect(struct websocket_session *session);
 int websocket_write(struct websocket_session *session, const void *buf, size_t length, websocket_frame_type_t opcode);
+int websocket_writev(struct websocket_session *session, const struct iovec *iov, int iovcnt, websocket_frame_type_t opcode);
+int websocket_write_batch(struct websocket_session *session, const struct ws_msg *msgs, size_t n);
 int websocket_write_slice(struct websocket_session *session, const void *buf, size_t length, websocket_frame_type_t opcode, websocket_slice_t slice_type);
 int websocket_read(struct websocket_session *session, void *buf, size_t length);
+/*
+ * Zero-copy receive. websocket_peek exposes the payload bytes of the current frame that sit in the
+ * read-ahead buffer (reading a frame header or one chunk from the socket if there are none) and
+ * websocket_consume releases them. The pointer is valid until the next call that reads from the session.
+ */
+int websocket_peek(struct websocket_session *session, const void **data, size_t *length);
+int websocket_consume(struct websocket_session *session, size_t length);
 int websocket_get_block_info(struct websocket_session *session);
 int websocket_get_block_info_raw(struct websocket_session *session);
+int websocket_recv_pending(struct websocket_session *session);
+int websocket_feed(struct websocket_session *session, const struct websocket_parser_callback *cb, void *ctx);
+/*
+ * Run the parser over bytes that were received elsewhere, e.g. io_uring provided buffers, without
+ * copying them. Read-ahead bytes are fed with websocket_feed first. Returns the bytes consumed,
+ * fewer than `length` once a callback returns > 0. websocket_recv_release drops the empty
+ * read-ahead buffer of a session that is only fed this way.
+ */
+int websocket_feed_buffer(struct websocket_session *session, const struct websocket_parser_callback *cb, void *ctx, const void *data, size_t length);
+int websocket_recv_release(struct websocket_session *session);
 int websocket_set_timeout(struct websocket_session *session, int second);
+int websocket_set_timeout_ms(struct websocket_session *session, int millisecond);
+int websocket_set_socket_options(struct websocket_session *session, const struct websocket_socket_options *options);
+int websocket_set_utf8_validation(struct websocket_session *session, int enable);
+int websocket_set_deflate(struct websocket_session *session, const struct websocket_deflate_options *options);
+/* split outgoing messages into frames of at most `size` payload bytes, 0 sends every message as one frame */
+int websocket_set_max_frame_payload(struct websocket_session *session, size_t size);
+int websocket_set_cache_size(struct websocket_session *session, size_t size);
 int websocket_header_fields_add(struct websocket_session *session, const char *fmt, ...);
 
 /* control frame api */
@@ -126,7 +249,17 @@ void *ws_memcpy(void *dst, const void *src, size_t count);
 int ws_base64_encode(unsigned char *dst, int *dlen, unsigned char *src, int slen);
 void ws_sha1(unsigned char *input, size_t ilen, unsigned char output[20]);
 void ws_srand_key(unsigned char *buf, int len);
+/* fill buf from the system entropy source, returns 0 or -1 when there is none */
+int ws_entropy(void *buf, size_t len);
 void *ws_memmove(void *dest, const void *src, size_t n);
+/* monotonic clock in milliseconds */
+uint64_t ws_tick_ms(void);
+void ws_mutex_init(ws_mutex_t *mutex);
+void ws_mutex_destroy(ws_mutex_t *mutex);
+void ws_mutex_lock(ws_mutex_t *mutex);
+/* returns 0 when the mutex was taken */
+int ws_mutex_trylock(ws_mutex_t *mutex);
+void ws_mutex_unlock(ws_mutex_t *mutex);
 
 #ifdef __cplusplus
 }
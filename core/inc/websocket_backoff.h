@@ -0,0 +1,58 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date          Author       Notes
+ * 2026-10-16    tzy          first implementation
+ */
+
+#ifndef __WEBSOCKET_BACKOFF_H__
+#define __WEBSOCKET_BACKOFF_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ * Exponential backoff with full jitter. Attempt n waits a random time between 0 and
+ * min(max_ms, base_ms * 2^n), so a crowd of clients that failed together spreads out.
+ */
+struct websocket_backoff
+{
+    uint32_t base_ms;       /* 0 never retries */
+    uint32_t max_ms;        /* 0 leaves the bound uncapped */
+    int max_attempts;       /* give up after this many attempts in a row, 0 never does */
+    int attempt;            /* attempts since the last reset */
+};
+
+/* the bound of the next attempt, min(max_ms, base_ms * 2^attempt) */
+uint32_t websocket_backoff_bound(const struct websocket_backoff *backoff);
+/* anywhere between 0 and bound, both included */
+uint32_t websocket_backoff_jitter(uint32_t bound);
+/* count an attempt and return its delay, -1 when retrying is off or the attempts are used up */
+int64_t websocket_backoff_next(struct websocket_backoff *backoff);
+
+static __inline void websocket_backoff_reset(struct websocket_backoff *backoff)
+{
+    backoff->attempt = 0;
+}
+
+/* attempts that may run at the same time across every user of the limit, any thread */
+struct websocket_backoff_limit
+{
+    int limit;
+    int active;
+};
+
+/* 1 with a slot taken, 0 when all of them are in use */
+int websocket_backoff_acquire(struct websocket_backoff_limit *limit);
+void websocket_backoff_release(struct websocket_backoff_limit *limit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__WEBSOCKET_BACKOFF_H__
@@ -0,0 +1,73 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date          Author       Notes
+ * 2026-10-16    tzy          first implementation
+ * 2026-10-16    tzy          compress into bounded chunks
+ */
+
+#ifndef __WEBSOCKET_DEFLATE_H__
+#define __WEBSOCKET_DEFLATE_H__
+
+#include "websocket.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#ifndef WEBSOCKET_DEFLATE_CHUNK_SIZE
+#define WEBSOCKET_DEFLATE_CHUNK_SIZE        (4096)
+#endif
+
+/* compressed output is handed out in chunks of at most this many bytes, each one leaves as a frame */
+#ifndef WEBSOCKET_DEFLATE_OUT_SIZE
+#define WEBSOCKET_DEFLATE_OUT_SIZE          (16384)
+#endif
+
+/* RSV1 as it is seen by the parser (the three RSV bits shifted down) */
+#define WEBSOCKET_DEFLATE_RSV               (0x04)
+
+/*
+ * permessage-deflate (RFC 7692) state of one connection. It only exists once the server
+ * accepted the offer, so session->deflate != NULL means every data message may be
+ * compressed. The layout is private to websocket_deflate.c.
+ */
+struct websocket_deflate;
+
+/* append the offer for `options` to the handshake, returns the length written or -1 */
+int websocket_deflate_offer(const struct websocket_deflate_options *options, char *buf, int size);
+/* parse the server's answer and create the compression state */
+int websocket_deflate_accept(struct websocket_session *session, const char *value);
+void websocket_deflate_free(struct websocket_deflate *deflate);
+
+/*
+ * Compress the next part of an outgoing message, `fin` ends the message. begin hands the part over
+ * (`iov` must stay valid until its last chunk is out) and returns WEBSOCKET_OK, or 1 when the message
+ * is below the threshold and has to go out uncompressed (only decided on the first part of a message).
+ * next then fills `out` with the next chunk of at most WEBSOCKET_DEFLATE_OUT_SIZE bytes, valid until
+ * the following call, and returns 1 while more chunks of the part follow, 0 for its last chunk, or a
+ * negative error. Memory use stays at one chunk whatever the size of the message.
+ */
+int websocket_deflate_begin(struct websocket_deflate *deflate, const struct iovec *iov, int iovcnt, int fin);
+int websocket_deflate_next(struct websocket_deflate *deflate, struct iovec *out);
+
+/*
+ * Incoming messages: begin starts a compressed message, push hands it payload bytes (they must stay
+ * valid until pull returns 0), finish marks the end of the message. pull inflates into `buf` and
+ * returns the bytes produced, 0 once it needs more input or the message is over.
+ */
+void websocket_inflate_begin(struct websocket_deflate *deflate);
+void websocket_inflate_push(struct websocket_deflate *deflate, const void *data, size_t length);
+void websocket_inflate_finish(struct websocket_deflate *deflate);
+int websocket_inflate_pull(struct websocket_deflate *deflate, void *buf, size_t length);
+int websocket_inflate_active(const struct websocket_deflate *deflate);
+/* scratch area of WEBSOCKET_DEFLATE_CHUNK_SIZE bytes owned by the state */
+char *websocket_inflate_chunk(struct websocket_deflate *deflate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__WEBSOCKET_DEFLATE_H__
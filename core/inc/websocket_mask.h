@@ -0,0 +1,49 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date          Author       Notes
+ * 2026-10-16    tzy          first implementation
+ */
+
+#ifndef __WEBSOCKET_MASK_H__
+#define __WEBSOCKET_MASK_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef enum websocket_mask_kernel
+{
+    WEBSOCKET_MASK_KERNEL_AUTO = 0,
+    WEBSOCKET_MASK_KERNEL_SCALAR,
+    WEBSOCKET_MASK_KERNEL_SSE2,
+    WEBSOCKET_MASK_KERNEL_AVX2,
+    WEBSOCKET_MASK_KERNEL_AVX512,
+    WEBSOCKET_MASK_KERNEL_NEON,
+    WEBSOCKET_MASK_KERNEL_MAX
+} websocket_mask_kernel_t;
+
+/*
+ * XOR `length` bytes of `src` with the 4-byte masking key and store them to `dst`.
+ * `offset` is the mask phase of the first byte (the payload position modulo 4), so a
+ * payload can be masked in several calls. Returns the phase for the next call.
+ * `dst` and `src` may be the same buffer; neither has to be aligned.
+ */
+size_t websocket_mask(void *dst, const void *src, size_t length, const unsigned char mask_key[4], size_t offset);
+
+/* kernel dispatch, the best supported kernel is picked on first use */
+int websocket_mask_kernel_supported(websocket_mask_kernel_t kernel);
+int websocket_mask_kernel_select(websocket_mask_kernel_t kernel);
+websocket_mask_kernel_t websocket_mask_kernel_current(void);
+const char *websocket_mask_kernel_name(websocket_mask_kernel_t kernel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__WEBSOCKET_MASK_H__
@@ -0,0 +1,90 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date          Author       Notes
+ * 2026-10-16    tzy          first implementation
+ */
+
+#ifndef __WEBSOCKET_MPSC_H__
+#define __WEBSOCKET_MPSC_H__
+
+#include <stddef.h>
+
+/*
+ * Intrusive multi-producer single-consumer queue (Vyukov). Any thread may push, only the owner
+ * pops. A push is one atomic exchange and never waits for other producers or the consumer.
+ */
+typedef struct ws_mpsc_node
+{
+    struct ws_mpsc_node *next;
+} ws_mpsc_node_t;
+
+typedef struct ws_mpsc
+{
+    ws_mpsc_node_t *head;       /* last pushed, shared by the producers */
+    ws_mpsc_node_t *tail;       /* next to pop, owned by the consumer */
+    ws_mpsc_node_t stub;
+} ws_mpsc_t;
+
+static __inline void ws_mpsc_init(ws_mpsc_t *q)
+{
+    q->stub.next = NULL;
+    q->head = q->tail = &q->stub;
+}
+
+static __inline void ws_mpsc_push(ws_mpsc_t *q, ws_mpsc_node_t *n)
+{
+    ws_mpsc_node_t *prev;
+
+    __atomic_store_n(&n->next, NULL, __ATOMIC_RELAXED);
+    prev = __atomic_exchange_n(&q->head, n, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, n, __ATOMIC_RELEASE);
+}
+
+/* NULL when empty, or when a producer is half way through a push, ws_mpsc_empty tells the two apart */
+static __inline ws_mpsc_node_t *ws_mpsc_pop(ws_mpsc_t *q)
+{
+    ws_mpsc_node_t *tail = q->tail;
+    ws_mpsc_node_t *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    if (tail == &q->stub)
+    {
+        if (next == NULL)
+        {
+            return NULL;
+        }
+        q->tail = next;
+        tail = next;
+        next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+    }
+
+    if (next)
+    {
+        q->tail = next;
+        return tail;
+    }
+
+    if (tail != __atomic_load_n(&q->head, __ATOMIC_ACQUIRE))
+    {
+        return NULL;
+    }
+
+    ws_mpsc_push(q, &q->stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (next)
+    {
+        q->tail = next;
+        return tail;
+    }
+
+    return NULL;
+}
+
+/* consumer side only */
+static __inline int ws_mpsc_empty(ws_mpsc_t *q)
+{
+    return q->tail == &q->stub && __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) == &q->stub;
+}
+
+#endif //__WEBSOCKET_MPSC_H__
@@ -0,0 +1,79 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date          Author       Notes
+ * 2026-10-16    tzy          first implementation
+ */
+
+#ifndef __WEBSOCKET_PARSER_H__
+#define __WEBSOCKET_PARSER_H__
+
+#include "websocket.h"
+#include "websocket_utf8.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+enum WEBSOCKET_PARSER_STATE
+{
+    WEBSOCKET_PARSER_HEAD = 0,
+    WEBSOCKET_PARSER_LENGTH,
+    WEBSOCKET_PARSER_PAYLOAD
+};
+
+/*
+ * Push parser for server-to-client frames. It does no I/O: bytes are fed in whatever
+ * pieces the transport delivers and the state is kept between calls, so a frame split
+ * across any number of reads is parsed exactly as if it arrived in one.
+ */
+struct websocket_parser
+{
+    int state;
+    unsigned char head[10];
+    size_t head_have;
+    size_t head_need;
+    unsigned char fin;
+    unsigned char rsv;
+    unsigned char rsv_allowed;
+    unsigned char in_message;
+    unsigned char message_rsv;
+    unsigned char validate_utf8;
+    websocket_frame_type_t message_type;
+    struct websocket_frame_info info;
+    struct websocket_utf8 utf8;
+};
+
+/* text messages are checked by the parser when validate_utf8 is set, compressed ones by whoever inflates them */
+static __inline int websocket_parser_check_utf8(const struct websocket_parser *parser)
+{
+    return parser->validate_utf8 && parser->message_type == WEBSOCKET_TEXT_FRAME;
+}
+
+/*
+ * A callback returns 0 to go on, a positive value to pause the parser right after the
+ * event (websocket_parser_execute returns the bytes consumed so far) or a negative
+ * error code to abort. Any callback may be NULL.
+ */
+struct websocket_parser_callback
+{
+    int (*on_frame_head)(struct websocket_parser *parser, void *ctx);
+    int (*on_frame_data)(struct websocket_parser *parser, void *ctx, const char *data, size_t length);
+    int (*on_frame_end)(struct websocket_parser *parser, void *ctx);
+};
+
+void websocket_parser_init(struct websocket_parser *parser);
+int websocket_parser_execute(struct websocket_parser *parser, const struct websocket_parser_callback *cb, void *ctx, const void *data, size_t length);
+
+static __inline int websocket_parser_is_control(websocket_frame_type_t type)
+{
+    return (type & 0x08) != 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__WEBSOCKET_PARSER_H__
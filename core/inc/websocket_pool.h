@@ -0,0 +1,48 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date          Author       Notes
+ * 2026-10-16    tzy          first implementation
+ */
+
+#ifndef __WEBSOCKET_POOL_H__
+#define __WEBSOCKET_POOL_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* buffers come in power-of-two classes, the smallest one is 1 << WEBSOCKET_POOL_MIN_SHIFT */
+#define WEBSOCKET_POOL_MIN_SHIFT            (8)
+#define WEBSOCKET_POOL_CLASSES              (24)
+
+/*
+ * Free buffers of one owner, a list per size class linked through the first word of each buffer.
+ * A request is rounded up to its class, so a buffer that comes back serves any later request of
+ * the same class. There is no lock, one pool belongs to one thread.
+ */
+struct websocket_pool
+{
+    void *free[WEBSOCKET_POOL_CLASSES];
+    int count[WEBSOCKET_POOL_CLASSES];
+    int keep;                           /* free buffers kept per class, the heap gets the rest */
+    int borrowed;                       /* handed out and not put back yet */
+};
+
+void websocket_pool_init(struct websocket_pool *pool, int keep);
+/* a buffer of at least size bytes, *length is the size of its class; NULL above the largest class */
+void *websocket_pool_get(struct websocket_pool *pool, size_t size, size_t *length);
+/* length is the one websocket_pool_get reported, a NULL buffer is ignored */
+void websocket_pool_put(struct websocket_pool *pool, void *buf, size_t length);
+/* free the kept buffers, every borrowed one must be back */
+void websocket_pool_clear(struct websocket_pool *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__WEBSOCKET_POOL_H__
@@ -0,0 +1,42 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date          Author       Notes
+ * 2026-10-16    tzy          first implementation
+ */
+
+#ifndef __WEBSOCKET_RANDOM_H__
+#define __WEBSOCKET_RANDOM_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* ChaCha20 blocks generated per refill, the first 32 bytes of a refill become the next key */
+#ifndef WEBSOCKET_RANDOM_POOL_BLOCKS
+#define WEBSOCKET_RANDOM_POOL_BLOCKS        (8)
+#endif
+
+/*
+ * Per-thread ChaCha20 generator for mask keys and handshake nonces. Each thread is seeded once
+ * from ws_entropy(), after that bytes are served from a pool that is refilled a batch of blocks
+ * at a time (fast key erasure, the old key never survives a refill). A forked child reseeds
+ * before its first use.
+ */
+void websocket_random_bytes(void *buf, size_t length);
+/* drop the state of the calling thread, the next call seeds again */
+void websocket_random_reseed(void);
+
+/* RFC 8439 block function, exported for the test vectors */
+void websocket_chacha20_block(const uint32_t key[8], uint32_t counter, const uint32_t nonce[3], uint32_t out[16]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__WEBSOCKET_RANDOM_H__
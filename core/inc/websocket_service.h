@@ -4,6 +4,7 @@
  * Change Logs:
  * Date          Author       Notes
  * 2023-7-3      tzy          first implementation
+ * 2026-10-16    tzy          workers and engines, timeouts, reconnect, watermarks, iov reads and onfragment
  */
 
 #ifndef __WEBSOCKET_SERVICE_H__
@@ -28,6 +29,66 @@ extern "C"
 #define WEBSOCKET_SERVICE_CACHE_SIZE_MAX            (1024*8)
 #endif
 
+/* messages above WEBSOCKET_SERVICE_CACHE_SIZE_MAX are assembled in segments of this size, a power of two */
+#ifndef WEBSOCKET_SERVICE_SEGMENT_SIZE
+#define WEBSOCKET_SERVICE_SEGMENT_SIZE          (64*1024)
+#endif
+
+/* free receive buffers a worker keeps per size class, sessions borrow one only while a message is assembled */
+#ifndef WEBSOCKET_SERVICE_POOL_KEEP
+#define WEBSOCKET_SERVICE_POOL_KEEP             (64)
+#endif
+
+#ifndef WEBSOCKET_SERVICE_BATCH_MAX
+#define WEBSOCKET_SERVICE_BATCH_MAX            (64)
+#endif
+
+/* default timeouts, see app_websocket_set_timeouts */
+#ifndef WEBSOCKET_SERVICE_HANDSHAKE_TIMEOUT_MS
+#define WEBSOCKET_SERVICE_HANDSHAKE_TIMEOUT_MS  (10000)
+#endif
+
+#ifndef WEBSOCKET_SERVICE_IDLE_TIMEOUT_MS
+#define WEBSOCKET_SERVICE_IDLE_TIMEOUT_MS       (0)
+#endif
+
+#ifndef WEBSOCKET_SERVICE_CLOSE_TIMEOUT_MS
+#define WEBSOCKET_SERVICE_CLOSE_TIMEOUT_MS      (3000)
+#endif
+
+/* reconnect attempts of all sessions that may run at the same time, see app_websocket_set_reconnect_limit */
+#ifndef WEBSOCKET_SERVICE_RECONNECT_LIMIT
+#define WEBSOCKET_SERVICE_RECONNECT_LIMIT       (4)
+#endif
+
+/* default write watermarks, see app_websocket_set_watermarks */
+#ifndef WEBSOCKET_SERVICE_WRITE_HIGH_WATERMARK
+#define WEBSOCKET_SERVICE_WRITE_HIGH_WATERMARK (1024*1024)
+#endif
+
+#ifndef WEBSOCKET_SERVICE_WRITE_LOW_WATERMARK
+#define WEBSOCKET_SERVICE_WRITE_LOW_WATERMARK  (256*1024)
+#endif
+
+/* bytes the worker writes for one session before it turns to the others, a large queued message
+ * goes out over several turns of the worker */
+#ifndef WEBSOCKET_SERVICE_WRITE_BUDGET
+#define WEBSOCKET_SERVICE_WRITE_BUDGET         (256*1024)
+#endif
+
+/* provided receive buffers of an io_uring worker, the count must be a power of two */
+#ifndef WEBSOCKET_SERVICE_URING_BUFFERS
+#define WEBSOCKET_SERVICE_URING_BUFFERS        (512)
+#endif
+
+#ifndef WEBSOCKET_SERVICE_URING_BUFFER_SIZE
+#define WEBSOCKET_SERVICE_URING_BUFFER_SIZE    (4096)
+#endif
+
+#ifndef WEBSOCKET_SERVICE_URING_ENTRIES
+#define WEBSOCKET_SERVICE_URING_ENTRIES        (256)
+#endif
+
 #define WEBSOCKET_MALLOC     malloc
 #define WEBSOCKET_CALLOC     calloc
 #define WEBSOCKET_REALLOC    realloc
@@ -36,6 +97,7 @@ extern "C"
 #define WEBSOCKET_MEMSET     memset
 
 struct websocket;
+struct websocket_worker;
 struct app_websocket
 {
     struct websocket *websocket_session;
@@ -48,26 +110,132 @@ struct app_websocket_frame
     websocket_frame_type_t type;
 };
 
+struct app_websocket_iovec
+{
+    void *data;
+    size_t length;
+};
+
+struct app_websocket_timeouts
+{
+    uint32_t handshake_ms;  /* each read and write of the opening handshake, 0 waits forever */
+    uint32_t idle_ms;       /* nothing received for this long fails the connection, 0 never does */
+    uint32_t close_ms;      /* wait for the server to answer our close frame, 0 drops the connection at once */
+};
+
+/*
+ * A session that fails, or that the server closes with 1001, 1011, 1012 or 1013, connects again
+ * with the same url, subprotocol and headers. Attempt n waits a random time between 0 and
+ * min(max_ms, base_ms * 2^n), onopen resets n. Once max_attempts run out the session closes:
+ * onclose fires and app_websocket_get_close_reason reports WEBSOCKET_STATUS_CLOSE_ABNORMAL.
+ */
+struct app_websocket_reconnect
+{
+    uint32_t base_ms;       /* 0 never reconnects */
+    uint32_t max_ms;
+    int max_attempts;       /* give up after this many failures in a row, 0 never does */
+};
+
+typedef enum app_websocket_worker_policy
+{
+    APP_WEBSOCKET_WORKER_ROUND_ROBIN = 0,
+    APP_WEBSOCKET_WORKER_LEAST_LOADED
+} app_websocket_worker_policy_t;
+
+typedef enum app_websocket_engine
+{
+    APP_WEBSOCKET_ENGINE_DEFAULT = 0,   /* epoll on linux, poll elsewhere */
+    APP_WEBSOCKET_ENGINE_IO_URING       /* falls back to the default if the kernel has no io_uring */
+} app_websocket_engine_t;
+
+struct app_websocket_worker_config
+{
+    int cpu;            /* pin the worker thread to this cpu, -1 leaves it to the scheduler */
+    app_websocket_engine_t engine;
+};
+
+/* picks the worker of a session on its first connect, NULL falls back to the policy */
+typedef struct websocket_worker *(*app_websocket_worker_select_t)(struct app_websocket *ws, void *userdata);
+
+/* app_websocket_worker_init starts one default worker, more can be added with app_websocket_worker_create */
 int app_websocket_worker_init(void);
 int app_websocket_worker_deinit(void);
+struct websocket_worker *app_websocket_worker_create(const struct app_websocket_worker_config *cfg);
+/*
+ * Fails with -WEBSOCKET_AGAIN while sessions are still placed on the worker. Sessions leave it once
+ * they are disconnected and freed, or deinitialized before their first connect.
+ */
+int app_websocket_worker_destroy(struct websocket_worker *worker);
+/* sessions placed on the worker */
+int app_websocket_worker_load(struct websocket_worker *worker);
+/* the engine the worker actually runs on */
+app_websocket_engine_t app_websocket_worker_engine(struct websocket_worker *worker);
+int app_websocket_set_worker_policy(app_websocket_worker_policy_t policy);
+int app_websocket_set_worker_select(app_websocket_worker_select_t select, void *userdata);
+/* pin a session to a worker, before its first connect */
+int app_websocket_set_worker(struct app_websocket *ws, struct websocket_worker *worker);
 int app_websocket_init(struct app_websocket *ws);
 void app_websocket_deinit(struct app_websocket *ws);
 int app_websocket_set_url(struct app_websocket *ws, const char *url);
 int app_websocket_set_subprotocol(struct app_websocket *ws, const char *subprotocol);
 int app_websocket_add_header(struct app_websocket *ws, const char *key, const char *value);
+int app_websocket_set_cache_size(struct app_websocket *ws, size_t size);
+int app_websocket_set_socket_options(struct app_websocket *ws, const struct websocket_socket_options *options);
+int app_websocket_set_deflate(struct app_websocket *ws, const struct websocket_deflate_options *options);
+int app_websocket_set_utf8_validation(struct app_websocket *ws, int enable);
+int app_websocket_set_max_frame_payload(struct app_websocket *ws, size_t size);
+/*
+ * Accept messages up to `size` bytes (default and minimum WEBSOCKET_SERVICE_CACHE_SIZE_MAX). A message
+ * that does not fit WEBSOCKET_SERVICE_CACHE_SIZE_MAX is assembled in a chain of segments, never in one
+ * buffer, and can only be read with app_websocket_read_iov.
+ */
+int app_websocket_set_max_message_size(struct app_websocket *ws, size_t size);
+int app_websocket_set_timeouts(struct app_websocket *ws, const struct app_websocket_timeouts *timeouts);
+/* may be called from any thread, a callback included; it takes effect at the next failure */
+int app_websocket_set_reconnect(struct app_websocket *ws, const struct app_websocket_reconnect *reconnect);
+/* an attempt that finds the limit reached waits another random interval, it does not count as a failure */
+int app_websocket_set_reconnect_limit(int limit);
+/*
+ * Once more than `high` bytes wait to be written, app_websocket_write_data and
+ * app_websocket_write_batch return -WEBSOCKET_AGAIN without writing anything. The drain event
+ * fires when the queue is back down to `low`. A high watermark of 0 never refuses.
+ * TLS sessions write on the calling thread and queue nothing, they are never refused and never drain.
+ */
+int app_websocket_set_watermarks(struct app_websocket *ws, size_t high, size_t low);
+/* bytes accepted by the write calls that have not reached the socket yet, always 0 on TLS */
+size_t app_websocket_buffered_amount(struct app_websocket *ws);
 int app_websocket_set_close_reason(struct app_websocket *websocket, websocket_status_code_t code, const char *reason);
 int app_websocket_get_close_reason(struct app_websocket *websocket, websocket_status_code_t *code, const char **reason);
+/* why the connection failed, e.g. "Idle timeout!!"; read it in onerror */
+int app_websocket_get_error_reason(struct app_websocket *websocket, const char **reason);
 
 int app_websocket_connect_server(struct app_websocket *ws);
 int app_websocket_disconnect_server(struct app_websocket *ws);
+/* run the close handshake, onclose fires and the handle stays valid for another connect */
+int app_websocket_close_server(struct app_websocket *ws);
 int app_websocket_read_data(struct app_websocket *ws, struct app_websocket_frame *frame);
+/* any message as a list of buffers, valid until onmessage returns; returns the message length */
+int app_websocket_read_iov(struct app_websocket *ws, const struct app_websocket_iovec **iov, int *iovcnt, websocket_frame_type_t *type);
+/*
+ * Any thread may write. On a plain socket whatever the socket does not take right away waits in the
+ * session's outbound queue and the worker sends it, so a write never blocks. TLS sockets stay blocking:
+ * mbedtls writes the record on the calling thread and nothing is queued. Returns the bytes written.
+ */
 int app_websocket_write_data(struct app_websocket *ws, struct app_websocket_frame *frame);
+int app_websocket_write_batch(struct app_websocket *ws, const struct app_websocket_frame *frames, size_t n);
 
 /* event notify */
 void app_websocket_message_event(struct app_websocket *ws, int (*onmessage)(struct app_websocket *ws));
 void app_websocket_open_event(struct app_websocket *ws, int (*onopen)(struct app_websocket *ws));
 void app_websocket_close_event(struct app_websocket *ws, int (*onclose)(struct app_websocket *ws));
 void app_websocket_error_event(struct app_websocket *ws, int (*onerror)(struct app_websocket *ws));
+void app_websocket_drain_event(struct app_websocket *ws, int (*ondrain)(struct app_websocket *ws));
+/*
+ * With onfragment set, payload is handed over as it arrives and onmessage never fires. The last
+ * call of a message has is_final set, it may carry no data. Text is UTF-8 checked on the way, a
+ * message that turns out invalid fails the connection after its earlier fragments were delivered.
+ */
+void app_websocket_fragment_event(struct app_websocket *ws, int (*onfragment)(struct app_websocket *ws, const void *data, size_t len, int is_final, websocket_frame_type_t type));
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,75 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date          Author       Notes
+ * 2026-10-16    tzy          first implementation
+ */
+
+#ifndef __WEBSOCKET_TIMER_H__
+#define __WEBSOCKET_TIMER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "websocket_list.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* resolution of the wheel, a timer fires at most two ticks after its timeout */
+#ifndef WEBSOCKET_TIMER_TICK_MS
+#define WEBSOCKET_TIMER_TICK_MS             (10)
+#endif
+
+#define WEBSOCKET_TIMER_LEVEL_BITS          (6)
+#define WEBSOCKET_TIMER_LEVEL_SLOTS         (1 << WEBSOCKET_TIMER_LEVEL_BITS)
+#define WEBSOCKET_TIMER_LEVELS              (4)
+
+struct websocket_timer;
+typedef void (*websocket_timer_handler_t)(struct websocket_timer *timer, void *ctx);
+
+/* embedded in its owner, the wheel never allocates */
+struct websocket_timer
+{
+    ws_list_t node;                     /* on a wheel slot while armed */
+    uint64_t expire;                    /* wheel tick */
+    websocket_timer_handler_t handler;
+};
+
+/*
+ * Hierarchical timing wheel: four levels of 64 slots, each level counting in steps of 64 ticks of
+ * the level below (0.64s, 41s, 44min and 46h at 10ms ticks). Arm and cancel are O(1) list
+ * operations. Level 0 fires as the wheel turns, a higher slot is poured into the levels below
+ * when the one under it wraps. One wheel belongs to one thread.
+ */
+struct websocket_timer_wheel
+{
+    uint64_t base_ms;                   /* clock at tick 0 */
+    uint64_t tick;                      /* every tick up to this one has fired */
+    unsigned int count;                 /* armed timers */
+    ws_list_t slots[WEBSOCKET_TIMER_LEVELS][WEBSOCKET_TIMER_LEVEL_SLOTS];
+};
+
+void websocket_timer_wheel_init(struct websocket_timer_wheel *wheel, uint64_t now_ms);
+/* run the handler of every timer due at now_ms, ctx is passed through; returns how many fired */
+int websocket_timer_wheel_advance(struct websocket_timer_wheel *wheel, uint64_t now_ms, void *ctx);
+/* how long the owner may sleep before the next advance, -1 when nothing is armed */
+int websocket_timer_wheel_timeout(const struct websocket_timer_wheel *wheel, uint64_t now_ms);
+
+void websocket_timer_init(struct websocket_timer *timer, websocket_timer_handler_t handler);
+/* (re)arm the timer, timeouts beyond the last level are cut to its range */
+void websocket_timer_arm(struct websocket_timer_wheel *wheel, struct websocket_timer *timer, uint32_t timeout_ms);
+void websocket_timer_cancel(struct websocket_timer_wheel *wheel, struct websocket_timer *timer);
+
+static __inline int websocket_timer_armed(const struct websocket_timer *timer)
+{
+    return timer->node.next != &timer->node;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__WEBSOCKET_TIMER_H__
@@ -0,0 +1,102 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date          Author       Notes
+ * 2026-10-16    tzy          first implementation
+ */
+
+#ifndef __WEBSOCKET_URING_H__
+#define __WEBSOCKET_URING_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+/* an older header lacks what the driver uses; IORING_REGISTER_PBUF_RING is an enum and came a
+ * release before IORING_RECV_MULTISHOT, so the macros vouch for it */
+#if defined(IORING_RECV_MULTISHOT) && defined(IORING_SETUP_COOP_TASKRUN) && defined(IORING_FEAT_EXT_ARG) && \
+    defined(IORING_POLL_ADD_MULTI) && defined(IORING_CQE_F_BUFFER)
+#define WEBSOCKET_USING_IO_URING
+#endif
+#endif
+#endif
+
+#ifdef WEBSOCKET_USING_IO_URING
+#include <sys/socket.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ * Minimal io_uring driver on the raw system calls (no liburing). One ring belongs to one thread:
+ * SQEs are queued with get_sqe, handed to the kernel in one go by enter, and completions are
+ * walked with peek_cqe/cqe_seen. A provided buffer ring lets multishot receives pick their
+ * buffer at completion time, a socket with nothing arriving holds none of them.
+ */
+struct websocket_uring
+{
+    int fd;
+    unsigned int features;
+
+    unsigned int *sq_head;
+    unsigned int *sq_tail;
+    unsigned int sq_mask;
+    unsigned int sq_entries;
+    unsigned int sq_local_tail;
+    struct io_uring_sqe *sqes;
+
+    unsigned int *cq_head;
+    unsigned int *cq_tail;
+    unsigned int cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *ring_ptr;
+    size_t ring_size;
+    size_t sqes_size;
+
+    /* provided buffers */
+    struct io_uring_buf_ring *br;
+    size_t br_size;
+    char *buf_base;
+    unsigned int buf_count;
+    unsigned int buf_size;
+    unsigned short buf_group;
+    unsigned short br_tail;
+};
+
+int websocket_uring_init(struct websocket_uring *ring, unsigned int entries);
+void websocket_uring_exit(struct websocket_uring *ring);
+
+/* NULL once the submission queue is full, enter(ring, 0, 0) makes room */
+struct io_uring_sqe *websocket_uring_get_sqe(struct websocket_uring *ring);
+/* submit the queued SQEs, wait up to timeout_ms for `wait_nr` completions (-1 waits forever) */
+int websocket_uring_enter(struct websocket_uring *ring, unsigned int wait_nr, int timeout_ms);
+struct io_uring_cqe *websocket_uring_peek_cqe(struct websocket_uring *ring);
+void websocket_uring_cqe_seen(struct websocket_uring *ring);
+
+void websocket_uring_prep_recv_multishot(struct io_uring_sqe *sqe, int fd, unsigned short buf_group, uint64_t user_data);
+/* `msg` and its iovecs have to stay valid until the completion */
+void websocket_uring_prep_sendmsg(struct io_uring_sqe *sqe, int fd, const struct msghdr *msg, unsigned int flags, uint64_t user_data);
+void websocket_uring_prep_poll(struct io_uring_sqe *sqe, int fd, unsigned int events, uint64_t user_data);
+void websocket_uring_prep_poll_multishot(struct io_uring_sqe *sqe, int fd, unsigned int events, uint64_t user_data);
+void websocket_uring_prep_cancel(struct io_uring_sqe *sqe, uint64_t target, uint64_t user_data);
+
+/* register `count` (a power of two) buffers of `size` bytes as buffer group `group` */
+int websocket_uring_buffers_init(struct websocket_uring *ring, unsigned int count, unsigned int size, unsigned short group);
+char *websocket_uring_buffer(struct websocket_uring *ring, unsigned short bid);
+/* give a buffer back, it becomes visible to the kernel with the next commit */
+void websocket_uring_buffer_recycle(struct websocket_uring *ring, unsigned short bid);
+void websocket_uring_buffers_commit(struct websocket_uring *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WEBSOCKET_USING_IO_URING */
+
+#endif //__WEBSOCKET_URING_H__
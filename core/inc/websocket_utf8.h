@@ -0,0 +1,61 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date          Author       Notes
+ * 2026-10-16    tzy          first implementation
+ */
+
+#ifndef __WEBSOCKET_UTF8_H__
+#define __WEBSOCKET_UTF8_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef enum websocket_utf8_kernel
+{
+    WEBSOCKET_UTF8_KERNEL_AUTO = 0,
+    WEBSOCKET_UTF8_KERNEL_SCALAR,
+    WEBSOCKET_UTF8_KERNEL_SSSE3,
+    WEBSOCKET_UTF8_KERNEL_AVX2,
+    WEBSOCKET_UTF8_KERNEL_NEON,
+    WEBSOCKET_UTF8_KERNEL_MAX
+} websocket_utf8_kernel_t;
+
+/*
+ * Streaming validator state. A message is fed in any number of pieces; a code point
+ * split between two pieces is carried over in `need`/`lo`/`hi` (the continuation
+ * bytes still missing and the range allowed for the next one).
+ */
+struct websocket_utf8
+{
+    unsigned char need;
+    unsigned char lo;
+    unsigned char hi;
+    unsigned char invalid;
+};
+
+void websocket_utf8_init(struct websocket_utf8 *utf8);
+/* validate the next piece of a message, returns WEBSOCKET_OK or -WEBSOCKET_INVALID_UTF8 */
+int websocket_utf8_update(struct websocket_utf8 *utf8, const void *data, size_t length);
+/* the message is over, a code point left unfinished is an error */
+int websocket_utf8_final(struct websocket_utf8 *utf8);
+/* one-shot check of a complete buffer */
+int websocket_utf8_validate(const void *data, size_t length);
+
+/* kernel dispatch, the best supported kernel is picked on first use */
+int websocket_utf8_kernel_supported(websocket_utf8_kernel_t kernel);
+int websocket_utf8_kernel_select(websocket_utf8_kernel_t kernel);
+websocket_utf8_kernel_t websocket_utf8_kernel_current(void);
+const char *websocket_utf8_kernel_name(websocket_utf8_kernel_t kernel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__WEBSOCKET_UTF8_H__
@@ -4,14 +4,28 @@
  * Change Logs:
  * Date           Author       Notes
  * 2023-1-4      tzy          first implementation
+ * 2026-10-16    tzy          mask keys from the per-thread chacha20 generator
+ * 2026-10-16    tzy          monotonic millisecond clock
+ * 2026-10-16    tzy          mutex
  */
 
 #include "websocket.h"
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "tiny_base64.h"
 #include "tiny_sha1.h"
-#include <time.h>
+#include "websocket_random.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 
 void *ws_malloc(size_t size)
 {
@@ -52,22 +66,126 @@ void ws_sha1(unsigned char *input,
 
 void ws_srand_key(unsigned char *buf, int len)
 {
-    char key_value;
-    srand(time(0));
-    for (int i = 0; i < len; i++)
+    websocket_random_bytes(buf, len);
+}
+
+int ws_entropy(void *buf, size_t len)
+{
+#ifndef _WIN32
+    unsigned char *ptr = (unsigned char *)buf;
+    ssize_t n;
+    int fd;
+
+#ifdef SYS_getrandom
+    while (len > 0)
     {
-        if ((key_value = rand() % 128) > 32)
+        n = syscall(SYS_getrandom, ptr, len, 0);
+        if (n < 0)
         {
-            buf[i] = key_value;
+            if (errno == EINTR)
+                continue;
+            break;
         }
-        else
+        ptr += n;
+        len -= n;
+    }
+
+    if (len == 0)
+        return 0;
+#endif
+
+    /* kernels without getrandom(2) */
+    fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    while (len > 0)
+    {
+        n = read(fd, ptr, len);
+        if (n <= 0)
         {
-            buf[i] = 66;
+            if (n < 0 && errno == EINTR)
+                continue;
+            break;
         }
+        ptr += n;
+        len -= n;
     }
+    close(fd);
+
+    return len == 0 ? 0 : -1;
+#else
+    (void)buf;
+    (void)len;
+    return -1;
+#endif
 }
 
 void *ws_memmove(void *dest, const void *src, size_t n)
 {
     return memmove(dest, src, n);
 }
+
+uint64_t ws_tick_ms(void)
+{
+#ifndef _WIN32
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#else
+    return (uint64_t)clock() * 1000 / CLOCKS_PER_SEC;
+#endif
+}
+
+#ifndef _WIN32
+void ws_mutex_init(ws_mutex_t *mutex)
+{
+    pthread_mutex_init(mutex, NULL);
+}
+
+void ws_mutex_destroy(ws_mutex_t *mutex)
+{
+    pthread_mutex_destroy(mutex);
+}
+
+void ws_mutex_lock(ws_mutex_t *mutex)
+{
+    pthread_mutex_lock(mutex);
+}
+
+int ws_mutex_trylock(ws_mutex_t *mutex)
+{
+    return pthread_mutex_trylock(mutex);
+}
+
+void ws_mutex_unlock(ws_mutex_t *mutex)
+{
+    pthread_mutex_unlock(mutex);
+}
+#else
+void ws_mutex_init(ws_mutex_t *mutex)
+{
+    InitializeSRWLock(mutex);
+}
+
+void ws_mutex_destroy(ws_mutex_t *mutex)
+{
+    (void)mutex;
+}
+
+void ws_mutex_lock(ws_mutex_t *mutex)
+{
+    AcquireSRWLockExclusive(mutex);
+}
+
+int ws_mutex_trylock(ws_mutex_t *mutex)
+{
+    return TryAcquireSRWLockExclusive(mutex) ? 0 : -1;
+}
+
+void ws_mutex_unlock(ws_mutex_t *mutex)
+{
+    ReleaseSRWLockExclusive(mutex);
+}
+#endif
@@ -5,6 +5,21 @@
  * Date          Author       Notes
  * 2023-1-4      tzy          first implementation
  * 2023-6-24     tzy          modify url praser
+ * 2026-10-16    tzy          mask payload with the simd kernels
+ * 2026-10-16    tzy          send frame header and payload in one write
+ * 2026-10-16    tzy          stream large payloads through the cache in chunks
+ * 2026-10-16    tzy          add read-ahead buffer for handshake and frame parsing
+ * 2026-10-16    tzy          parse frames with the resumable push parser
+ * 2026-10-16    tzy          add batched message write
+ * 2026-10-16    tzy          add socket tuning profile
+ * 2026-10-16    tzy          add scatter/gather message write
+ * 2026-10-16    tzy          add permessage-deflate extension
+ * 2026-10-16    tzy          add zero-copy peek/consume receive
+ * 2026-10-16    tzy          add utf-8 validation of text messages
+ * 2026-10-16    tzy          interleave control frames between outgoing data frames
+ * 2026-10-16    tzy          fragment messages above max_frame_payload
+ * 2026-10-16    tzy          retry plain socket reads and writes interrupted by a signal
+ * 2026-10-16    tzy          feed the parser from receive buffers owned by the caller
  */
 #include <sys/time.h>
 #include <stdio.h>
@@ -12,33 +27,31 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdarg.h>
+#include <errno.h>
+#include <strings.h>
+#include <netinet/tcp.h>
 #include "websocket.h"
+#include "websocket_mask.h"
+#include "websocket_parser.h"
+#include "websocket_deflate.h"
 #include "tls_client.h"
 
 #define WEBSOCKET_TLS_BUFFER_SIZE                (2048)
 #define WEBSOCKET_CACHE_BUFFER_SIZE              (512)
 #define HEADER_CHECK_MIN_VALUE                   (0x000f)
+#define WEBSOCKET_FRAME_HEAD_MAX                 (14)
+#define WEBSOCKET_BATCH_MASK_KEYS                (16)
+#define WEBSOCKET_FRAME_RSV1                     (0x40)
+#define WEBSOCKET_FRAGMENT_IOV_MAX               (16)
+
+#ifndef WEBSOCKET_RECV_BUFFER_SIZE
+#define WEBSOCKET_RECV_BUFFER_SIZE               (4096)
+#endif
 
 #if WEBSOCKET_CACHE_BUFFER_SIZE < 512
     #error websocket cache buffer too small
 #endif
 
-struct websocket_frame_head
-{
-    unsigned char opcode: 4;
-    unsigned char rsv: 3;
-    unsigned char fin: 1;
-    unsigned char payload_len: 7;
-    unsigned char mask: 1;
-};
-
-struct control_frame
-{
-    struct websocket_frame_head head;
-    unsigned char masking_key[4];
-    unsigned char payload_data[1];
-};
-
 enum HEADER_CHECK
 {
     HEADER_HAVE_101_SWITCH_PROTOCOL = 0,
@@ -50,37 +63,123 @@ enum HEADER_CHECK
 
 static int websocket_send(struct websocket_session *session, const void *buf, size_t len, int flags)
 {
+    int res;
+
+    if (session->send_to)
+        return session->send_to(session->send_ctx, buf, len, flags);
+
     if (session->tls_session)
         return mbedtls_client_write(session->tls_session, buf, len);
 
-    return send(session->socket_fd, buf, len, flags);
+    /* a socket with SO_SNDTIMEO/SO_RCVTIMEO is not restarted after a signal, it fails with EINTR */
+    do
+    {
+        res = send(session->socket_fd, buf, len, flags);
+    } while (res < 0 && errno == EINTR);
+
+    return res;
 }
 
 static int websocket_recv(struct websocket_session *session, void *buf, size_t len, int flags)
 {
+    int res;
+
     if (session->tls_session)
         return mbedtls_client_read(session->tls_session, buf, len);
 
-    return recv(session->socket_fd, buf, len, flags);
+    do
+    {
+        res = recv(session->socket_fd, buf, len, flags);
+    } while (res < 0 && errno == EINTR);
+
+    return res;
 }
 
-static int websocket_recv_nbytes(struct websocket_session *session, void *buf, size_t len, int flags)
+static void websocket_setsockopt(int fd, int level, int name, int value)
 {
-    int read_len = 0;
-    size_t pos = 0;
+    if (value)
+        setsockopt(fd, level, name, (void *)&value, sizeof(value));
+}
 
-    while (len)
+static void websocket_socket_cork(struct websocket_session *session, int cork)
+{
+#ifdef TCP_CORK
+    if (session->sockopt.cork && session->corked != cork)
+    {
+        setsockopt(session->socket_fd, IPPROTO_TCP, TCP_CORK, (void *)&cork, sizeof(cork));
+        session->corked = cork;
+    }
+#endif
+}
+
+/* One transport read into the read-ahead buffer, the unread tail is moved to the front first. */
+static int websocket_recv_fill(struct websocket_session *session)
+{
+    int read_len;
+
+    if (session->recv_pos == session->recv_end)
+    {
+        session->recv_pos = session->recv_end = 0;
+    }
+    else if (session->recv_pos > 0)
+    {
+        ws_memmove(session->recv_buf, session->recv_buf + session->recv_pos, session->recv_end - session->recv_pos);
+        session->recv_end -= session->recv_pos;
+        session->recv_pos = 0;
+    }
+
+    if (session->recv_end == session->recv_buf_len)
+    {
+        return -WEBSOCKET_NOMEM;
+    }
+
+    read_len = websocket_recv(session, session->recv_buf + session->recv_end, session->recv_buf_len - session->recv_end, 0);
+    if (read_len > 0)
+    {
+        session->recv_end += read_len;
+#ifdef TCP_QUICKACK
+        /* the kernel drops quickack mode again on its own, re-arm it after every read */
+        websocket_setsockopt(session->socket_fd, IPPROTO_TCP, TCP_QUICKACK, session->sockopt.quickack);
+#endif
+    }
+
+    return read_len;
+}
+
+/* Read through the read-ahead buffer, reads at least as large as the buffer go straight to the transport. */
+static int websocket_recv_buffered(struct websocket_session *session, void *buf, size_t len)
+{
+    size_t avail;
+    int read_len;
+
+    if (session->recv_buf == NULL)
+    {
+        return websocket_recv(session, buf, len, 0);
+    }
+
+    avail = session->recv_end - session->recv_pos;
+    if (avail == 0)
     {
-        read_len = websocket_recv(session, (uint8_t *)buf + pos, len, flags);
-        if (read_len <= 0)
+        if (len >= session->recv_buf_len)
         {
-            return -WEBSOCKET_READ_ERROR;
+            return websocket_recv(session, buf, len, 0);
+        }
+
+        if ((read_len = websocket_recv_fill(session)) <= 0)
+        {
+            return read_len;
         }
-        pos += read_len;
-        len -= pos;
+        avail = session->recv_end - session->recv_pos;
     }
 
-    return pos;
+    if (len > avail)
+    {
+        len = avail;
+    }
+    ws_memcpy(buf, session->recv_buf + session->recv_pos, len);
+    session->recv_pos += len;
+
+    return len;
 }
 
 static int websocket_send_nbytes(struct websocket_session *session, void *buf, size_t len, int flags)
@@ -93,207 +192,364 @@ static int websocket_send_nbytes(struct websocket_session *session, void *buf, s
         send_len = websocket_send(session, (uint8_t *)buf + pos, len, flags);
         if (send_len <= 0)
         {
-            return -WEBSOCKET_READ_ERROR;
+            return -WEBSOCKET_WRITE_ERROR;
         }
         pos += send_len;
-        len -= pos;
+        len -= send_len;
     }
 
     return pos;
 }
 
-static void websocket_mask_data(void *encode_buf, const void *buf, uint32_t *mask_key, size_t length)
+static size_t websocket_encode_head(unsigned char *head, websocket_frame_type_t opcode, char fin, unsigned char rsv, uint64_t length, const unsigned char mask_key[4])
 {
-#define UNALIGNED(X, Y) \
-    (((size_t)X & (sizeof (size_t) - 1)) | ((size_t)Y & (sizeof (size_t) - 1)))
-#define BIGBLOCKSIZE    (sizeof (uint32_t) << 2)
-#define LITTLEBLOCKSIZE (sizeof (uint32_t))
-#define TOO_SMALL(LEN)  ((LEN) < BIGBLOCKSIZE)
-
-    char *dst_ptr = (char *)encode_buf;
-    char *src_ptr = (char *)buf;
+    size_t head_length = 2;
 
-    uint32_t *aligned_dst;
-    uint32_t *aligned_src;
-    int len = length;
-
-    if (!TOO_SMALL(len) && !UNALIGNED(src_ptr, dst_ptr)) 
+    head[0] = (fin ? 0x80 : 0x00) | rsv | (opcode & 0x0f);
+    if (length < 126)
     {
-        aligned_dst = (uint32_t *)dst_ptr;
-        aligned_src = (uint32_t *)src_ptr; 
-
-        /* Copy 4X long words at a time if possible. */
-        while (len >= BIGBLOCKSIZE)
+        head[1] = 0x80 | (unsigned char)length;
+    }
+    else if (length <= 0xffff)
+    {
+        head[1] = 0x80 | 126;
+        head[2] = (unsigned char)(length >> 8);
+        head[3] = (unsigned char)length;
+        head_length += 2;
+    }
+    else
+    {
+        head[1] = 0x80 | 127;
+        for (int i = 0; i < 8; i++)
         {
-            *aligned_dst++ = *aligned_src++ ^ *mask_key;
-            *aligned_dst++ = *aligned_src++ ^ *mask_key;
-            *aligned_dst++ = *aligned_src++ ^ *mask_key;
-            *aligned_dst++ = *aligned_src++ ^ *mask_key;
-            len -= BIGBLOCKSIZE;
+            head[2 + i] = (unsigned char)(length >> (56 - 8 * i));
         }
+        head_length += 8;
+    }
+    ws_memcpy(&head[head_length], mask_key, 4);
 
-        /* Copy one long word at a time if possible. */
-        while (len >= LITTLEBLOCKSIZE)
-        {
-            *aligned_dst++ = *aligned_src++ ^ *mask_key;
-            len -= LITTLEBLOCKSIZE;
-        }
+    return head_length + 4;
+}
+
+static size_t websocket_head_length(uint64_t length)
+{
+    return (length < 126) ? 6 : ((length <= 0xffff) ? 8 : WEBSOCKET_FRAME_HEAD_MAX);
+}
+
+/* Send the queued control frames, the caller holds tx_lock. */
+static int websocket_tx_flush_control(struct websocket_session *session)
+{
+    unsigned char buf[WEBSOCKET_CONTROL_QUEUE_MAX * WEBSOCKET_CONTROL_FRAME_MAX];
+    size_t length = 0;
 
-        /* Pick up any residual with a byte copier. */
-        dst_ptr = (char *)aligned_dst;
-        src_ptr = (char *)aligned_src;
+    ws_mutex_lock(&session->control_lock);
+    for (int i = 0; i < session->control_count; i++)
+    {
+        ws_memcpy(buf + length, session->control[i].data, session->control[i].length);
+        length += session->control[i].length;
+        if (session->control[i].opcode == WEBSOCKET_CLOSE_FRAME)
+            session->close_sent = 1;
     }
+    session->control_count = 0;
+    ws_mutex_unlock(&session->control_lock);
 
-    for (int i = 0; i < len; i++)
+    if (length == 0)
+        return WEBSOCKET_OK;
+
+    if (websocket_send_nbytes(session, buf, length, 0) != (int)length)
+        return -WEBSOCKET_WRITE_ERROR;
+
+    /* inside a corked message the control frames would wait for its last slice, push them out now */
+    if (session->corked)
     {
-        *dst_ptr++ = *src_ptr++ ^ ((char *)mask_key)[i % 4];
+        websocket_socket_cork(session, 0);
+        websocket_socket_cork(session, 1);
     }
 
-#undef UNALIGNED
-#undef BIGBLOCKSIZE
-#undef LITTLEBLOCKSIZE
-#undef TOO_SMALL
+    return WEBSOCKET_OK;
 }
 
-static int websocket_send_control_frame(struct websocket_session *session, websocket_frame_type_t opcode, const char *buf, char length)
+static int websocket_control_pending(struct websocket_session *session)
 {
-    uint32_t mask_key = 0;
-    struct control_frame *fram = (struct control_frame *)session->cache;
+    int pending;
 
-    if (fram == NULL)
-    {
-        return -WEBSOCKET_NOMEM;
-    }
+    ws_mutex_lock(&session->control_lock);
+    pending = session->control_count;
+    ws_mutex_unlock(&session->control_lock);
 
-    ws_memset(session->cache, 0, sizeof(struct websocket_frame_head));
-    fram->head.fin = 1;
-    fram->head.opcode = opcode;
-    fram->head.mask = 1;
-    fram->head.payload_len = length;
+    return pending;
+}
 
-    ws_srand_key((unsigned char *)&mask_key, sizeof(uint32_t));
-    ws_memcpy(fram->masking_key, &mask_key, sizeof(uint32_t));
+/*
+ * Leave a frame boundary: control frames queued while the frame was on the wire go out before the
+ * lock is released. A control frame queued after the flush found tx_lock taken, so it is picked up
+ * by the check that follows the unlock.
+ */
+static int websocket_tx_unlock(struct websocket_session *session)
+{
+    int res;
 
-    if (websocket_send_nbytes(session, (void *)fram, sizeof(struct control_frame) - 1, 0) != sizeof(struct control_frame) - 1)
+    do
     {
-        return -WEBSOCKET_ERROR;
+        res = websocket_tx_flush_control(session);
+        ws_mutex_unlock(&session->tx_lock);
     }
+    while (websocket_control_pending(session) && ws_mutex_trylock(&session->tx_lock) == 0);
 
-    if (buf != NULL)
+    return res;
+}
+
+static int websocket_tx_lock(struct websocket_session *session)
+{
+    ws_mutex_lock(&session->tx_lock);
+
+    /* nothing may follow a close frame, and a disconnected session has no socket or cache left */
+    if (session->close_sent || session->cache == NULL || session->socket_fd < 0)
     {
-        websocket_mask_data(session->cache, buf, &mask_key, length);
-        if (websocket_send(session, (void *)session->cache, length, 0) <= 0)
-        {
-            return -WEBSOCKET_ERROR;
-        }
+        ws_mutex_unlock(&session->tx_lock);
+        return -WEBSOCKET_WRITE_ERROR;
     }
 
     return WEBSOCKET_OK;
 }
 
-static int websocket_get_payload_len(struct websocket_session *session, struct websocket_frame_head *frame_head)
+static int websocket_send_encode_iov(struct websocket_session *session, const struct iovec *iov, int iovcnt, uint64_t length, websocket_frame_type_t opcode, char fin, unsigned char rsv)
 {
-    int data_length = 0;
+    unsigned char head[WEBSOCKET_FRAME_HEAD_MAX];
+    unsigned char *frame;
+    size_t head_length, used, send_length, n;
+    size_t seg = 0, seg_pos = 0;
+    uint32_t mask_key = 0;
+    uint64_t pos = 0;
+    size_t phase = 0;
     int res = WEBSOCKET_OK;
 
-    session->info.total_len = 0;
+    if (websocket_tx_lock(session) != WEBSOCKET_OK)
+    {
+        return -WEBSOCKET_WRITE_ERROR;
+    }
+
+    ws_srand_key((unsigned char *)&mask_key, 4);
+    head_length = websocket_encode_head(head, opcode, fin, rsv, length, (unsigned char *)&mask_key);
+
+    /* The header is placed right in front of the masked payload, so a frame that fits the cache leaves
+     * in one send (one TCP segment, or one record on TLS). Larger payloads are masked and sent cache-sized
+     * chunk by chunk with the mask phase carried over, memory use stays bounded by session->cache_len.
+     * The payload segments are masked straight into the cache, they are never concatenated first. */
+    frame = (unsigned char *)session->cache + WEBSOCKET_FRAME_HEAD_MAX - head_length;
+    ws_memcpy(frame, head, head_length);
+    used = WEBSOCKET_FRAME_HEAD_MAX;
 
-    if ((data_length = frame_head->payload_len) < 126)
+    if (!fin || length + WEBSOCKET_FRAME_HEAD_MAX > session->cache_len)
     {
-        session->info.total_len = data_length;
+        websocket_socket_cork(session, 1);
     }
-    else if (data_length == 126)
+
+    do
     {
-        uint16_t payload_len = 0;
-        /* read two bytes again */
-        if ((data_length = websocket_recv_nbytes(session, &payload_len, 2, 0)) <= 0)
+        while (pos < length && used < session->cache_len)
         {
-            res = -WEBSOCKET_READ_ERROR;
+            while (seg < (size_t)iovcnt && seg_pos == iov[seg].iov_len)
+            {
+                seg += 1;
+                seg_pos = 0;
+            }
+            if (seg == (size_t)iovcnt)
+            {
+                /* the segments are shorter than the length in the header, the frame cannot be completed */
+                res = -WEBSOCKET_WRITE_ERROR;
+                break;
+            }
+
+            n = iov[seg].iov_len - seg_pos;
+            if (n > session->cache_len - used)
+                n = session->cache_len - used;
+            phase = websocket_mask(session->cache + used, (const char *)iov[seg].iov_base + seg_pos, n, (unsigned char *)&mask_key, phase);
+            used += n;
+            seg_pos += n;
+            pos += n;
         }
-        session->info.total_len = ntohs(payload_len);
-    }
-    else if (data_length == 127)
-    {
-        uint64_t payload_len = 0, low, hight;
 
-        if ((data_length = websocket_recv_nbytes(session, &payload_len, 8, 0)) <= 0)
+        send_length = (unsigned char *)session->cache + used - frame;
+        if (res == WEBSOCKET_OK && websocket_send_nbytes(session, frame, send_length, 0) != (int)send_length)
         {
-            res = -WEBSOCKET_READ_ERROR;
+            res = -WEBSOCKET_WRITE_ERROR;
         }
-        low = ntohl((payload_len & 0xffffffff));
-        hight = ntohl((payload_len & 0xffffffff00000000) >> 32);
+        frame = (unsigned char *)session->cache;
+        used = 0;
+    }
+    while (pos < length && res == WEBSOCKET_OK);
 
-        session->info.total_len = (uint64_t)((uint64_t)(low << 32) | hight);
+    /* a fragmented message stays corked until its last slice, a failed one does not leave it corked */
+    if (fin || res != WEBSOCKET_OK)
+    {
+        websocket_socket_cork(session, 0);
+    }
+    if (websocket_tx_unlock(session) != WEBSOCKET_OK)
+    {
+        res = -WEBSOCKET_WRITE_ERROR;
     }
 
-    session->info.remain_len = session->info.total_len;
-    return res;
+    return res == WEBSOCKET_OK ? (int)pos : res;
 }
 
-static int websocket_send_encode_package(struct websocket_session *session, const void *buf, uint64_t length, websocket_frame_type_t opcode, char fin)
+/*
+ * Send a message part as one frame, or as several when it is longer than max_frame_payload. The first
+ * frame carries `opcode` and `rsv`, the others are continuation frames and only the last one can have
+ * fin set. The caller holds data_lock, so no other data frame can get between the fragments. tx_lock
+ * is dropped between them, so control frames queued meanwhile go out without waiting for the whole
+ * message.
+ */
+static int websocket_send_fragmented(struct websocket_session *session, const struct iovec *iov, int iovcnt, uint64_t length, websocket_frame_type_t opcode, char fin, unsigned char rsv)
 {
-    char head_length;
-    int send_length;
-    uint32_t mask_key = 0;
-    size_t pos = 0;
-
-    ws_srand_key((unsigned char *)&mask_key, 4);
-    ws_memset(session->cache, 0, sizeof(struct websocket_frame_head));
+    struct iovec frag[WEBSOCKET_FRAGMENT_IOV_MAX];
+    size_t max = session->max_frame_payload;
+    size_t seg = 0, seg_pos = 0, n;
+    uint64_t pos = 0, frag_length;
+    int fragcnt;
 
-    if (length < 126)
+    if (max == 0 || length <= max)
     {
-        head_length = 6;
-        ((struct websocket_frame_head *)session->cache)->fin = fin;
-        ((struct websocket_frame_head *)session->cache)->mask = 1;
-        ((struct websocket_frame_head *)session->cache)->opcode = opcode;
-        ((struct websocket_frame_head *)session->cache)->payload_len = length;
-        ws_memcpy(&session->cache[2], &mask_key, 4);
+        return websocket_send_encode_iov(session, iov, iovcnt, length, opcode, fin, rsv);
     }
-    else if (length < 65535)
+
+    while (pos < length)
     {
-        head_length = 8;
-        ((struct websocket_frame_head *)session->cache)->fin = 1;
-        ((struct websocket_frame_head *)session->cache)->mask = 1;
-        ((struct websocket_frame_head *)session->cache)->opcode = opcode;
-        ((struct websocket_frame_head *)session->cache)->payload_len = 126;
-        *((uint16_t *)(session->cache + 2)) = htons(length);
-        ws_memcpy(&session->cache[4], &mask_key, 4);
+        /* a fragment ends at max bytes, or earlier when it spans more segments than frag[] holds */
+        frag_length = 0;
+        fragcnt = 0;
+        while (frag_length < max && pos + frag_length < length && fragcnt < WEBSOCKET_FRAGMENT_IOV_MAX)
+        {
+            while (seg < (size_t)iovcnt && seg_pos == iov[seg].iov_len)
+            {
+                seg += 1;
+                seg_pos = 0;
+            }
+            if (seg == (size_t)iovcnt)
+            {
+                return -WEBSOCKET_WRITE_ERROR;
+            }
+
+            n = iov[seg].iov_len - seg_pos;
+            if (n > max - frag_length)
+                n = max - frag_length;
+            if (n > length - pos - frag_length)
+                n = length - pos - frag_length;
+            frag[fragcnt].iov_base = (char *)iov[seg].iov_base + seg_pos;
+            frag[fragcnt].iov_len = n;
+            fragcnt += 1;
+            frag_length += n;
+            seg_pos += n;
+        }
+
+        if (websocket_send_encode_iov(session, frag, fragcnt, frag_length, opcode, fin && pos + frag_length == length, rsv) != (int)frag_length)
+        {
+            return -WEBSOCKET_WRITE_ERROR;
+        }
+        pos += frag_length;
+        opcode = WEBSOCKET_CONTINUE_FRAME;
+        rsv = 0;
     }
-    else
+
+    return (int)pos;
+}
+
+/*
+ * Run a data payload through permessage-deflate when it was negotiated. On success `out` holds the
+ * first compressed chunk and `more` tells whether websocket_deflate_next has further ones. Returns 1 if
+ * compressed, 0 if the payload goes out as it is, or a negative error.
+ */
+static int websocket_deflate_payload(struct websocket_session *session, const struct iovec *iov, int iovcnt, char fin, struct iovec *out, int *more)
+{
+    int res;
+
+    if (session->deflate == NULL)
+        return 0;
+
+    res = websocket_deflate_begin(session->deflate, iov, iovcnt, fin);
+    if (res != WEBSOCKET_OK)
+        return res < 0 ? res : 0;
+
+    *more = websocket_deflate_next(session->deflate, out);
+
+    return *more < 0 ? *more : 1;
+}
+
+/*
+ * Send a compressed message part chunk by chunk, starting with `chunk` from websocket_deflate_payload.
+ * Every chunk is a frame of its own, the first one carries `opcode` (and RSV1 unless it continues a
+ * message) and only the last one of a final part has fin set.
+ */
+static int websocket_send_deflated(struct websocket_session *session, struct iovec *chunk, int more, websocket_frame_type_t opcode, char fin)
+{
+    unsigned char rsv = opcode != WEBSOCKET_CONTINUE_FRAME ? WEBSOCKET_FRAME_RSV1 : 0;
+
+    for (;;)
     {
-        head_length = 14;
-        ((struct websocket_frame_head *)session->cache)->fin = 1;
-        ((struct websocket_frame_head *)session->cache)->mask = 1;
-        ((struct websocket_frame_head *)session->cache)->opcode = opcode;
-        ((struct websocket_frame_head *)session->cache)->payload_len = 127;
-        *((uint64_t *)(session->cache + 2)) = (htonl((length & 0xFFFFFFFF) << 32) | htonl((length >> 32) & 0xFFFFFFFF));
-        ws_memcpy(&session->cache[10], &mask_key, 4);
+        if (websocket_send_fragmented(session, chunk, 1, chunk->iov_len, opcode, fin && !more, rsv) != (int)chunk->iov_len)
+            return -WEBSOCKET_WRITE_ERROR;
+        if (!more)
+            return WEBSOCKET_OK;
+
+        opcode = WEBSOCKET_CONTINUE_FRAME;
+        rsv = 0;
+        if ((more = websocket_deflate_next(session->deflate, chunk)) < 0)
+            return -WEBSOCKET_WRITE_ERROR;
     }
+}
+
+/*
+ * Control frames never wait for a whole message. If a data frame is on the wire the control frame is
+ * queued and sent by that writer as soon as the frame is complete, which bounds its latency by one
+ * frame instead of one message. Between frames it is sent right away, also in the middle of a
+ * fragmented message (RFC 6455 5.4).
+ */
+static int websocket_send_control_frame(struct websocket_session *session, websocket_frame_type_t opcode, const char *buf, char length)
+{
+    struct websocket_control_frame *control;
+    size_t payload_len = buf ? (unsigned char)length : 0;
+    uint32_t mask_key;
+    int locked = 0;
 
-    if (websocket_send_nbytes(session, session->cache, head_length, 0) != head_length)
+    if (session->cache == NULL)
     {
-        return -WEBSOCKET_WRITE_ERROR;
+        return -WEBSOCKET_NOMEM;
     }
 
-    websocket_mask_data(session->cache, buf, &mask_key, length);
+    if (payload_len > 125)
+    {
+        return -WEBSOCKET_ERROR;
+    }
 
-    while (length)
+    ws_mutex_lock(&session->control_lock);
+    while (session->control_count == WEBSOCKET_CONTROL_QUEUE_MAX)
     {
-        send_length = length > session->cache_len ? session->cache_len : length;
-        if ((send_length = websocket_send(session, session->cache + pos, send_length, 0)) < 0)
-        {
-            return send_length;
-        }
-        else if (send_length == 0)
+        /* queue full, wait for the frame boundary and flush it here */
+        ws_mutex_unlock(&session->control_lock);
+        if (!locked)
         {
-            break;
+            ws_mutex_lock(&session->tx_lock);
+            locked = 1;
         }
+        websocket_tx_flush_control(session);
+        ws_mutex_lock(&session->control_lock);
+    }
+
+    control = &session->control[session->control_count++];
+    ws_srand_key((unsigned char *)&mask_key, 4);
+    control->opcode = opcode;
+    control->length = websocket_encode_head(control->data, opcode, 1, 0, payload_len, (unsigned char *)&mask_key);
+    websocket_mask(control->data + control->length, buf, payload_len, (unsigned char *)&mask_key, 0);
+    control->length += payload_len;
+    ws_mutex_unlock(&session->control_lock);
 
-        length -= send_length;
-        pos += send_length;
+    if (!locked && ws_mutex_trylock(&session->tx_lock) != 0)
+    {
+        /* a writer holds the socket, it sends the frame at its next frame boundary */
+        return WEBSOCKET_OK;
     }
 
-    return pos;
+    return websocket_tx_unlock(session);
 }
 
 static const char *websocket_wrl_praser_host(const char *host_addr, size_t *host_len)
@@ -432,19 +688,59 @@ static unsigned char *websocket_generate_mask_key(struct websocket_session *sess
     return session->key;
 }
 
-int websocket_header_fields_add(struct websocket_session *session, const char *fmt, ...)
+static int websocket_cache_alloc(struct websocket_session *session)
 {
-    int length;
-    va_list args;
-
     if (session->cache == NULL)
     {
-        session->cache = ws_malloc(WEBSOCKET_CACHE_BUFFER_SIZE);
+        if (session->cache_len < WEBSOCKET_CACHE_BUFFER_SIZE)
+        {
+            session->cache_len = WEBSOCKET_CACHE_BUFFER_SIZE;
+        }
+
+        session->cache = ws_malloc(session->cache_len);
         if (session->cache == NULL)
         {
             return -WEBSOCKET_NOMEM;
         }
-        session->cache_len = WEBSOCKET_CACHE_BUFFER_SIZE;
+    }
+
+    return WEBSOCKET_OK;
+}
+
+int websocket_set_cache_size(struct websocket_session *session, size_t size)
+{
+    char *cache;
+
+    if (session == NULL || size < WEBSOCKET_CACHE_BUFFER_SIZE)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    if (session->cache != NULL)
+    {
+        /* keep the pending user-defined header fields */
+        cache = ws_malloc(size);
+        if (cache == NULL)
+        {
+            return -WEBSOCKET_NOMEM;
+        }
+        ws_memcpy(cache, session->cache, session->head_len);
+        ws_free(session->cache);
+        session->cache = cache;
+    }
+    session->cache_len = size;
+
+    return WEBSOCKET_OK;
+}
+
+int websocket_header_fields_add(struct websocket_session *session, const char *fmt, ...)
+{
+    int length;
+    va_list args;
+
+    if (websocket_cache_alloc(session) != WEBSOCKET_OK)
+    {
+        return -WEBSOCKET_NOMEM;
     }
 
     va_start(args, fmt);
@@ -515,6 +811,21 @@ static int websocket_send_hand_frame(struct websocket_session *session, const ch
     if (subprotocol != NULL && remain_len > 0)
         head_len += websocket_snprintf(&ptr, &remain_len, "Sec-WebSocket-Protocol: %s\r\n", subprotocol);
 
+    if (session->deflate_opt.enable && remain_len > 0)
+    {
+        int offer_len = websocket_deflate_offer(&session->deflate_opt, ptr, remain_len);
+        if (offer_len < 0)
+        {
+            remain_len = -1;
+        }
+        else
+        {
+            head_len += offer_len;
+            ptr += offer_len;
+            remain_len -= offer_len;
+        }
+    }
+
     if (remain_len > (int)session->head_len)
         ws_memcpy(ptr, session->cache + session->cache_len - session->head_len, session->head_len);
 
@@ -595,6 +906,11 @@ static int websocket_check_header_line(struct websocket_session *session, char *
             res = -WEBSOCKET_NOMEM;
         }
     }
+    else if (strncasecmp(header_line, "Sec-WebSocket-Extensions:", strlen("Sec-WebSocket-Extensions:")) == 0)
+    {
+        /* only what we offered may come back, anything else fails the handshake */
+        res = websocket_deflate_accept(session, header_line + strlen("Sec-WebSocket-Extensions:"));
+    }
 
     return res;
 }
@@ -604,12 +920,17 @@ static int websocket_read_line(struct websocket_session *session, char *buffer,
     int rc, count = 0;
     char ch = 0, last_ch = 0;
 
-    /* Keep reading until we fill the buffer. */
+    /* Keep reading until we fill the buffer, bytes come from the read-ahead buffer. */
     while (count < size)
     {
-        rc = websocket_recv(session, (unsigned char *)&ch, 1, 0);
-        if (rc <= 0)
+        if (session->recv_pos < session->recv_end)
+        {
+            ch = session->recv_buf[session->recv_pos++];
+        }
+        else if ((rc = websocket_recv_buffered(session, (unsigned char *)&ch, 1)) <= 0)
+        {
             return rc;
+        }
 
         if (ch == '\n' && last_ch == '\r')
         {
@@ -688,62 +1009,312 @@ static int webscoket_tls_init(struct websocket_session *session)
     return success ? WEBSOCKET_OK : success;
 }
 
+static int websocket_block_info_head(struct websocket_parser *parser, void *ctx)
+{
+    (void)parser;
+    *(int *)ctx = 1;
+    return 1;
+}
+
 int websocket_get_block_info_raw(struct websocket_session *session)
 {
-    uint16_t websocket_head = 0;
+    const struct websocket_parser_callback cb = { websocket_block_info_head, NULL, NULL };
+    int have_head = 0, res;
+
     if (session->info.remain_len != 0)
     {
         return -WEBSOCKET_NO_HEAD;
     }
 
-    if (websocket_recv_nbytes(session, &websocket_head, 2, 0) <= 0)
-    {
-        return -WEBSOCKET_READ_ERROR;
-    }
-
-    session->info.frame_type = ((struct websocket_frame_head *)&websocket_head)->opcode;
-    session->info.is_slice = !((struct websocket_frame_head *)&websocket_head)->fin;
-
-    return websocket_get_payload_len(session, (struct websocket_frame_head *)&websocket_head);
-}
-
-int websocket_get_block_info(struct websocket_session *session)
-{
-    int res = WEBSOCKET_OK;
-
-    if (websocket_get_block_info_raw(session) != WEBSOCKET_OK)
+    if (session->parser == NULL || session->recv_buf == NULL)
     {
         return -WEBSOCKET_READ_ERROR;
     }
 
-    while (session->info.frame_type == WEBSOCKET_CLOSE_FRAME || session->info.frame_type == WEBSOCKET_PING_FRAME \
-            || session->info.frame_type == WEBSOCKET_PONG_FRAME)
+    while (!have_head)
     {
-        if (session->info.remain_len != 0)
+        if (session->recv_pos == session->recv_end && websocket_recv_fill(session) <= 0)
         {
-            if (websocket_recv_nbytes(session, session->cache, session->info.remain_len, 0) <= 0)
-            {
-                res = -WEBSOCKET_READ_ERROR;
-                break;
-            }
-            session->info.remain_len = 0;
+            return -WEBSOCKET_READ_ERROR;
         }
 
-        if (websocket_get_block_info_raw(session) != WEBSOCKET_OK)
+        res = websocket_parser_execute(session->parser, &cb, &have_head, session->recv_buf + session->recv_pos, session->recv_end - session->recv_pos);
+        if (res < 0)
         {
-            res = -WEBSOCKET_READ_ERROR;
-            break;
+            return -WEBSOCKET_READ_ERROR;
         }
+        session->recv_pos += res;
     }
+    session->info = session->parser->info;
 
-    return res;
+    return WEBSOCKET_OK;
 }
 
-int websocket_set_timeout(struct websocket_session *session, int second)
+/* read payload bytes of the current frame, the parser is kept in step with them */
+static int websocket_recv_payload(struct websocket_session *session, void *buf, size_t length)
 {
-    struct timeval timeout;
-    timeout.tv_sec = second;
-    timeout.tv_usec = 0;
+    int recv_len, res;
+
+    if (session->info.remain_len < length)
+    {
+        length = session->info.remain_len;
+    }
+
+    if ((recv_len = websocket_recv_buffered(session, buf, length)) <= 0)
+    {
+        return recv_len;
+    }
+
+    session->info.remain_len -= recv_len;
+    if ((res = websocket_parser_execute(session->parser, NULL, NULL, buf, recv_len)) < 0)
+    {
+        return res;
+    }
+
+    return recv_len;
+}
+
+int websocket_get_block_info(struct websocket_session *session)
+{
+    int res = WEBSOCKET_OK;
+
+    if (websocket_get_block_info_raw(session) != WEBSOCKET_OK)
+    {
+        return -WEBSOCKET_READ_ERROR;
+    }
+
+    while (websocket_parser_is_control(session->info.frame_type))
+    {
+        while (session->info.remain_len != 0)
+        {
+            if (websocket_recv_payload(session, session->cache, session->info.remain_len) <= 0)
+            {
+                res = -WEBSOCKET_READ_ERROR;
+                break;
+            }
+        }
+
+        if (res != WEBSOCKET_OK || websocket_get_block_info_raw(session) != WEBSOCKET_OK)
+        {
+            res = -WEBSOCKET_READ_ERROR;
+            break;
+        }
+    }
+
+    return res;
+}
+
+static int websocket_would_block(struct websocket_session *session, int ret)
+{
+    if (session->tls_session)
+        return ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE;
+
+    return ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+}
+
+struct websocket_feed_inflate
+{
+    struct websocket_session *session;
+    const struct websocket_parser_callback *cb;
+    void *ctx;
+};
+
+static int websocket_feed_compressed(struct websocket_parser *parser)
+{
+    return parser->message_rsv && !websocket_parser_is_control(parser->info.frame_type);
+}
+
+/* hand everything the inflater has to the caller's data callback */
+static int websocket_feed_drain(struct websocket_parser *parser, struct websocket_feed_inflate *feed)
+{
+    struct websocket_deflate *deflate = feed->session->deflate;
+    char *chunk = websocket_inflate_chunk(deflate);
+    int n, res = 0, cb_res;
+
+    while ((n = websocket_inflate_pull(deflate, chunk, WEBSOCKET_DEFLATE_CHUNK_SIZE)) > 0)
+    {
+        if (websocket_parser_check_utf8(parser) && websocket_utf8_update(&parser->utf8, chunk, n) != WEBSOCKET_OK)
+            return -WEBSOCKET_INVALID_UTF8;
+
+        if (feed->cb && feed->cb->on_frame_data)
+        {
+            cb_res = feed->cb->on_frame_data(parser, feed->ctx, chunk, n);
+            if (cb_res < 0)
+                return cb_res;
+            if (cb_res > 0)
+                res = cb_res;
+        }
+    }
+
+    return n < 0 ? -WEBSOCKET_READ_ERROR : res;
+}
+
+static int websocket_feed_on_head(struct websocket_parser *parser, void *ctx)
+{
+    struct websocket_feed_inflate *feed = (struct websocket_feed_inflate *)ctx;
+
+    if (websocket_feed_compressed(parser) && parser->info.frame_type != WEBSOCKET_CONTINUE_FRAME)
+        websocket_inflate_begin(feed->session->deflate);
+
+    return (feed->cb && feed->cb->on_frame_head) ? feed->cb->on_frame_head(parser, feed->ctx) : 0;
+}
+
+static int websocket_feed_on_data(struct websocket_parser *parser, void *ctx, const char *data, size_t length)
+{
+    struct websocket_feed_inflate *feed = (struct websocket_feed_inflate *)ctx;
+
+    if (!websocket_feed_compressed(parser))
+        return (feed->cb && feed->cb->on_frame_data) ? feed->cb->on_frame_data(parser, feed->ctx, data, length) : 0;
+
+    websocket_inflate_push(feed->session->deflate, data, length);
+
+    return websocket_feed_drain(parser, feed);
+}
+
+static int websocket_feed_on_end(struct websocket_parser *parser, void *ctx)
+{
+    struct websocket_feed_inflate *feed = (struct websocket_feed_inflate *)ctx;
+    int res;
+
+    /* the end of the last frame flushes the inflater before the caller sees the message end */
+    if (websocket_feed_compressed(parser) && !parser->in_message)
+    {
+        websocket_inflate_finish(feed->session->deflate);
+        if ((res = websocket_feed_drain(parser, feed)) < 0)
+            return res;
+        if (websocket_parser_check_utf8(parser) && websocket_utf8_final(&parser->utf8) != WEBSOCKET_OK)
+            return -WEBSOCKET_INVALID_UTF8;
+    }
+
+    return (feed->cb && feed->cb->on_frame_end) ? feed->cb->on_frame_end(parser, feed->ctx) : 0;
+}
+
+static const struct websocket_parser_callback websocket_feed_inflate_cb =
+{
+    websocket_feed_on_head,
+    websocket_feed_on_data,
+    websocket_feed_on_end
+};
+
+static int websocket_feed_execute(struct websocket_session *session, const struct websocket_parser_callback *cb, void *ctx, const char *data, size_t length)
+{
+    struct websocket_feed_inflate feed;
+    int res;
+
+    /* with permessage-deflate the callbacks see the inflated payload */
+    if (session->deflate)
+    {
+        feed.session = session;
+        feed.cb = cb;
+        feed.ctx = ctx;
+        cb = &websocket_feed_inflate_cb;
+        ctx = &feed;
+    }
+
+    res = websocket_parser_execute(session->parser, cb, ctx, data, length);
+    if (res >= 0)
+    {
+        session->info = session->parser->info;
+    }
+
+    return res;
+}
+
+int websocket_feed(struct websocket_session *session, const struct websocket_parser_callback *cb, void *ctx)
+{
+    int res;
+
+    if (session->parser == NULL || session->recv_buf == NULL)
+    {
+        return -WEBSOCKET_READ_ERROR;
+    }
+
+    if (session->recv_pos == session->recv_end)
+    {
+        res = websocket_recv_fill(session);
+        if (res == 0)
+        {
+            return -WEBSOCKET_DISCONNECT;
+        }
+        else if (res < 0)
+        {
+            return websocket_would_block(session, res) ? -WEBSOCKET_AGAIN : -WEBSOCKET_READ_ERROR;
+        }
+    }
+
+    res = websocket_feed_execute(session, cb, ctx, session->recv_buf + session->recv_pos, session->recv_end - session->recv_pos);
+    if (res < 0)
+    {
+        return res;
+    }
+    session->recv_pos += res;
+
+    return res;
+}
+
+int websocket_feed_buffer(struct websocket_session *session, const struct websocket_parser_callback *cb, void *ctx, const void *data, size_t length)
+{
+    if (session->parser == NULL || data == NULL)
+    {
+        return -WEBSOCKET_READ_ERROR;
+    }
+
+    /* the stream has to stay in order, read-ahead bytes come first */
+    if (session->recv_pos != session->recv_end)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    return websocket_feed_execute(session, cb, ctx, (const char *)data, length);
+}
+
+int websocket_recv_release(struct websocket_session *session)
+{
+    if (session->recv_pos != session->recv_end)
+    {
+        return -WEBSOCKET_AGAIN;
+    }
+
+    if (session->recv_buf)
+    {
+        ws_free(session->recv_buf);
+        session->recv_buf = NULL;
+    }
+    session->recv_buf_len = 0;
+    session->recv_pos = session->recv_end = 0;
+
+    return WEBSOCKET_OK;
+}
+
+const struct websocket_socket_options websocket_socket_low_latency =
+{
+    .nodelay = 1,
+    .quickack = 1,
+    .user_timeout_ms = 10000,
+    .keepalive = 1,
+    .keepidle = 30,
+    .keepintvl = 5,
+    .keepcnt = 3,
+};
+
+const struct websocket_socket_options websocket_socket_bulk_throughput =
+{
+    .nodelay = 1,
+    .cork = 1,
+    .sndbuf = 4 * 1024 * 1024,
+    .rcvbuf = 4 * 1024 * 1024,
+    .user_timeout_ms = 30000,
+    .keepalive = 1,
+    .keepidle = 60,
+    .keepintvl = 10,
+    .keepcnt = 5,
+};
+
+int websocket_set_timeout_ms(struct websocket_session *session, int millisecond)
+{
+    struct timeval timeout;
+    timeout.tv_sec = millisecond / 1000;
+    timeout.tv_usec = (millisecond % 1000) * 1000;
 
     setsockopt(session->socket_fd, SOL_SOCKET, SO_RCVTIMEO,
                (void *) &timeout, sizeof(timeout));
@@ -753,6 +1324,85 @@ int websocket_set_timeout(struct websocket_session *session, int second)
     return 0;
 }
 
+int websocket_set_timeout(struct websocket_session *session, int second)
+{
+    return websocket_set_timeout_ms(session, second * 1000);
+}
+
+int websocket_set_socket_options(struct websocket_session *session, const struct websocket_socket_options *options)
+{
+    if (session == NULL || options == NULL)
+        return -WEBSOCKET_ERROR;
+
+    session->sockopt = *options;
+    return WEBSOCKET_OK;
+}
+
+int websocket_set_utf8_validation(struct websocket_session *session, int enable)
+{
+    if (session == NULL)
+        return -WEBSOCKET_ERROR;
+
+    session->utf8_validate = enable;
+    if (session->parser)
+        session->parser->validate_utf8 = enable ? 1 : 0;
+
+    return WEBSOCKET_OK;
+}
+
+int websocket_set_max_frame_payload(struct websocket_session *session, size_t size)
+{
+    if (session == NULL)
+        return -WEBSOCKET_ERROR;
+
+    session->max_frame_payload = size;
+    return WEBSOCKET_OK;
+}
+
+int websocket_set_deflate(struct websocket_session *session, const struct websocket_deflate_options *options)
+{
+#ifdef WEBSOCKET_USING_DEFLATE
+    if (session == NULL || options == NULL)
+        return -WEBSOCKET_ERROR;
+
+    if (options->enable && ((options->client_max_window_bits && (options->client_max_window_bits < 9 || options->client_max_window_bits > 15)) ||
+                            (options->server_max_window_bits && (options->server_max_window_bits < 9 || options->server_max_window_bits > 15))))
+        return -WEBSOCKET_ERROR;
+
+    session->deflate_opt = *options;
+    return WEBSOCKET_OK;
+#else
+    return -WEBSOCKET_ERROR;
+#endif
+}
+
+/* buffer sizes must be set before connect to take part in the window scale negotiation */
+static void websocket_socket_options_pre_connect(struct websocket_session *session, int fd)
+{
+    websocket_setsockopt(fd, SOL_SOCKET, SO_SNDBUF, session->sockopt.sndbuf);
+    websocket_setsockopt(fd, SOL_SOCKET, SO_RCVBUF, session->sockopt.rcvbuf);
+    websocket_setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, session->sockopt.nodelay);
+}
+
+static void websocket_socket_options_post_connect(struct websocket_session *session, int fd)
+{
+    websocket_setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, session->sockopt.nodelay);
+    websocket_setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, session->sockopt.keepalive);
+#ifdef TCP_KEEPIDLE
+    websocket_setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, session->sockopt.keepidle);
+    websocket_setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, session->sockopt.keepintvl);
+    websocket_setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, session->sockopt.keepcnt);
+#endif
+#ifdef TCP_USER_TIMEOUT
+    websocket_setsockopt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, session->sockopt.user_timeout_ms);
+#endif
+#ifdef TCP_QUICKACK
+    websocket_setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, session->sockopt.quickack);
+#endif
+    if (session->sockopt.timeout_ms)
+        websocket_set_timeout_ms(session, session->sockopt.timeout_ms);
+}
+
 int websocket_send_ping(struct websocket_session *session, const char *buf, char length)
 {
     return websocket_send_control_frame(session, WEBSOCKET_PING_FRAME, buf, length);
@@ -765,17 +1415,19 @@ int websocket_send_pong(struct websocket_session *session, const char *buf, char
 
 int websocket_send_close(struct websocket_session *session, websocket_status_code_t status_code, const char *buf, char length)
 {
-    char *send_buf;
+    char send_buf[125];
     char send_length = 2;
     uint16_t statu_code = htons(status_code);
 
     if (session == NULL || session->socket_fd < 0)
         return -WEBSOCKET_ERROR;
 
+    if (buf != NULL && (unsigned char)length > sizeof(send_buf) - 2)
+        return -WEBSOCKET_ERROR;
+
     if (buf != NULL)
         send_length += length;
 
-    send_buf = session->cache + session->cache_len - send_length;
     ws_memcpy(send_buf, &statu_code, sizeof(statu_code));
 
     if (buf != NULL)
@@ -784,35 +1436,157 @@ int websocket_send_close(struct websocket_session *session, websocket_status_cod
     return websocket_send_control_frame(session, WEBSOCKET_CLOSE_FRAME, (void *)send_buf, send_length);
 }
 
+/* inflate a compressed message into `buf`, its frames are pulled in as the inflater runs dry */
+static int websocket_read_inflate(struct websocket_session *session, void *buf, size_t length)
+{
+    struct websocket_deflate *deflate = session->deflate;
+    char *chunk = websocket_inflate_chunk(deflate);
+    int res;
+
+    while (1)
+    {
+        res = websocket_inflate_pull(deflate, buf, length);
+        if (res > 0 && websocket_parser_check_utf8(session->parser) && websocket_utf8_update(&session->parser->utf8, buf, res) != WEBSOCKET_OK)
+        {
+            return -WEBSOCKET_INVALID_UTF8;
+        }
+
+        if (res >= 0 && !websocket_inflate_active(deflate) && websocket_parser_check_utf8(session->parser) &&
+            websocket_utf8_final(&session->parser->utf8) != WEBSOCKET_OK)
+        {
+            return -WEBSOCKET_INVALID_UTF8;
+        }
+
+        if (res != 0 || !websocket_inflate_active(deflate))
+        {
+            return res < 0 ? -WEBSOCKET_READ_ERROR : res;
+        }
+
+        if (session->info.remain_len != 0)
+        {
+            res = websocket_recv_payload(session, chunk, WEBSOCKET_DEFLATE_CHUNK_SIZE);
+            if (res <= 0)
+            {
+                return -WEBSOCKET_READ_ERROR;
+            }
+            websocket_inflate_push(deflate, chunk, res);
+        }
+        else if (!session->parser->in_message)
+        {
+            websocket_inflate_finish(deflate);
+        }
+        else if (websocket_get_block_info(session) != WEBSOCKET_OK)
+        {
+            return -WEBSOCKET_READ_ERROR;
+        }
+    }
+}
+
 int websocket_read(struct websocket_session *session, void *buf, size_t length)
 {
-    int recv_len = 0;
+    int res;
+
+    if (length == 0)
+    {
+        return 0;
+    }
 
-    if (session->info.remain_len == 0)
+    do
+    {
+        if (session->info.remain_len == 0 && !websocket_inflate_active(session->deflate))
+        {
+            if (websocket_get_block_info(session) != WEBSOCKET_OK)
+            {
+                return -WEBSOCKET_ERROR;
+            }
+
+            if (session->deflate && session->parser->message_rsv && session->info.frame_type != WEBSOCKET_CONTINUE_FRAME)
+            {
+                websocket_inflate_begin(session->deflate);
+            }
+        }
+
+        if (!websocket_inflate_active(session->deflate))
+        {
+            return websocket_recv_payload(session, buf, length);
+        }
+
+        /* a compressed message that inflates to nothing moves on to the next one */
+        res = websocket_read_inflate(session, buf, length);
+    }
+    while (res == 0);
+
+    return res;
+}
+
+int websocket_peek(struct websocket_session *session, const void **data, size_t *length)
+{
+    size_t n;
+
+    if (session == NULL || data == NULL || length == NULL || session->parser == NULL || session->recv_buf == NULL)
+    {
+        return -WEBSOCKET_READ_ERROR;
+    }
+
+    if (session->info.remain_len == 0 && !websocket_inflate_active(session->deflate))
     {
         if (websocket_get_block_info(session) != WEBSOCKET_OK)
         {
-            return -WEBSOCKET_ERROR;
+            return -WEBSOCKET_READ_ERROR;
         }
     }
 
-    if (session->info.remain_len < length)
+    /* a compressed payload does not exist in plain form in the buffer, websocket_read inflates it */
+    if (session->deflate && session->parser->message_rsv)
     {
-        length = session->info.remain_len;
+        return -WEBSOCKET_ERROR;
     }
 
-    if ((recv_len = websocket_recv(session, (void *)((char *)buf), length, 0)) <= 0)
+    if (session->recv_pos == session->recv_end && session->info.remain_len != 0)
     {
-        return recv_len;
+        if (websocket_recv_fill(session) <= 0)
+        {
+            return -WEBSOCKET_READ_ERROR;
+        }
     }
 
-    session->info.remain_len -= recv_len;
+    n = session->recv_end - session->recv_pos;
+    if (n > session->info.remain_len)
+    {
+        n = (size_t)session->info.remain_len;
+    }
 
-    return recv_len;
+    *data = session->recv_buf + session->recv_pos;
+    *length = n;
+
+    return (int)n;
+}
+
+int websocket_consume(struct websocket_session *session, size_t length)
+{
+    int res;
+
+    if (session == NULL || session->parser == NULL)
+    {
+        return -WEBSOCKET_READ_ERROR;
+    }
+
+    if (length > session->recv_end - session->recv_pos || length > session->info.remain_len)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    res = websocket_parser_execute(session->parser, NULL, NULL, session->recv_buf + session->recv_pos, length);
+    session->recv_pos += length;
+    session->info.remain_len -= length;
+
+    return res < 0 ? res : (int)length;
 }
 
 int websocket_write_slice(struct websocket_session *session, const void *buf, size_t length, websocket_frame_type_t opcode, websocket_slice_t slice_type)
 {
+    struct iovec iov, deflate_out;
+    int compressed, more, res;
     char fin = 0;
 
     if ((opcode != WEBSOCKET_TEXT_FRAME) && (opcode != WEBSOCKET_BIN_FRAME))
@@ -833,34 +1607,279 @@ int websocket_write_slice(struct websocket_session *session, const void *buf, si
         opcode = 0;
     }
 
-    return websocket_send_encode_package(session, buf, length, opcode, fin);
+    /* a compressed message is one deflate stream across its slices, RSV1 goes on the first frame only */
+    iov.iov_base = (void *)buf;
+    iov.iov_len = length;
+    ws_mutex_lock(&session->data_lock);
+    compressed = websocket_deflate_payload(session, &iov, 1, fin, &deflate_out, &more);
+    if (compressed < 0)
+        res = -WEBSOCKET_WRITE_ERROR;
+    else if (compressed)
+        res = websocket_send_deflated(session, &deflate_out, more, opcode, fin);
+    else
+        res = websocket_send_fragmented(session, &iov, 1, length, opcode, fin, 0);
+    ws_mutex_unlock(&session->data_lock);
+
+    return res < 0 ? res : (int)length;
 }
 
-int websocket_write(struct websocket_session *session, const void *buf, size_t length, websocket_frame_type_t opcode)
+/* send the frames collected in the cache and leave the frame boundary */
+static int websocket_batch_flush(struct websocket_session *session, unsigned char *stage, size_t used)
+{
+    int res = WEBSOCKET_OK;
+
+    if (websocket_send_nbytes(session, stage, used, 0) != (int)used)
+        res = -WEBSOCKET_WRITE_ERROR;
+    if (websocket_tx_unlock(session) != WEBSOCKET_OK)
+        res = -WEBSOCKET_WRITE_ERROR;
+
+    return res;
+}
+
+/* A batch message that does not go through the staging area but is streamed like a single write. */
+static int websocket_batch_streamed(struct websocket_session *session, uint64_t length)
+{
+    if (websocket_head_length(length) + length > session->cache_len)
+        return 1;
+
+    return session->max_frame_payload && length > session->max_frame_payload;
+}
+
+int websocket_write_batch(struct websocket_session *session, const struct ws_msg *msgs, size_t n)
 {
+    uint32_t mask_key[WEBSOCKET_BATCH_MASK_KEYS];
+    struct iovec iov, deflate_out;
+    const struct iovec *payload;
+    uint64_t payload_length;
+    unsigned char *stage, *ptr, rsv;
+    size_t used = 0, stage_len = 0, frame_length;
+    int compressed, more = 0, res = (int)n;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        if ((msgs[i].type != WEBSOCKET_TEXT_FRAME) && (msgs[i].type != WEBSOCKET_BIN_FRAME))
+            return -WEBSOCKET_WRITE_ERROR;
+
+        if (!websocket_batch_streamed(session, msgs[i].length))
+            stage_len += websocket_head_length(msgs[i].length) + msgs[i].length;
+    }
+
+    /* The staging area is sized to the whole batch so its frames leave in one send (one writev on the
+     * service queue, one record run on TLS). Only a batch larger than the cache needs the extra buffer,
+     * it lives for this call and holds at most n cache-sized frames. When it cannot be had the cache is
+     * used and flushed whenever the next frame does not fit. Compressed frames are sized by their
+     * uncompressed length, one that comes out larger than that flushes early. */
+    ws_mutex_lock(&session->data_lock);
+    stage = (unsigned char *)session->cache;
+    if (stage_len > session->cache_len && (stage = (unsigned char *)ws_malloc(stage_len)) == NULL)
+    {
+        stage = (unsigned char *)session->cache;
+    }
+    if (stage == (unsigned char *)session->cache)
+    {
+        stage_len = session->cache_len;
+    }
+
+    /* Frames are encoded back to back in the staging area, a message larger than the cache is streamed
+     * on its own. tx_lock is held while the staging area has frames in it, queued control frames go out
+     * after every flush. */
+    for (size_t i = 0; i < n; i++)
+    {
+        if (i % WEBSOCKET_BATCH_MASK_KEYS == 0)
+        {
+            ws_srand_key((unsigned char *)mask_key, sizeof(mask_key));
+        }
+
+        iov.iov_base = (void *)msgs[i].data;
+        iov.iov_len = msgs[i].length;
+        payload = &iov;
+        compressed = websocket_deflate_payload(session, &iov, 1, 1, &deflate_out, &more);
+        if (compressed < 0)
+        {
+            if (used)
+                websocket_tx_unlock(session);
+            used = 0;
+            res = -WEBSOCKET_WRITE_ERROR;
+            break;
+        }
+        if (compressed)
+            payload = &deflate_out;
+        payload_length = payload->iov_len;
+        rsv = compressed ? WEBSOCKET_FRAME_RSV1 : 0;
+
+        frame_length = websocket_head_length(payload_length) + payload_length;
+        /* the streamed and fragmented paths take tx_lock and may use the cache themselves, the stage goes out first */
+        if (used && (used + frame_length > stage_len || websocket_control_pending(session) || (compressed && more) ||
+                     websocket_batch_streamed(session, payload_length)))
+        {
+            res = websocket_batch_flush(session, stage, used) == WEBSOCKET_OK ? res : -WEBSOCKET_WRITE_ERROR;
+            used = 0;
+            if (res < 0)
+                break;
+        }
+
+        /* a message that compresses into several chunks leaves as a fragmented message of its own */
+        if (compressed && more)
+        {
+            if (websocket_send_deflated(session, &deflate_out, more, msgs[i].type, 1) != WEBSOCKET_OK)
+            {
+                res = -WEBSOCKET_WRITE_ERROR;
+                break;
+            }
+            continue;
+        }
+
+        if (frame_length > stage_len || websocket_batch_streamed(session, payload_length))
+        {
+            if (websocket_send_fragmented(session, payload, 1, payload_length, msgs[i].type, 1, rsv) != (int)payload_length)
+            {
+                res = -WEBSOCKET_WRITE_ERROR;
+                break;
+            }
+            continue;
+        }
+
+        if (used == 0 && websocket_tx_lock(session) != WEBSOCKET_OK)
+        {
+            res = -WEBSOCKET_WRITE_ERROR;
+            break;
+        }
+
+        ptr = stage + used;
+        used += websocket_encode_head(ptr, msgs[i].type, 1, rsv, payload_length, (unsigned char *)&mask_key[i % WEBSOCKET_BATCH_MASK_KEYS]);
+        websocket_mask(stage + used, payload->iov_base, payload_length, (unsigned char *)&mask_key[i % WEBSOCKET_BATCH_MASK_KEYS], 0);
+        used += payload_length;
+    }
+
+    if (used && websocket_batch_flush(session, stage, used) != WEBSOCKET_OK)
+    {
+        res = -WEBSOCKET_WRITE_ERROR;
+    }
+
+    if (stage != (unsigned char *)session->cache)
+    {
+        ws_free(stage);
+    }
+    ws_mutex_unlock(&session->data_lock);
+
+    return res;
+}
+
+int websocket_writev(struct websocket_session *session, const struct iovec *iov, int iovcnt, websocket_frame_type_t opcode)
+{
+    struct iovec deflate_out;
+    uint64_t length = 0;
+    int compressed, more, res;
+
     if ((opcode != WEBSOCKET_TEXT_FRAME) && (opcode != WEBSOCKET_BIN_FRAME))
         return -WEBSOCKET_WRITE_ERROR;
 
-    return websocket_send_encode_package(session, buf, length, opcode, 1);
+    if (iov == NULL || iovcnt < 0)
+        return -WEBSOCKET_WRITE_ERROR;
+
+    for (int i = 0; i < iovcnt; i++)
+    {
+        length += iov[i].iov_len;
+    }
+
+    ws_mutex_lock(&session->data_lock);
+    compressed = websocket_deflate_payload(session, iov, iovcnt, 1, &deflate_out, &more);
+    if (compressed < 0)
+        res = -WEBSOCKET_WRITE_ERROR;
+    else if (compressed)
+        res = websocket_send_deflated(session, &deflate_out, more, opcode, 1);
+    else
+        res = websocket_send_fragmented(session, iov, iovcnt, length, opcode, 1, 0);
+    ws_mutex_unlock(&session->data_lock);
+
+    return res < 0 ? res : (int)length;
+}
+
+int websocket_write(struct websocket_session *session, const void *buf, size_t length, websocket_frame_type_t opcode)
+{
+    struct iovec iov;
+
+    iov.iov_base = (void *)buf;
+    iov.iov_len = length;
+
+    return websocket_writev(session, &iov, 1, opcode);
 }
 
 int websocket_session_init(struct websocket_session *session)
 {
     ws_memset(session, 0, sizeof(struct websocket_session));
     session->socket_fd = -1;
+    ws_mutex_init(&session->data_lock);
+    ws_mutex_init(&session->tx_lock);
+    ws_mutex_init(&session->control_lock);
 
     return WEBSOCKET_OK;
 }
 
+void websocket_session_deinit(struct websocket_session *session)
+{
+    ws_mutex_destroy(&session->data_lock);
+    ws_mutex_destroy(&session->tx_lock);
+    ws_mutex_destroy(&session->control_lock);
+}
+
+/* back to the state of a fresh session, the locks are initialised once and kept */
+static void websocket_session_reset(struct websocket_session *session)
+{
+    ws_memset(session, 0, offsetof(struct websocket_session, data_lock));
+    session->socket_fd = -1;
+}
+
+int websocket_recv_pending(struct websocket_session *session)
+{
+    size_t pending = session->recv_end - session->recv_pos;
+
+    if (session->tls_session)
+        pending += mbedtls_ssl_get_bytes_avail(&((MbedTLSSession *)session->tls_session)->ssl);
+
+    return (int)pending;
+}
+
+/*
+ * Close the connection and free what it used. Writers on other threads use the socket and the cache
+ * under tx_lock, so both go away under it, and a writer that comes after finds no socket.
+ */
 static void websocket_recycle_resources(struct websocket_session *session)
 {
+    ws_mutex_lock(&session->tx_lock);
+    ws_mutex_lock(&session->control_lock);
+
+    if (session->tls_session)
+    {
+        mbedtls_client_close(session->tls_session);
+        session->socket_fd = -1;
+    }
+
+    if (session->socket_fd >= 0)
+    {
+        close(session->socket_fd);
+        session->socket_fd = -1;
+    }
+
     if (session->cache)
         ws_free(session->cache);
 
+    if (session->recv_buf)
+        ws_free(session->recv_buf);
+
+    if (session->parser)
+        ws_free(session->parser);
+
+    if (session->deflate)
+        websocket_deflate_free(session->deflate);
+
     if (session->subprotocol)
         ws_free(session->subprotocol);
 
-    websocket_session_init(session);
+    websocket_session_reset(session);
+
+    ws_mutex_unlock(&session->control_lock);
+    ws_mutex_unlock(&session->tx_lock);
 }
 
 static int websocket_using_tls(struct websocket_session *session, const char *port, const char *host)
@@ -884,7 +1903,12 @@ static int websocket_using_tls(struct websocket_session *session, const char *po
             res = mbedtls_client_connect(session->tls_session);
 
         if (res == WEBSOCKET_OK)
+        {
+            /* mbedtls creates and connects the socket itself, the buffer sizes apply from here on */
             session->socket_fd = ((MbedTLSSession *)session->tls_session)->server_fd.fd;
+            websocket_socket_options_pre_connect(session, session->socket_fd);
+            websocket_socket_options_post_connect(session, session->socket_fd);
+        }
     }
 
     return res;
@@ -910,6 +1934,8 @@ static int websocket_connect_server(struct websocket_session *session, const cha
         res = -WEBSOCKET_CONNECT_FAILED;
     }
 
+    websocket_socket_options_pre_connect(session, socket_handle);
+
     if (res == WEBSOCKET_OK)
     {
         ws_memset(&serv_addr, 0, sizeof(serv_addr));
@@ -924,23 +1950,14 @@ static int websocket_connect_server(struct websocket_session *session, const cha
     }
     session->socket_fd = socket_handle;
 
+    if (res == WEBSOCKET_OK)
+        websocket_socket_options_post_connect(session, socket_handle);
+
     return res;
 }
 
 int websocket_disconnect(struct websocket_session *session)
 {
-    if (session->tls_session)
-    {
-        mbedtls_client_close(session->tls_session);
-        session->socket_fd = -1;
-    }
-
-    if (session->socket_fd >= 0)
-    {
-        close(session->socket_fd);
-        session->socket_fd = -1;
-    }
-
     websocket_recycle_resources(session);
     return WEBSOCKET_OK;
 }
@@ -953,16 +1970,36 @@ int websocket_connect(struct websocket_session *session, const char *url, const
     char *host = NULL;
     int is_wss = 0;
 
-    if (session->cache == NULL)
+    if (websocket_cache_alloc(session) != WEBSOCKET_OK)
     {
-        session->cache = ws_malloc(WEBSOCKET_CACHE_BUFFER_SIZE);
-        if (session->cache == NULL)
+        websocket_recycle_resources(session);
+        return -WEBSOCKET_NOMEM;
+    }
+
+    if (session->recv_buf == NULL)
+    {
+        /* one spare byte past the end, so a payload handed out in place can be NUL-terminated */
+        session->recv_buf = ws_malloc(WEBSOCKET_RECV_BUFFER_SIZE + 1);
+        if (session->recv_buf == NULL)
+        {
+            websocket_recycle_resources(session);
+            return -WEBSOCKET_NOMEM;
+        }
+        session->recv_buf_len = WEBSOCKET_RECV_BUFFER_SIZE;
+        session->recv_pos = session->recv_end = 0;
+    }
+
+    if (session->parser == NULL)
+    {
+        session->parser = ws_malloc(sizeof(struct websocket_parser));
+        if (session->parser == NULL)
         {
-            websocket_session_init(session);
+            websocket_recycle_resources(session);
             return -WEBSOCKET_NOMEM;
         }
-        session->cache_len = WEBSOCKET_CACHE_BUFFER_SIZE;
     }
+    websocket_parser_init(session->parser);
+    session->parser->validate_utf8 = session->utf8_validate ? 1 : 0;
 
     if (session->socket_fd > 0)
         return -WEBSOCKET_IS_CONNECT;
@@ -0,0 +1,68 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date          Author       Notes
+ * 2026-10-16    tzy          first implementation
+ */
+#include "websocket_backoff.h"
+#include "websocket_random.h"
+
+/* base_ms << 20 already covers any sensible max_ms, the shift stops there */
+#define WEBSOCKET_BACKOFF_SHIFT_MAX         (20)
+
+uint32_t websocket_backoff_bound(const struct websocket_backoff *backoff)
+{
+    int shift = backoff->attempt < WEBSOCKET_BACKOFF_SHIFT_MAX ? backoff->attempt : WEBSOCKET_BACKOFF_SHIFT_MAX;
+    uint64_t bound = (uint64_t)backoff->base_ms << shift;
+
+    if (backoff->max_ms && bound > backoff->max_ms)
+    {
+        bound = backoff->max_ms;
+    }
+
+    return bound > UINT32_MAX ? UINT32_MAX : (uint32_t)bound;
+}
+
+uint32_t websocket_backoff_jitter(uint32_t bound)
+{
+    uint64_t r;
+
+    websocket_random_bytes(&r, sizeof(r));
+    return (uint32_t)(r % ((uint64_t)bound + 1));
+}
+
+int64_t websocket_backoff_next(struct websocket_backoff *backoff)
+{
+    uint32_t bound;
+
+    if (backoff->base_ms == 0 || (backoff->max_attempts && backoff->attempt >= backoff->max_attempts))
+    {
+        return -1;
+    }
+
+    bound = websocket_backoff_bound(backoff);
+    backoff->attempt += 1;
+
+    return websocket_backoff_jitter(bound);
+}
+
+int websocket_backoff_acquire(struct websocket_backoff_limit *limit)
+{
+    int active = __atomic_load_n(&limit->active, __ATOMIC_RELAXED);
+
+    do
+    {
+        if (active >= __atomic_load_n(&limit->limit, __ATOMIC_RELAXED))
+        {
+            return 0;
+        }
+    } while (!__atomic_compare_exchange_n(&limit->active, &active, active + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    return 1;
+}
+
+void websocket_backoff_release(struct websocket_backoff_limit *limit)
+{
+    __atomic_sub_fetch(&limit->active, 1, __ATOMIC_RELEASE);
+}
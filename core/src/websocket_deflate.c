@@ -0,0 +1,401 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date          Author       Notes
+ * 2026-10-16    tzy          first implementation
+ * 2026-10-16    tzy          compress into bounded chunks
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "websocket.h"
+#include "websocket_parser.h"
+#include "websocket_deflate.h"
+
+#ifdef WEBSOCKET_USING_DEFLATE
+#include <zlib.h>
+
+#define WEBSOCKET_DEFLATE_WINDOW_MIN        9
+#define WEBSOCKET_DEFLATE_WINDOW_MAX        15
+
+struct websocket_deflate
+{
+    z_stream tx;
+    z_stream rx;
+    int client_window_bits;
+    int server_window_bits;
+    int client_no_context_takeover;
+    int server_no_context_takeover;
+    size_t threshold;
+    int tx_message;         /* 1: the message being sent is compressed, -1: it is not */
+    const struct iovec *tx_iov;
+    int tx_iovcnt;
+    int tx_seg;
+    int tx_fin;
+    int tx_flush;           /* 1: the sync flush of the part has started, 2: it is complete */
+    size_t tx_held;         /* bytes of the last chunk kept back, they may be the tail */
+    int rx_active;
+    int rx_final;
+    unsigned char out[WEBSOCKET_DEFLATE_OUT_SIZE];
+    char chunk[WEBSOCKET_DEFLATE_CHUNK_SIZE];
+};
+
+/* every compressed message ends with an empty stored block, it is stripped on the wire */
+static const unsigned char websocket_deflate_tail[4] = { 0x00, 0x00, 0xff, 0xff };
+
+int websocket_deflate_offer(const struct websocket_deflate_options *options, char *buf, int size)
+{
+    int length;
+
+    length = snprintf(buf, size, "Sec-WebSocket-Extensions: permessage-deflate");
+    if (options->client_max_window_bits)
+        length += snprintf(buf + length, size > length ? size - length : 0, "; client_max_window_bits=%d", options->client_max_window_bits);
+    else
+        length += snprintf(buf + length, size > length ? size - length : 0, "; client_max_window_bits");
+    if (options->server_max_window_bits)
+        length += snprintf(buf + length, size > length ? size - length : 0, "; server_max_window_bits=%d", options->server_max_window_bits);
+    if (options->client_no_context_takeover)
+        length += snprintf(buf + length, size > length ? size - length : 0, "; client_no_context_takeover");
+    if (options->server_no_context_takeover)
+        length += snprintf(buf + length, size > length ? size - length : 0, "; server_no_context_takeover");
+    length += snprintf(buf + length, size > length ? size - length : 0, "\r\n");
+
+    return length < size ? length : -1;
+}
+
+static int websocket_deflate_window_bits(const char *value, int *bits)
+{
+    char *end;
+    long n = strtol(value, &end, 10);
+
+    if (end == value || n < WEBSOCKET_DEFLATE_WINDOW_MIN || n > WEBSOCKET_DEFLATE_WINDOW_MAX)
+        return -WEBSOCKET_ERROR;
+    *bits = (int)n;
+
+    return WEBSOCKET_OK;
+}
+
+static int websocket_deflate_param(struct websocket_deflate *state, const struct websocket_deflate_options *options, const char *param)
+{
+    const char *value = strchr(param, '=');
+    size_t name_len = value ? (size_t)(value - param) : strlen(param);
+
+    while (name_len && param[name_len - 1] == ' ')
+        name_len--;
+    if (value)
+    {
+        value += 1;
+        while (*value == ' ' || *value == '"')
+            value++;
+    }
+
+#define WEBSOCKET_PARAM_IS(name) (name_len == strlen(name) && strncasecmp(param, name, name_len) == 0)
+    if (WEBSOCKET_PARAM_IS("server_no_context_takeover"))
+    {
+        state->server_no_context_takeover = 1;
+    }
+    else if (WEBSOCKET_PARAM_IS("client_no_context_takeover"))
+    {
+        state->client_no_context_takeover = 1;
+    }
+    else if (WEBSOCKET_PARAM_IS("server_max_window_bits"))
+    {
+        if (value == NULL || websocket_deflate_window_bits(value, &state->server_window_bits) != WEBSOCKET_OK)
+            return -WEBSOCKET_ERROR;
+    }
+    else if (WEBSOCKET_PARAM_IS("client_max_window_bits"))
+    {
+        /* the server may only lower the window we offered */
+        if (value == NULL || websocket_deflate_window_bits(value, &state->client_window_bits) != WEBSOCKET_OK)
+            return -WEBSOCKET_ERROR;
+        if (options->client_max_window_bits && state->client_window_bits > options->client_max_window_bits)
+            return -WEBSOCKET_ERROR;
+    }
+    else
+    {
+        return -WEBSOCKET_ERROR;
+    }
+#undef WEBSOCKET_PARAM_IS
+
+    return WEBSOCKET_OK;
+}
+
+int websocket_deflate_accept(struct websocket_session *session, const char *value)
+{
+    const struct websocket_deflate_options *options = &session->deflate_opt;
+    struct websocket_deflate *state;
+    char param[64];
+    const char *ptr, *end;
+    size_t length;
+    int level, res = WEBSOCKET_OK;
+
+    while (*value == ' ')
+        value++;
+    if (!options->enable || session->deflate != NULL || strncasecmp(value, "permessage-deflate", strlen("permessage-deflate")) != 0)
+        return -WEBSOCKET_CONNECT_FAILED;
+
+    state = ws_malloc(sizeof(struct websocket_deflate));
+    if (state == NULL)
+        return -WEBSOCKET_NOMEM;
+    ws_memset(state, 0, sizeof(struct websocket_deflate));
+    state->client_window_bits = options->client_max_window_bits ? options->client_max_window_bits : WEBSOCKET_DEFLATE_WINDOW_MAX;
+    state->server_window_bits = WEBSOCKET_DEFLATE_WINDOW_MAX;
+    state->threshold = options->threshold;
+
+    ptr = strchr(value, ';');
+    while (ptr != NULL && res == WEBSOCKET_OK)
+    {
+        ptr += 1;
+        while (*ptr == ' ')
+            ptr++;
+        end = strchr(ptr, ';');
+        length = end ? (size_t)(end - ptr) : strlen(ptr);
+        while (length && (ptr[length - 1] == ' ' || ptr[length - 1] == '\r'))
+            length--;
+        if (length >= sizeof(param))
+        {
+            res = -WEBSOCKET_CONNECT_FAILED;
+            break;
+        }
+        ws_memcpy(param, ptr, length);
+        param[length] = '\0';
+        if (length && websocket_deflate_param(state, options, param) != WEBSOCKET_OK)
+            res = -WEBSOCKET_CONNECT_FAILED;
+        ptr = end;
+    }
+
+    /* the compressor follows our own setting even if the server did not echo it */
+    if (options->client_no_context_takeover)
+        state->client_no_context_takeover = 1;
+
+    level = options->level ? options->level : Z_DEFAULT_COMPRESSION;
+    if (res == WEBSOCKET_OK && deflateInit2(&state->tx, level, Z_DEFLATED, -state->client_window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        res = -WEBSOCKET_NOMEM;
+    }
+    else if (res == WEBSOCKET_OK && inflateInit2(&state->rx, -state->server_window_bits) != Z_OK)
+    {
+        deflateEnd(&state->tx);
+        res = -WEBSOCKET_NOMEM;
+    }
+
+    if (res != WEBSOCKET_OK)
+    {
+        ws_free(state);
+        return res;
+    }
+
+    session->deflate = state;
+    session->parser->rsv_allowed |= WEBSOCKET_DEFLATE_RSV;
+
+    return WEBSOCKET_OK;
+}
+
+void websocket_deflate_free(struct websocket_deflate *state)
+{
+    if (state == NULL)
+        return;
+
+    deflateEnd(&state->tx);
+    inflateEnd(&state->rx);
+    ws_free(state);
+}
+
+int websocket_deflate_begin(struct websocket_deflate *state, const struct iovec *iov, int iovcnt, int fin)
+{
+    size_t length = 0;
+
+    if (state->tx_message == 0)
+    {
+        for (int i = 0; i < iovcnt; i++)
+            length += iov[i].iov_len;
+        state->tx_message = length < state->threshold ? -1 : 1;
+    }
+
+    if (state->tx_message < 0)
+    {
+        if (fin)
+            state->tx_message = 0;
+        return 1;
+    }
+
+    state->tx_iov = iov;
+    state->tx_iovcnt = iovcnt;
+    state->tx_seg = 0;
+    state->tx_fin = fin;
+    state->tx_flush = 0;
+    state->tx_held = 0;
+    state->tx.avail_in = 0;
+
+    return WEBSOCKET_OK;
+}
+
+int websocket_deflate_next(struct websocket_deflate *state, struct iovec *out)
+{
+    z_stream *strm = &state->tx;
+    size_t used;
+    int res;
+
+    /* The last bytes of a full chunk are held back and open the next one: the empty stored block that
+     * ends the message has to be stripped, and it is only known to be the tail once the flush is done. */
+    if (state->tx_held)
+        ws_memmove(state->out, state->out + WEBSOCKET_DEFLATE_OUT_SIZE - state->tx_held, state->tx_held);
+    strm->next_out = state->out + state->tx_held;
+    strm->avail_out = (uInt)(WEBSOCKET_DEFLATE_OUT_SIZE - state->tx_held);
+
+    while (strm->avail_out && state->tx_flush != 2)
+    {
+        if (strm->avail_in == 0 && state->tx_seg < state->tx_iovcnt)
+        {
+            strm->next_in = (Bytef *)state->tx_iov[state->tx_seg].iov_base;
+            strm->avail_in = (uInt)state->tx_iov[state->tx_seg].iov_len;
+            state->tx_seg += 1;
+            continue;
+        }
+
+        /* a sync flush ends every part on a byte boundary, so each one can be sent as soon as it is ready */
+        if (strm->avail_in == 0)
+            state->tx_flush = 1;
+        res = deflate(strm, state->tx_flush ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+        if (res != Z_OK && res != Z_BUF_ERROR)
+            return -WEBSOCKET_ERROR;
+        if (state->tx_flush && strm->avail_out)
+            state->tx_flush = 2;
+    }
+
+    used = WEBSOCKET_DEFLATE_OUT_SIZE - strm->avail_out;
+    out->iov_base = state->out;
+
+    if (state->tx_flush != 2)
+    {
+        state->tx_held = sizeof(websocket_deflate_tail);
+        out->iov_len = used - state->tx_held;
+        return 1;
+    }
+
+    out->iov_len = used;
+    state->tx_held = 0;
+    if (state->tx_fin)
+    {
+        if (out->iov_len >= sizeof(websocket_deflate_tail))
+            out->iov_len -= sizeof(websocket_deflate_tail);
+        if (state->client_no_context_takeover)
+            deflateReset(strm);
+        state->tx_message = 0;
+    }
+
+    return 0;
+}
+
+void websocket_inflate_begin(struct websocket_deflate *state)
+{
+    state->rx_active = 1;
+    state->rx_final = 0;
+    state->rx.avail_in = 0;
+}
+
+void websocket_inflate_push(struct websocket_deflate *state, const void *data, size_t length)
+{
+    state->rx.next_in = (Bytef *)data;
+    state->rx.avail_in = (uInt)length;
+}
+
+void websocket_inflate_finish(struct websocket_deflate *state)
+{
+    state->rx_final = 1;
+    websocket_inflate_push(state, websocket_deflate_tail, sizeof(websocket_deflate_tail));
+}
+
+int websocket_inflate_pull(struct websocket_deflate *state, void *buf, size_t length)
+{
+    z_stream *strm = &state->rx;
+    int res;
+
+    if (!state->rx_active || length == 0)
+        return 0;
+
+    strm->next_out = (Bytef *)buf;
+    strm->avail_out = (uInt)length;
+    res = inflate(strm, Z_SYNC_FLUSH);
+    if (res != Z_OK && res != Z_BUF_ERROR && res != Z_STREAM_END)
+        return -WEBSOCKET_ERROR;
+
+    /* the output was not filled, so everything up to the tail is out and the message is done */
+    if (state->rx_final && strm->avail_in == 0 && strm->avail_out != 0)
+    {
+        state->rx_active = 0;
+        state->rx_final = 0;
+        if (state->server_no_context_takeover || res == Z_STREAM_END)
+            inflateReset(strm);
+    }
+
+    return (int)(length - strm->avail_out);
+}
+
+int websocket_inflate_active(const struct websocket_deflate *state)
+{
+    return state != NULL && state->rx_active;
+}
+
+char *websocket_inflate_chunk(struct websocket_deflate *state)
+{
+    return state->chunk;
+}
+
+#else
+
+/* built without zlib: nothing is offered, so session->deflate always stays NULL */
+int websocket_deflate_offer(const struct websocket_deflate_options *options, char *buf, int size)
+{
+    return 0;
+}
+
+int websocket_deflate_accept(struct websocket_session *session, const char *value)
+{
+    return -WEBSOCKET_CONNECT_FAILED;
+}
+
+void websocket_deflate_free(struct websocket_deflate *state)
+{
+}
+
+int websocket_deflate_begin(struct websocket_deflate *state, const struct iovec *iov, int iovcnt, int fin)
+{
+    return 1;
+}
+
+int websocket_deflate_next(struct websocket_deflate *state, struct iovec *out)
+{
+    return -WEBSOCKET_ERROR;
+}
+
+void websocket_inflate_begin(struct websocket_deflate *state)
+{
+}
+
+void websocket_inflate_push(struct websocket_deflate *state, const void *data, size_t length)
+{
+}
+
+void websocket_inflate_finish(struct websocket_deflate *state)
+{
+}
+
+int websocket_inflate_pull(struct websocket_deflate *state, void *buf, size_t length)
+{
+    return 0;
+}
+
+int websocket_inflate_active(const struct websocket_deflate *state)
+{
+    return 0;
+}
+
+char *websocket_inflate_chunk(struct websocket_deflate *state)
+{
+    return NULL;
+}
+
+#endif
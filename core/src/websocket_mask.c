@@ -0,0 +1,350 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date          Author       Notes
+ * 2026-10-16    tzy          first implementation
+ */
+#include <string.h>
+#include "websocket.h"
+#include "websocket_mask.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define WEBSOCKET_MASK_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define WEBSOCKET_MASK_NEON
+#include <arm_neon.h>
+#endif
+
+typedef void (*websocket_mask_fn)(unsigned char *dst, const unsigned char *src, size_t length, uint32_t key);
+
+/*
+ * Every kernel receives the key already rotated to the phase of dst[0], so all
+ * word and vector lanes share one pattern and no lane ever needs `i % 4`.
+ */
+static uint32_t websocket_mask_rotate(const unsigned char mask_key[4], size_t offset)
+{
+    unsigned char rotated[4];
+    uint32_t key;
+
+    for (int i = 0; i < 4; i++)
+    {
+        rotated[i] = mask_key[(offset + i) & 3];
+    }
+    memcpy(&key, rotated, sizeof(key));
+
+    return key;
+}
+
+static void websocket_mask_tail(unsigned char *dst, const unsigned char *src, size_t length, uint32_t key)
+{
+    uint64_t key64 = ((uint64_t)key << 32) | key;
+    uint64_t word;
+    uint32_t word32;
+
+    while (length >= sizeof(uint64_t))
+    {
+        memcpy(&word, src, sizeof(word));
+        word ^= key64;
+        memcpy(dst, &word, sizeof(word));
+        src += sizeof(word);
+        dst += sizeof(word);
+        length -= sizeof(word);
+    }
+
+    if (length >= sizeof(uint32_t))
+    {
+        memcpy(&word32, src, sizeof(word32));
+        word32 ^= key;
+        memcpy(dst, &word32, sizeof(word32));
+        src += sizeof(word32);
+        dst += sizeof(word32);
+        length -= sizeof(word32);
+    }
+
+    for (size_t i = 0; i < length; i++)
+    {
+        dst[i] = src[i] ^ ((unsigned char *)&key)[i];
+    }
+}
+
+static void websocket_mask_scalar(unsigned char *dst, const unsigned char *src, size_t length, uint32_t key)
+{
+    uint64_t key64 = ((uint64_t)key << 32) | key;
+    uint64_t word[4];
+
+    /* Mask 4X long words at a time if possible. */
+    while (length >= sizeof(word))
+    {
+        memcpy(word, src, sizeof(word));
+        word[0] ^= key64;
+        word[1] ^= key64;
+        word[2] ^= key64;
+        word[3] ^= key64;
+        memcpy(dst, word, sizeof(word));
+        src += sizeof(word);
+        dst += sizeof(word);
+        length -= sizeof(word);
+    }
+
+    websocket_mask_tail(dst, src, length, key);
+}
+
+#ifdef WEBSOCKET_MASK_X86
+__attribute__((target("sse2")))
+static void websocket_mask_sse2(unsigned char *dst, const unsigned char *src, size_t length, uint32_t key)
+{
+    __m128i mask = _mm_set1_epi32((int)key);
+
+    while (length >= 64)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + 0));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *)(src + 32));
+        __m128i d = _mm_loadu_si128((const __m128i *)(src + 48));
+        _mm_storeu_si128((__m128i *)(dst + 0), _mm_xor_si128(a, mask));
+        _mm_storeu_si128((__m128i *)(dst + 16), _mm_xor_si128(b, mask));
+        _mm_storeu_si128((__m128i *)(dst + 32), _mm_xor_si128(c, mask));
+        _mm_storeu_si128((__m128i *)(dst + 48), _mm_xor_si128(d, mask));
+        src += 64;
+        dst += 64;
+        length -= 64;
+    }
+
+    while (length >= 16)
+    {
+        _mm_storeu_si128((__m128i *)dst, _mm_xor_si128(_mm_loadu_si128((const __m128i *)src), mask));
+        src += 16;
+        dst += 16;
+        length -= 16;
+    }
+
+    websocket_mask_tail(dst, src, length, key);
+}
+
+__attribute__((target("avx2")))
+static void websocket_mask_avx2(unsigned char *dst, const unsigned char *src, size_t length, uint32_t key)
+{
+    __m256i mask = _mm256_set1_epi32((int)key);
+
+    while (length >= 128)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(src + 0));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(src + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i *)(src + 64));
+        __m256i d = _mm256_loadu_si256((const __m256i *)(src + 96));
+        _mm256_storeu_si256((__m256i *)(dst + 0), _mm256_xor_si256(a, mask));
+        _mm256_storeu_si256((__m256i *)(dst + 32), _mm256_xor_si256(b, mask));
+        _mm256_storeu_si256((__m256i *)(dst + 64), _mm256_xor_si256(c, mask));
+        _mm256_storeu_si256((__m256i *)(dst + 96), _mm256_xor_si256(d, mask));
+        src += 128;
+        dst += 128;
+        length -= 128;
+    }
+
+    while (length >= 32)
+    {
+        _mm256_storeu_si256((__m256i *)dst, _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)src), mask));
+        src += 32;
+        dst += 32;
+        length -= 32;
+    }
+
+    if (length >= 16)
+    {
+        __m128i mask128 = _mm256_castsi256_si128(mask);
+        _mm_storeu_si128((__m128i *)dst, _mm_xor_si128(_mm_loadu_si128((const __m128i *)src), mask128));
+        src += 16;
+        dst += 16;
+        length -= 16;
+    }
+
+    websocket_mask_tail(dst, src, length, key);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void websocket_mask_avx512(unsigned char *dst, const unsigned char *src, size_t length, uint32_t key)
+{
+    __m512i mask = _mm512_set1_epi32((int)key);
+
+    while (length >= 256)
+    {
+        __m512i a = _mm512_loadu_si512((const void *)(src + 0));
+        __m512i b = _mm512_loadu_si512((const void *)(src + 64));
+        __m512i c = _mm512_loadu_si512((const void *)(src + 128));
+        __m512i d = _mm512_loadu_si512((const void *)(src + 192));
+        _mm512_storeu_si512((void *)(dst + 0), _mm512_xor_si512(a, mask));
+        _mm512_storeu_si512((void *)(dst + 64), _mm512_xor_si512(b, mask));
+        _mm512_storeu_si512((void *)(dst + 128), _mm512_xor_si512(c, mask));
+        _mm512_storeu_si512((void *)(dst + 192), _mm512_xor_si512(d, mask));
+        src += 256;
+        dst += 256;
+        length -= 256;
+    }
+
+    while (length >= 64)
+    {
+        _mm512_storeu_si512((void *)dst, _mm512_xor_si512(_mm512_loadu_si512((const void *)src), mask));
+        src += 64;
+        dst += 64;
+        length -= 64;
+    }
+
+    /* the tail is a masked load/store, the lanes past the end are never touched */
+    if (length)
+    {
+        __mmask64 tail = (__mmask64)(~0ULL >> (64 - length));
+        __m512i data = _mm512_maskz_loadu_epi8(tail, (const void *)src);
+        _mm512_mask_storeu_epi8((void *)dst, tail, _mm512_xor_si512(data, mask));
+    }
+}
+#endif
+
+#ifdef WEBSOCKET_MASK_NEON
+static void websocket_mask_neon(unsigned char *dst, const unsigned char *src, size_t length, uint32_t key)
+{
+    uint8x16_t mask = vreinterpretq_u8_u32(vdupq_n_u32(key));
+
+    while (length >= 64)
+    {
+        uint8x16_t a = vld1q_u8(src + 0);
+        uint8x16_t b = vld1q_u8(src + 16);
+        uint8x16_t c = vld1q_u8(src + 32);
+        uint8x16_t d = vld1q_u8(src + 48);
+        vst1q_u8(dst + 0, veorq_u8(a, mask));
+        vst1q_u8(dst + 16, veorq_u8(b, mask));
+        vst1q_u8(dst + 32, veorq_u8(c, mask));
+        vst1q_u8(dst + 48, veorq_u8(d, mask));
+        src += 64;
+        dst += 64;
+        length -= 64;
+    }
+
+    while (length >= 16)
+    {
+        vst1q_u8(dst, veorq_u8(vld1q_u8(src), mask));
+        src += 16;
+        dst += 16;
+        length -= 16;
+    }
+
+    websocket_mask_tail(dst, src, length, key);
+}
+#endif
+
+static void websocket_mask_resolve(unsigned char *dst, const unsigned char *src, size_t length, uint32_t key);
+
+static websocket_mask_fn websocket_mask_kernel_fn = websocket_mask_resolve;
+static websocket_mask_kernel_t websocket_mask_kernel_id = WEBSOCKET_MASK_KERNEL_AUTO;
+
+static const char *websocket_mask_kernel_names[WEBSOCKET_MASK_KERNEL_MAX] =
+{
+    "auto", "scalar", "sse2", "avx2", "avx512", "neon"
+};
+
+static websocket_mask_fn websocket_mask_kernel_lookup(websocket_mask_kernel_t kernel)
+{
+    websocket_mask_fn fn = NULL;
+
+    switch (kernel)
+    {
+    case WEBSOCKET_MASK_KERNEL_SCALAR:
+        fn = websocket_mask_scalar;
+        break;
+#ifdef WEBSOCKET_MASK_X86
+    case WEBSOCKET_MASK_KERNEL_SSE2:
+        fn = __builtin_cpu_supports("sse2") ? websocket_mask_sse2 : NULL;
+        break;
+    case WEBSOCKET_MASK_KERNEL_AVX2:
+        fn = __builtin_cpu_supports("avx2") ? websocket_mask_avx2 : NULL;
+        break;
+    case WEBSOCKET_MASK_KERNEL_AVX512:
+        fn = (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) ? websocket_mask_avx512 : NULL;
+        break;
+#endif
+#ifdef WEBSOCKET_MASK_NEON
+    case WEBSOCKET_MASK_KERNEL_NEON:
+        fn = websocket_mask_neon;
+        break;
+#endif
+    default:
+        break;
+    }
+
+    return fn;
+}
+
+int websocket_mask_kernel_supported(websocket_mask_kernel_t kernel)
+{
+    return kernel == WEBSOCKET_MASK_KERNEL_AUTO || websocket_mask_kernel_lookup(kernel) != NULL;
+}
+
+int websocket_mask_kernel_select(websocket_mask_kernel_t kernel)
+{
+    const websocket_mask_kernel_t prefer[] =
+    {
+        WEBSOCKET_MASK_KERNEL_AVX512,
+        WEBSOCKET_MASK_KERNEL_AVX2,
+        WEBSOCKET_MASK_KERNEL_NEON,
+        WEBSOCKET_MASK_KERNEL_SSE2,
+        WEBSOCKET_MASK_KERNEL_SCALAR
+    };
+    websocket_mask_fn fn = NULL;
+
+    if (kernel == WEBSOCKET_MASK_KERNEL_AUTO)
+    {
+        for (size_t i = 0; fn == NULL && i < sizeof(prefer) / sizeof(prefer[0]); i++)
+        {
+            kernel = prefer[i];
+            fn = websocket_mask_kernel_lookup(kernel);
+        }
+    }
+    else
+    {
+        fn = websocket_mask_kernel_lookup(kernel);
+    }
+
+    if (fn == NULL)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    websocket_mask_kernel_id = kernel;
+    websocket_mask_kernel_fn = fn;
+
+    return WEBSOCKET_OK;
+}
+
+websocket_mask_kernel_t websocket_mask_kernel_current(void)
+{
+    if (websocket_mask_kernel_id == WEBSOCKET_MASK_KERNEL_AUTO)
+    {
+        websocket_mask_kernel_select(WEBSOCKET_MASK_KERNEL_AUTO);
+    }
+
+    return websocket_mask_kernel_id;
+}
+
+const char *websocket_mask_kernel_name(websocket_mask_kernel_t kernel)
+{
+    return (kernel < WEBSOCKET_MASK_KERNEL_MAX) ? websocket_mask_kernel_names[kernel] : "unknown";
+}
+
+static void websocket_mask_resolve(unsigned char *dst, const unsigned char *src, size_t length, uint32_t key)
+{
+    websocket_mask_kernel_select(WEBSOCKET_MASK_KERNEL_AUTO);
+    websocket_mask_kernel_fn(dst, src, length, key);
+}
+
+size_t websocket_mask(void *dst, const void *src, size_t length, const unsigned char mask_key[4], size_t offset)
+{
+    if (length)
+    {
+        websocket_mask_kernel_fn((unsigned char *)dst, (const unsigned char *)src, length, websocket_mask_rotate(mask_key, offset));
+    }
+
+    return (offset + length) & 3;
+}
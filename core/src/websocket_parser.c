@@ -0,0 +1,165 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date          Author       Notes
+ * 2026-10-16    tzy          first implementation
+ * 2026-10-16    tzy          validate text messages as utf-8
+ */
+#include "websocket.h"
+#include "websocket_parser.h"
+
+void websocket_parser_init(struct websocket_parser *parser)
+{
+    ws_memset(parser, 0, sizeof(struct websocket_parser));
+    parser->state = WEBSOCKET_PARSER_HEAD;
+    parser->head_need = 2;
+}
+
+static int websocket_parser_check_head(struct websocket_parser *parser)
+{
+    websocket_frame_type_t opcode = parser->info.frame_type;
+
+    if (parser->rsv & ~parser->rsv_allowed)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    if (websocket_parser_is_control(opcode))
+    {
+        /* control frames can not be fragmented and carry at most 125 bytes */
+        if (opcode != WEBSOCKET_CLOSE_FRAME && opcode != WEBSOCKET_PING_FRAME && opcode != WEBSOCKET_PONG_FRAME)
+            return -WEBSOCKET_ERROR;
+        if (!parser->fin || parser->info.total_len > 125 || parser->rsv)
+            return -WEBSOCKET_ERROR;
+    }
+    else if (opcode == WEBSOCKET_CONTINUE_FRAME)
+    {
+        /* the RSV bits of a message are carried by its first frame only */
+        if (!parser->in_message || parser->rsv)
+            return -WEBSOCKET_ERROR;
+    }
+    else if (opcode == WEBSOCKET_TEXT_FRAME || opcode == WEBSOCKET_BIN_FRAME)
+    {
+        if (parser->in_message)
+            return -WEBSOCKET_ERROR;
+        parser->message_type = opcode;
+        parser->message_rsv = parser->rsv;
+        websocket_utf8_init(&parser->utf8);
+    }
+    else
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    return WEBSOCKET_OK;
+}
+
+static int websocket_parser_end_frame(struct websocket_parser *parser)
+{
+    int res = WEBSOCKET_OK;
+
+    if (!websocket_parser_is_control(parser->info.frame_type))
+    {
+        parser->in_message = !parser->fin;
+        if (!parser->in_message && !parser->message_rsv && websocket_parser_check_utf8(parser))
+        {
+            res = websocket_utf8_final(&parser->utf8);
+        }
+    }
+
+    parser->state = WEBSOCKET_PARSER_HEAD;
+    parser->head_have = 0;
+    parser->head_need = 2;
+
+    return res;
+}
+
+int websocket_parser_execute(struct websocket_parser *parser, const struct websocket_parser_callback *cb, void *ctx, const void *data, size_t length)
+{
+    const char *ptr = (const char *)data;
+    size_t pos = 0, n;
+    int res = 0;
+
+    while (res == 0 && (pos < length || (parser->state == WEBSOCKET_PARSER_PAYLOAD && parser->info.remain_len == 0)))
+    {
+        switch (parser->state)
+        {
+        case WEBSOCKET_PARSER_HEAD:
+        case WEBSOCKET_PARSER_LENGTH:
+            n = parser->head_need - parser->head_have;
+            if (n > length - pos)
+                n = length - pos;
+            ws_memcpy(parser->head + parser->head_have, ptr + pos, n);
+            parser->head_have += n;
+            pos += n;
+            if (parser->head_have < parser->head_need)
+                break;
+
+            if (parser->state == WEBSOCKET_PARSER_HEAD)
+            {
+                /* a server must not mask its frames */
+                if (parser->head[1] & 0x80)
+                    return -WEBSOCKET_ERROR;
+
+                parser->fin = (parser->head[0] >> 7) & 0x01;
+                parser->rsv = (parser->head[0] >> 4) & 0x07;
+                parser->info.frame_type = (websocket_frame_type_t)(parser->head[0] & 0x0f);
+                parser->info.is_slice = !parser->fin;
+                parser->info.total_len = parser->head[1] & 0x7f;
+
+                if (parser->info.total_len >= 126)
+                {
+                    parser->head_need += (parser->info.total_len == 126) ? 2 : 8;
+                    parser->state = WEBSOCKET_PARSER_LENGTH;
+                    break;
+                }
+            }
+            else
+            {
+                parser->info.total_len = 0;
+                for (size_t i = 2; i < parser->head_need; i++)
+                {
+                    parser->info.total_len = (parser->info.total_len << 8) | parser->head[i];
+                }
+            }
+
+            if (websocket_parser_check_head(parser) != WEBSOCKET_OK)
+                return -WEBSOCKET_ERROR;
+
+            parser->info.remain_len = parser->info.total_len;
+            parser->state = WEBSOCKET_PARSER_PAYLOAD;
+            if (cb && cb->on_frame_head)
+                res = cb->on_frame_head(parser, ctx);
+            break;
+        case WEBSOCKET_PARSER_PAYLOAD:
+            if (parser->info.remain_len)
+            {
+                n = length - pos;
+                if (n > parser->info.remain_len)
+                    n = parser->info.remain_len;
+                parser->info.remain_len -= n;
+                pos += n;
+                if (!websocket_parser_is_control(parser->info.frame_type) && !parser->message_rsv && websocket_parser_check_utf8(parser))
+                {
+                    if (websocket_utf8_update(&parser->utf8, ptr + pos - n, n) != WEBSOCKET_OK)
+                        return -WEBSOCKET_INVALID_UTF8;
+                }
+                if (cb && cb->on_frame_data)
+                    res = cb->on_frame_data(parser, ctx, ptr + pos - n, n);
+            }
+            else
+            {
+                if (websocket_parser_end_frame(parser) != WEBSOCKET_OK)
+                    return -WEBSOCKET_INVALID_UTF8;
+                if (cb && cb->on_frame_end)
+                    res = cb->on_frame_end(parser, ctx);
+            }
+            break;
+        default:
+            return -WEBSOCKET_ERROR;
+        }
+    }
+
+    return res < 0 ? res : (int)pos;
+}
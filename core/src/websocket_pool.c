@@ -0,0 +1,89 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date          Author       Notes
+ * 2026-10-16    tzy          first implementation
+ */
+#include <string.h>
+#include "websocket.h"
+#include "websocket_pool.h"
+
+static int websocket_pool_class(size_t size)
+{
+    int klass = 0;
+
+    while (klass < WEBSOCKET_POOL_CLASSES && ((size_t)1 << (klass + WEBSOCKET_POOL_MIN_SHIFT)) < size)
+    {
+        klass += 1;
+    }
+
+    return klass;
+}
+
+void websocket_pool_init(struct websocket_pool *pool, int keep)
+{
+    memset(pool, 0, sizeof(struct websocket_pool));
+    pool->keep = keep;
+}
+
+void *websocket_pool_get(struct websocket_pool *pool, size_t size, size_t *length)
+{
+    int klass = websocket_pool_class(size);
+    void *buf;
+
+    if (klass == WEBSOCKET_POOL_CLASSES)
+    {
+        return NULL;
+    }
+
+    *length = (size_t)1 << (klass + WEBSOCKET_POOL_MIN_SHIFT);
+    if ((buf = pool->free[klass]) != NULL)
+    {
+        pool->free[klass] = *(void **)buf;
+        pool->count[klass] -= 1;
+    }
+    else if ((buf = ws_malloc(*length)) == NULL)
+    {
+        return NULL;
+    }
+    pool->borrowed += 1;
+
+    return buf;
+}
+
+void websocket_pool_put(struct websocket_pool *pool, void *buf, size_t length)
+{
+    int klass = websocket_pool_class(length);
+
+    if (buf == NULL)
+    {
+        return;
+    }
+
+    pool->borrowed -= 1;
+    if (pool->count[klass] >= pool->keep)
+    {
+        ws_free(buf);
+        return;
+    }
+
+    *(void **)buf = pool->free[klass];
+    pool->free[klass] = buf;
+    pool->count[klass] += 1;
+}
+
+void websocket_pool_clear(struct websocket_pool *pool)
+{
+    void *buf;
+
+    for (int klass = 0; klass < WEBSOCKET_POOL_CLASSES; klass++)
+    {
+        while ((buf = pool->free[klass]) != NULL)
+        {
+            pool->free[klass] = *(void **)buf;
+            ws_free(buf);
+        }
+        pool->count[klass] = 0;
+    }
+}
@@ -0,0 +1,171 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date          Author       Notes
+ * 2026-10-16    tzy          first implementation
+ */
+#include <time.h>
+#include "websocket.h"
+#include "websocket_random.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#if defined(_MSC_VER)
+#define WEBSOCKET_THREAD_LOCAL __declspec(thread)
+#else
+#define WEBSOCKET_THREAD_LOCAL __thread
+#endif
+
+struct websocket_random
+{
+    uint32_t key[8];
+    uint32_t pool[WEBSOCKET_RANDOM_POOL_BLOCKS * 16];
+    size_t pos;                 /* bytes of pool already handed out */
+    unsigned int generation;    /* 0 until seeded */
+};
+
+static WEBSOCKET_THREAD_LOCAL struct websocket_random websocket_random_local;
+/* bumped in a forked child so that it never replays the parent's stream */
+static volatile unsigned int websocket_random_generation = 1;
+
+#define WEBSOCKET_ROTL32(v, n)  (((v) << (n)) | ((v) >> (32 - (n))))
+#define WEBSOCKET_QUARTER_ROUND(a, b, c, d)                            \
+    do                                                                 \
+    {                                                                  \
+        a += b; d ^= a; d = WEBSOCKET_ROTL32(d, 16);                   \
+        c += d; b ^= c; b = WEBSOCKET_ROTL32(b, 12);                   \
+        a += b; d ^= a; d = WEBSOCKET_ROTL32(d, 8);                    \
+        c += d; b ^= c; b = WEBSOCKET_ROTL32(b, 7);                    \
+    } while (0)
+
+void websocket_chacha20_block(const uint32_t key[8], uint32_t counter, const uint32_t nonce[3], uint32_t out[16])
+{
+    uint32_t input[16], x[16];
+    int i;
+
+    input[0] = 0x61707865;
+    input[1] = 0x3320646e;
+    input[2] = 0x79622d32;
+    input[3] = 0x6b206574;
+    for (i = 0; i < 8; i++)
+    {
+        input[4 + i] = key[i];
+    }
+    input[12] = counter;
+    input[13] = nonce[0];
+    input[14] = nonce[1];
+    input[15] = nonce[2];
+
+    for (i = 0; i < 16; i++)
+    {
+        x[i] = input[i];
+    }
+
+    for (i = 0; i < 10; i++)
+    {
+        WEBSOCKET_QUARTER_ROUND(x[0], x[4], x[8], x[12]);
+        WEBSOCKET_QUARTER_ROUND(x[1], x[5], x[9], x[13]);
+        WEBSOCKET_QUARTER_ROUND(x[2], x[6], x[10], x[14]);
+        WEBSOCKET_QUARTER_ROUND(x[3], x[7], x[11], x[15]);
+        WEBSOCKET_QUARTER_ROUND(x[0], x[5], x[10], x[15]);
+        WEBSOCKET_QUARTER_ROUND(x[1], x[6], x[11], x[12]);
+        WEBSOCKET_QUARTER_ROUND(x[2], x[7], x[8], x[13]);
+        WEBSOCKET_QUARTER_ROUND(x[3], x[4], x[9], x[14]);
+    }
+
+    for (i = 0; i < 16; i++)
+    {
+        out[i] = x[i] + input[i];
+    }
+}
+
+static void websocket_random_refill(struct websocket_random *rng)
+{
+    static const uint32_t nonce[3] = {0, 0, 0};
+
+    /* every refill runs under a fresh key, so the counter can start over */
+    for (uint32_t i = 0; i < WEBSOCKET_RANDOM_POOL_BLOCKS; i++)
+    {
+        websocket_chacha20_block(rng->key, i, nonce, rng->pool + i * 16);
+    }
+
+    ws_memcpy(rng->key, rng->pool, sizeof(rng->key));
+    ws_memset(rng->pool, 0, sizeof(rng->key));
+    rng->pos = sizeof(rng->key);
+}
+
+#ifndef _WIN32
+static pthread_once_t websocket_random_once = PTHREAD_ONCE_INIT;
+
+static void websocket_random_atfork_child(void)
+{
+    websocket_random_generation++;
+}
+
+static void websocket_random_register(void)
+{
+    pthread_atfork(NULL, NULL, websocket_random_atfork_child);
+}
+#endif
+
+static void websocket_random_seed(struct websocket_random *rng)
+{
+#ifndef _WIN32
+    pthread_once(&websocket_random_once, websocket_random_register);
+#endif
+
+    if (ws_entropy(rng->key, sizeof(rng->key)) != 0)
+    {
+        /* no entropy source on this target, keys stay unique but become guessable */
+        rng->key[0] ^= (uint32_t)time(NULL);
+        rng->key[1] ^= (uint32_t)clock();
+        rng->key[2] ^= (uint32_t)(uintptr_t)rng;
+        rng->key[3] ^= (uint32_t)(uintptr_t)&websocket_random_generation;
+#ifndef _WIN32
+        rng->key[4] ^= (uint32_t)getpid();
+#endif
+    }
+
+    websocket_random_refill(rng);
+    rng->generation = websocket_random_generation;
+}
+
+void websocket_random_bytes(void *buf, size_t length)
+{
+    struct websocket_random *rng = &websocket_random_local;
+    unsigned char *out = (unsigned char *)buf;
+    size_t n;
+
+    if (rng->generation != websocket_random_generation)
+    {
+        websocket_random_seed(rng);
+    }
+
+    while (length > 0)
+    {
+        if (rng->pos == sizeof(rng->pool))
+        {
+            websocket_random_refill(rng);
+        }
+
+        n = sizeof(rng->pool) - rng->pos;
+        if (n > length)
+            n = length;
+
+        /* bytes are wiped as they are handed out, a later memory dump can not recover them */
+        ws_memcpy(out, (unsigned char *)rng->pool + rng->pos, n);
+        ws_memset((unsigned char *)rng->pool + rng->pos, 0, n);
+        rng->pos += n;
+        out += n;
+        length -= n;
+    }
+}
+
+void websocket_random_reseed(void)
+{
+    ws_memset(&websocket_random_local, 0, sizeof(websocket_random_local));
+}
@@ -4,10 +4,25 @@
  * Change Logs:
  * Date          Author       Notes
  * 2023-7-3      tzy          first implementation
+ * 2026-10-16    tzy          epoll worker with persistent registration and a ready list
+ * 2026-10-16    tzy          multiple workers with a session placement policy
+ * 2026-10-16    tzy          io_uring worker engine with multishot receives
+ * 2026-10-16    tzy          lock-free command queue with coalesced wakeups
+ * 2026-10-16    tzy          per-session outbound queue flushed by the worker
+ * 2026-10-16    tzy          write watermarks and the drain event
+ * 2026-10-16    tzy          per-worker receive buffer pool
+ * 2026-10-16    tzy          large messages are assembled in chained segments
+ * 2026-10-16    tzy          onfragment streams messages without buffering them
+ * 2026-10-16    tzy          timer wheel in the worker, idle and close handshake timeouts
+ * 2026-10-16    tzy          reconnect with exponential backoff, full jitter and a global limit
  */
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
 #include <stdio.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <limits.h>
 #include <string.h>
 #include <poll.h>
 #include <errno.h>
@@ -15,10 +30,62 @@
 #include <fcntl.h>
 #include <stdlib.h>
 #include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <pthread.h>
 #include "websocket_service.h"
-
-#define APP_WEBSOCKET_POLLFD_MAX 10
+#include "websocket_parser.h"
+#include "websocket_mpsc.h"
+#include "websocket_timer.h"
+#include "websocket_pool.h"
+#include "websocket_backoff.h"
+
+#ifdef __linux__
+#define WEBSOCKET_SERVICE_USING_EVENTFD
+#include <sys/eventfd.h>
+#endif
+
+#if defined(__linux__) && !defined(WEBSOCKET_SERVICE_USING_POLL)
+#define WEBSOCKET_SERVICE_USING_EPOLL
+#include <sys/epoll.h>
+#include "websocket_uring.h"
+#ifdef WEBSOCKET_USING_IO_URING
+#define WEBSOCKET_SERVICE_USING_URING
+#endif
+#endif
+
+/* events taken from the kernel per wait */
+#define APP_WEBSOCKET_EVENTS_MAX 64
+
+/* commands posted to a session's worker, posts made before the worker gets to them fold into one */
+#define APP_WEBSOCKET_CMD_CONNECT       (1 << 0)
+#define APP_WEBSOCKET_CMD_DISCONNECT    (1 << 1)
+#define APP_WEBSOCKET_CMD_CLOSE         (1 << 2)
+#define APP_WEBSOCKET_CMD_WRITE         (1 << 3)
+
+/* bytes the socket did not take at once wait in blocks of at least this size */
+#define APP_WEBSOCKET_OUT_BLOCK_SIZE    (4096)
+#define APP_WEBSOCKET_OUT_IOV_MAX       (16)
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#ifdef WEBSOCKET_SERVICE_USING_URING
+/* user_data of the worker's own requests, sessions use (generation << 32 | slot + 1) */
+#define APP_WEBSOCKET_URING_WAKEUP      ((uint64_t)0)
+#define APP_WEBSOCKET_URING_IGNORE      (~(uint64_t)0)
+#define APP_WEBSOCKET_URING_NO_CHUNK    (0xFFFF)
+#define APP_WEBSOCKET_URING_SEND        (0x80000000u)   /* slot flag of a send */
+
+/* a completion whose generation no longer matches belongs to a session that is gone */
+struct app_websocket_uring_slot
+{
+    struct websocket *session;
+    uint32_t gen;
+    uint32_t next_free;
+};
+#endif
 
 struct cache
 {
@@ -27,6 +94,34 @@ struct cache
     size_t recv_index;
 };
 
+struct websocket_control
+{
+    char buf[128];
+    size_t length;
+};
+
+struct app_websocket_out_block
+{
+    struct app_websocket_out_block *next;
+    size_t length;
+    size_t offset;              /* bytes already written */
+    size_t size;
+    char data[];
+};
+
+#ifdef WEBSOCKET_SERVICE_USING_URING
+/* one send on the ring, it outlives its session if that goes away first */
+struct app_websocket_uring_send
+{
+    struct app_websocket_uring_send *next;      /* on worker->orphans */
+    uint64_t user_data;
+    int blocks;                                 /* queue blocks the iovecs point into */
+    struct app_websocket_out_block *orphan;     /* those blocks once the queue was discarded */
+    struct msghdr msg;
+    struct iovec iov[APP_WEBSOCKET_OUT_IOV_MAX];
+};
+#endif
+
 struct websocket_kv
 {
     char *key;
@@ -46,6 +141,8 @@ struct websocket_callback
     int (*onopen)(struct app_websocket *);
     int (*onclose)(struct app_websocket *);
     int (*onerror)(struct app_websocket *);
+    int (*ondrain)(struct app_websocket *);
+    int (*onfragment)(struct app_websocket *, const void *, size_t, int, websocket_frame_type_t);
 };
 
 struct app_websocket_close_status
@@ -83,15 +180,94 @@ struct websocket
     pthread_t tid;
     pthread_mutex_t lock;
     ws_list_t node;
+    struct websocket_worker *worker;
+    ws_list_t ready_node;       /* on the worker's ready list, worker thread only */
+    ws_mpsc_node_t cmd_node;    /* on worker->commands while cmd is not 0 */
+    int cmd;                    /* APP_WEBSOCKET_CMD_* not taken by the worker yet */
+    int clean_due;              /* freed once the worker takes the command node off the queue */
+    ws_list_t arm_node;         /* on worker->armed, queued by a write on the worker thread */
+    /* outbound queue: written by any thread through session.send_to, drained by the worker */
+    pthread_mutex_t out_lock;
+    struct app_websocket_out_block *out_head;
+    struct app_websocket_out_block *out_tail;
+    size_t out_bytes;
+    int out_errno;              /* the worker failed to write, later sends fail with it */
+    size_t out_high;            /* above this application writes are refused, 0 never refuses */
+    size_t out_low;             /* ondrain fires once a refusing queue is down to this */
+    int out_blocked;
+    int out_watch;              /* writable interest armed, worker thread only */
+    int watch_fd;               /* socket registered with the worker, -1 if none */
+    int watch_idle;             /* epoll interest dropped while the session is not in MONITOR, worker thread only */
+#ifdef WEBSOCKET_SERVICE_USING_URING
+    uint32_t uring_slot;        /* slot + 1 in worker->slots, 0 while not armed */
+    int uring_io;               /* plain socket: received into provided buffers and parsed there, sent on the ring */
+    uint16_t chunk_head;        /* received buffers not parsed yet, linked through worker->chunk_next */
+    uint16_t chunk_tail;
+    uint32_t chunk_off;         /* bytes of chunk_head already parsed */
+    int recv_eof;
+    int recv_errno;
+    ws_list_t starve_node;      /* on worker->starved while the provided buffers ran out */
+    struct app_websocket_uring_send *send_req;     /* the send in flight, NULL if none */
+#endif
+    const char *feed_end;       /* end of a buffer the parser runs over that is not the session's own */
     int recv_size;
+    size_t max_message;         /* 0 keeps the limit at WEBSOCKET_SERVICE_CACHE_SIZE_MAX */
+    struct app_websocket_iovec *segs;   /* a message that outgrew the cache, WEBSOCKET_SERVICE_SEGMENT_SIZE each */
+    int seg_count;
+    int seg_cap;
+    struct app_websocket_iovec message_iov;
+    int fragment_final;         /* onfragment already saw the last bytes of the message */
+    struct app_websocket_timeouts timeouts;
+    struct websocket_timer idle_timer;      /* worker thread only, like close_timer */
+    struct websocket_timer close_timer;
+    uint64_t last_recv;         /* wheel tick of the last read */
+    int close_wait;             /* our close frame is out, waiting for the server to answer */
+    struct websocket_backoff retry;         /* the config is written under lock, the attempt count by the worker only */
+    struct websocket_timer retry_timer;
+    int retry_slot;             /* this attempt holds a slot of websocket_reconnect_limit */
+    int retry_due;              /* the server closed with a code worth reconnecting after */
+    size_t send_cache_size;
+    struct websocket_socket_options sockopt;
+    struct websocket_deflate_options deflate;
+    int utf8_validate;
+    size_t max_frame_payload;
+    struct websocket_control control;
+    websocket_frame_type_t message_type;
+    int message_ready;
+    const char *message;
+    char *message_end;
+    char message_tail;
 };
 
 struct websocket_worker
 {
     pthread_t tid;
-    int pipe[2];
-    struct pollfd poll[APP_WEBSOCKET_POLLFD_MAX];
-    pthread_mutex_t lock;
+    int wakeup[2];              /* one eventfd on linux, a pipe elsewhere */
+    int wakeup_pending;         /* a wakeup was written and the worker has not looked yet */
+    int quit;
+    ws_list_t node;             /* on websocket_worker_list */
+    ws_mpsc_t commands;         /* sessions with posted commands */
+    ws_list_t armed;            /* sessions the worker queued bytes for itself, flushed before it waits */
+    int load;                   /* sessions assigned to this worker */
+    struct websocket_pool pool;         /* receive buffers, worker thread only */
+    struct websocket_timer_wheel timers;
+#ifdef WEBSOCKET_SERVICE_USING_EPOLL
+    int epfd;
+#ifdef WEBSOCKET_SERVICE_USING_URING
+    struct websocket_uring *uring;      /* NULL when the worker runs on epoll */
+    struct app_websocket_uring_slot *slots;
+    uint32_t slot_len;
+    uint32_t slot_free;                 /* first free slot + 1, 0 if none */
+    uint16_t *chunk_next;               /* indexed by buffer id */
+    uint32_t *chunk_len;
+    uint32_t chunk_held;                /* buffers parked on sessions, the kernel owns the rest */
+    ws_list_t starved;                  /* sessions whose receive waits for buffers to come back */
+    struct app_websocket_uring_send *orphans;  /* sends in flight of sessions that are gone */
+#endif
+#else
+    struct pollfd *poll;
+    size_t poll_len;
+#endif
 };
 
 enum FSM_WEBSOCKET_STATE
@@ -106,9 +282,15 @@ enum FSM_WEBSOCKET_STATE
 
 #define WEBSOCKAET_APPEND_CACHE_SIZE        (1024)
 
-static ws_list_t websocket_session_list = WS_LIST_OBJECT_INIT(websocket_session_list);
-
-static struct websocket_worker worker;
+/* running workers, guarded by websocket_worker_lock */
+static ws_list_t websocket_worker_list = WS_LIST_OBJECT_INIT(websocket_worker_list);
+static pthread_mutex_t websocket_worker_lock = PTHREAD_MUTEX_INITIALIZER;
+static app_websocket_worker_policy_t websocket_worker_policy = APP_WEBSOCKET_WORKER_ROUND_ROBIN;
+static app_websocket_worker_select_t websocket_worker_select;
+static void *websocket_worker_select_userdata;
+static unsigned int websocket_worker_next;
+static struct websocket_backoff_limit websocket_reconnect_limit = {WEBSOCKET_SERVICE_RECONNECT_LIMIT, 0};
+static struct websocket_worker *websocket_default_worker;
 
 int app_websocket_enter_critical(struct websocket *session)
 {
@@ -120,310 +302,2389 @@ void app_websocket_exit_critical(struct websocket *session)
     pthread_mutex_unlock(&session->lock);
 }
 
-static void app_websocket_session_clean(struct websocket *app_ws_session)
+#ifdef WEBSOCKET_SERVICE_USING_URING
+static struct io_uring_sqe *app_websocket_uring_sqe(struct websocket_uring *ring)
 {
-    ws_list_remove(&app_ws_session->node);
+    struct io_uring_sqe *sqe = websocket_uring_get_sqe(ring);
 
-    if (app_ws_session->url)
+    /* the submission queue is full, hand it to the kernel and take a fresh entry */
+    if (sqe == NULL && websocket_uring_enter(ring, 0, 0) >= 0)
     {
-        WEBSOCKET_FREE((void *)app_ws_session->url);
+        sqe = websocket_uring_get_sqe(ring);
     }
 
-    if (app_ws_session->subprotocol)
-    {
-        WEBSOCKET_FREE((void *)app_ws_session->subprotocol);
-    }
+    return sqe;
+}
 
-    if(app_ws_session->cache.buf)
-        WEBSOCKET_FREE(app_ws_session->cache.buf);
+static uint64_t app_websocket_uring_user_data(struct websocket_worker *_worker, struct websocket *app_ws_session)
+{
+    return ((uint64_t)_worker->slots[app_ws_session->uring_slot - 1].gen << 32) | app_ws_session->uring_slot;
+}
 
-    if (app_ws_session->kv.kv_tab)
+static int app_websocket_uring_slot_alloc(struct websocket_worker *_worker, struct websocket *app_ws_session)
+{
+    struct app_websocket_uring_slot *slots;
+    uint32_t index, len;
+
+    if (_worker->slot_free == 0)
     {
-        for (int i = 0; i < app_ws_session->kv.kv_use; i++)
+        len = _worker->slot_len ? _worker->slot_len * 2 : 64;
+        slots = WEBSOCKET_REALLOC(_worker->slots, len * sizeof(struct app_websocket_uring_slot));
+        if (slots == NULL)
         {
-            WEBSOCKET_FREE(app_ws_session->kv.kv_tab[i].key);
-            WEBSOCKET_FREE(app_ws_session->kv.kv_tab[i].value);
+            return -WEBSOCKET_NOMEM;
         }
-        WEBSOCKET_FREE(app_ws_session->kv.kv_tab);
+
+        for (index = _worker->slot_len; index < len; index++)
+        {
+            slots[index].session = NULL;
+            slots[index].gen = 0;
+            slots[index].next_free = index + 1 < len ? index + 2 : 0;
+        }
+        _worker->slot_free = _worker->slot_len + 1;
+        _worker->slots = slots;
+        _worker->slot_len = len;
     }
 
-    if (app_ws_session->server_status.status.reason)
+    index = _worker->slot_free - 1;
+    _worker->slot_free = _worker->slots[index].next_free;
+    _worker->slots[index].session = app_ws_session;
+    app_ws_session->uring_slot = index + 1;
+
+    return WEBSOCKET_OK;
+}
+
+static void app_websocket_uring_slot_free(struct websocket_worker *_worker, struct websocket *app_ws_session)
+{
+    struct app_websocket_uring_slot *slot = &_worker->slots[app_ws_session->uring_slot - 1];
+
+    slot->session = NULL;
+    slot->gen += 1;
+    slot->next_free = _worker->slot_free;
+    _worker->slot_free = app_ws_session->uring_slot;
+    app_ws_session->uring_slot = 0;
+}
+
+/* plain sockets get a multishot receive into the provided buffers, TLS sockets only a multishot poll */
+static int app_websocket_uring_arm(struct websocket_worker *_worker, struct websocket *app_ws_session)
+{
+    struct io_uring_sqe *sqe = app_websocket_uring_sqe(_worker->uring);
+
+    if (sqe == NULL)
     {
-        WEBSOCKET_FREE(app_ws_session->server_status.status.reason);
+        return -WEBSOCKET_ERROR;
     }
 
-    if (app_ws_session->client_status.status.reason)
+    if (app_ws_session->uring_io)
     {
-        WEBSOCKET_FREE(app_ws_session->client_status.status.reason);
+        websocket_uring_prep_recv_multishot(sqe, app_ws_session->watch_fd, _worker->uring->buf_group,
+                                            app_websocket_uring_user_data(_worker, app_ws_session));
+    }
+    else
+    {
+        websocket_uring_prep_poll_multishot(sqe, app_ws_session->watch_fd, POLLIN,
+                                            app_websocket_uring_user_data(_worker, app_ws_session));
     }
 
-    WEBSOCKET_MEMSET(app_ws_session, 0, sizeof(struct websocket));
-    WEBSOCKET_FREE(app_ws_session);
+    return WEBSOCKET_OK;
 }
 
-static int fsm_driver(struct websocket *app_ws_session)
+static void app_websocket_uring_chunks_release(struct websocket_worker *_worker, struct websocket *app_ws_session)
 {
-    int err = WEBSOCKET_OK;
-    switch (app_ws_session->state)
+    uint16_t bid;
+
+    while (app_ws_session->chunk_head != APP_WEBSOCKET_URING_NO_CHUNK)
     {
-    case WEBSOCKET_STATE_INIT:
+        bid = app_ws_session->chunk_head;
+        app_ws_session->chunk_head = _worker->chunk_next[bid];
+        _worker->chunk_held -= 1;
+        websocket_uring_buffer_recycle(_worker->uring, bid);
+    }
+    app_ws_session->chunk_tail = APP_WEBSOCKET_URING_NO_CHUNK;
+    app_ws_session->chunk_off = 0;
+}
+
+/* parsed buffers go back to the kernel with the next submission */
+static void app_websocket_uring_chunks_trim(struct websocket_worker *_worker, struct websocket *app_ws_session)
+{
+    uint16_t bid;
+
+    while (app_ws_session->chunk_head != APP_WEBSOCKET_URING_NO_CHUNK &&
+           app_ws_session->chunk_off == _worker->chunk_len[app_ws_session->chunk_head])
     {
-        struct websocket_kv *kv_tab = app_ws_session->kv.kv_tab;
-        websocket_session_init(&app_ws_session->session);
-        if (kv_tab != NULL)
-        {
-            for (int i = 0; i < app_ws_session->kv.kv_use; i++)
-            {
-                websocket_header_fields_add(&app_ws_session->session, "%s: %s\r\n", kv_tab->key, kv_tab->value);
-                kv_tab += 1;
-            }
-        }
+        bid = app_ws_session->chunk_head;
+        app_ws_session->chunk_head = _worker->chunk_next[bid];
+        if (app_ws_session->chunk_head == APP_WEBSOCKET_URING_NO_CHUNK)
+            app_ws_session->chunk_tail = APP_WEBSOCKET_URING_NO_CHUNK;
+        app_ws_session->chunk_off = 0;
+        _worker->chunk_held -= 1;
+        websocket_uring_buffer_recycle(_worker->uring, bid);
+    }
+}
+
+/* received bytes or an end of stream not parsed yet, a parsed buffer kept for an in-place message does not count */
+static int app_websocket_uring_pending(struct websocket_worker *_worker, struct websocket *app_ws_session)
+{
+    uint16_t bid = app_ws_session->chunk_head;
+
+    if (bid != APP_WEBSOCKET_URING_NO_CHUNK &&
+        (app_ws_session->chunk_off < _worker->chunk_len[bid] || _worker->chunk_next[bid] != APP_WEBSOCKET_URING_NO_CHUNK))
+    {
+        return 1;
+    }
+
+    return app_ws_session->recv_eof || app_ws_session->recv_errno;
+}
+
+static void app_websocket_uring_send_free(struct app_websocket_uring_send *req)
+{
+    struct app_websocket_out_block *block;
+
+    while ((block = req->orphan) != NULL)
+    {
+        req->orphan = block->next;
+        WEBSOCKET_FREE(block);
+    }
+    WEBSOCKET_FREE(req);
+}
+
+static void app_websocket_uring_unwatch(struct websocket_worker *_worker, struct websocket *app_ws_session)
+{
+    struct io_uring_sqe *sqe;
 
-        if (websocket_connect(&app_ws_session->session, app_ws_session->url, app_ws_session->subprotocol) == WEBSOCKET_OK)
+    if (app_ws_session->uring_slot)
+    {
+        sqe = app_websocket_uring_sqe(_worker->uring);
+        if (sqe)
         {
-            ioctl(app_ws_session->session.socket_fd, FIONBIO, 1);
-            err = app_websocket_enter_critical(app_ws_session);
-            if (err == WEBSOCKET_OK)
-            {
-                if (app_ws_session->app_websocket)
-                {
-                    app_ws_session->state = WEBSOCKET_STATE_MONITOR;
-                    app_ws_session->is_connect = 1;
-                    if (app_ws_session->callback.onopen)
-                    {
-                        app_ws_session->callback.onopen(app_ws_session->app_websocket);
-                    }
-                }
-                else
-                {
-                    app_ws_session->state = WEBSOCKET_STATE_CLOSE;
-                    app_ws_session->is_connect = 0;
-                }
-                app_websocket_exit_critical(app_ws_session);
-            }
+            websocket_uring_prep_cancel(sqe, app_websocket_uring_user_data(_worker, app_ws_session), APP_WEBSOCKET_URING_IGNORE);
         }
-        else
+        /* the send keeps its buffers until its completion turns up, it is found again by user_data */
+        if (app_ws_session->send_req)
         {
-            err = app_websocket_enter_critical(app_ws_session);
-            if (err == WEBSOCKET_OK)
+            sqe = app_websocket_uring_sqe(_worker->uring);
+            if (sqe)
             {
-                if (app_ws_session->app_websocket)
-                {
-                    app_ws_session->state = WEBSOCKET_STATE_ERROR;
-                    app_ws_session->error_reason = "Failed to connect to the server!!";
-                }
-                else
-                {
-                    app_ws_session->state = WEBSOCKET_STATE_CLOSE;
-                }
-                app_websocket_exit_critical(app_ws_session);
+                websocket_uring_prep_cancel(sqe, app_ws_session->send_req->user_data, APP_WEBSOCKET_URING_IGNORE);
             }
+            app_ws_session->send_req->next = _worker->orphans;
+            _worker->orphans = app_ws_session->send_req;
+            app_ws_session->send_req = NULL;
         }
+        /* the pending request holds a reference on the socket, cancel it before the socket is closed */
+        websocket_uring_enter(_worker->uring, 0, 0);
+        app_websocket_uring_slot_free(_worker, app_ws_session);
     }
-    break;
-    case WEBSOCKET_STATE_MONITOR:
-        break;
-    case WEBSOCKET_STATE_CLOSE:
+
+    ws_list_remove(&app_ws_session->starve_node);
+    app_websocket_uring_chunks_release(_worker, app_ws_session);
+    app_ws_session->uring_io = 0;
+    app_ws_session->recv_eof = 0;
+    app_ws_session->recv_errno = 0;
+}
+
+static int app_websocket_uring_watch(struct websocket_worker *_worker, struct websocket *app_ws_session)
+{
+    app_ws_session->chunk_head = app_ws_session->chunk_tail = APP_WEBSOCKET_URING_NO_CHUNK;
+    app_ws_session->chunk_off = 0;
+    app_ws_session->recv_eof = 0;
+    app_ws_session->recv_errno = 0;
+    app_ws_session->uring_io = (app_ws_session->session.tls_session == NULL);
+
+    if (app_websocket_uring_slot_alloc(_worker, app_ws_session) != WEBSOCKET_OK ||
+        app_websocket_uring_arm(_worker, app_ws_session) != WEBSOCKET_OK)
     {
-        if (app_ws_session->is_connect && !app_ws_session->server_status.server_close)
-        {
-            int reason_len = 0;
-            if (app_ws_session->client_status.status.reason)
-            {
-                reason_len = strlen(app_ws_session->client_status.status.reason);
-            }
-            websocket_send_close(&app_ws_session->session, app_ws_session->client_status.status.status_code, app_ws_session->client_status.status.reason, reason_len);
-        }
-        app_ws_session->is_connect = 0;
-        websocket_disconnect(&app_ws_session->session);
-        app_ws_session->state = WEBSOCKET_STATE_EXIT;
+        app_websocket_uring_unwatch(_worker, app_ws_session);
+        return -WEBSOCKET_ERROR;
     }
-    break;
-    case WEBSOCKET_STATE_READ:
+
+    return WEBSOCKET_OK;
+}
+#endif
+
+/* register the session's socket with the worker, it stays registered until unwatch */
+static int app_websocket_worker_watch(struct websocket_worker *_worker, struct websocket *app_ws_session)
+{
+    int fd = app_ws_session->session.socket_fd;
+#ifdef WEBSOCKET_SERVICE_USING_EPOLL
+    struct epoll_event event;
+
+#ifdef WEBSOCKET_SERVICE_USING_URING
+    if (_worker->uring)
     {
-        err = app_websocket_enter_critical(app_ws_session);
-        if (err == WEBSOCKET_OK)
+        app_ws_session->watch_fd = fd;
+        if (app_websocket_uring_watch(_worker, app_ws_session) != WEBSOCKET_OK)
         {
-            if (app_ws_session->app_websocket)
-            {
-                if (app_ws_session->callback.onmessage)
-                {
-                    if (app_ws_session->callback.onmessage(app_ws_session->app_websocket) == WEBSOCKET_OK)
-                    {
-                        app_ws_session->state = WEBSOCKET_STATE_MONITOR;
-                    }
-                    else
-                    {
-                        app_ws_session->state = WEBSOCKET_STATE_ERROR;
-                    }
-                }
-            }
-            else
-            {
-                app_ws_session->state = WEBSOCKET_STATE_CLOSE;
-                app_ws_session->is_connect = 0;
-            }
-            app_websocket_exit_critical(app_ws_session);
+            app_ws_session->watch_fd = -1;
+            return -WEBSOCKET_ERROR;
         }
+        return WEBSOCKET_OK;
     }
-    break;
-    case WEBSOCKET_STATE_ERROR:
+#endif
+
+    event.events = EPOLLIN;
+    event.data.ptr = app_ws_session;
+    if (epoll_ctl(_worker->epfd, EPOLL_CTL_ADD, fd, &event) < 0)
     {
-        err = app_websocket_enter_critical(app_ws_session);
-        if (err == WEBSOCKET_OK)
-        {
-            if (app_ws_session->app_websocket)
-            {
-                if (app_ws_session->callback.onerror)
-                {
-                    app_ws_session->callback.onerror(app_ws_session->app_websocket);
-                }
-            }
-            app_websocket_exit_critical(app_ws_session);
-        }
-        websocket_disconnect(&app_ws_session->session);
-        app_ws_session->state = WEBSOCKET_STATE_MONITOR;
+        return -WEBSOCKET_ERROR;
     }
-    break;
-    case WEBSOCKET_STATE_EXIT:
+#endif
+    app_ws_session->watch_fd = fd;
+    return WEBSOCKET_OK;
+}
+
+/* must run before the socket is closed, its number can be handed to the next connection right away */
+static void app_websocket_worker_unwatch(struct websocket_worker *_worker, struct websocket *app_ws_session)
+{
+    if (app_ws_session->watch_fd < 0)
     {
-        char app_close = 0;
-        err = app_websocket_enter_critical(app_ws_session);
-        if (err == WEBSOCKET_OK)
-        {
-            if (app_ws_session->app_websocket)
-            {
-                if (app_ws_session->callback.onclose)
-                {
-                    app_ws_session->callback.onclose(app_ws_session->app_websocket);
-                }
-            }
-            else
-            {
-                app_close = 1;
-            }
-            app_websocket_exit_critical(app_ws_session);
-        }
+        return;
+    }
+#ifdef WEBSOCKET_SERVICE_USING_URING
+    if (_worker->uring)
+        app_websocket_uring_unwatch(_worker, app_ws_session);
+    else
+#endif
+#ifdef WEBSOCKET_SERVICE_USING_EPOLL
+    epoll_ctl(_worker->epfd, EPOLL_CTL_DEL, app_ws_session->watch_fd, NULL);
+#endif
+    ws_list_remove(&app_ws_session->arm_node);
+    app_ws_session->watch_fd = -1;
+    app_ws_session->out_watch = 0;
+    app_ws_session->watch_idle = 0;
+}
 
-        if (app_close)
-        {
-            app_websocket_session_clean(app_ws_session);
-        }
+static void app_websocket_worker_signal(struct websocket_worker *_worker)
+{
+#ifdef WEBSOCKET_SERVICE_USING_EVENTFD
+    uint64_t one = 1;
+
+    write(_worker->wakeup[1], &one, sizeof(one));
+#else
+    write(_worker->wakeup[1], "1", 1);
+#endif
+}
+
+/* hand a command to the session's worker from any thread, without a lock */
+static void app_websocket_worker_post(struct websocket_worker *_worker, struct websocket *app_ws_session, int cmd)
+{
+    /* the session is queued once however many commands pile up before the worker takes them */
+    if (__atomic_fetch_or(&app_ws_session->cmd, cmd, __ATOMIC_ACQ_REL) != 0)
+    {
+        return;
     }
-    break;
-    default:
-        break;
+    ws_mpsc_push(&_worker->commands, &app_ws_session->cmd_node);
+
+    /* one write covers every post until the worker looks at the queue again */
+    if (__atomic_exchange_n(&_worker->wakeup_pending, 1, __ATOMIC_SEQ_CST) == 0)
+    {
+        app_websocket_worker_signal(_worker);
     }
-    return 0;
 }
 
-static void *worker_entry(void *prma)
+static int app_websocket_out_append(struct websocket *app_ws_session, const char *data, size_t len)
 {
-    struct websocket_worker *_worker = (struct websocket_worker *)prma;
-    struct websocket *websocket_session;
-    struct pollfd *fds = _worker->poll;
-    int nfds;
-    ws_list_t worker_list = WS_LIST_OBJECT_INIT(worker_list);
-    ws_list_t *pos, *node;
+    struct app_websocket_out_block *block = app_ws_session->out_tail;
+    size_t n, size;
 
-    for (int i = 0; i < APP_WEBSOCKET_POLLFD_MAX; i++)
+    if (block && block->size > block->length)
     {
-        fds[i].revents = 0;
-        fds[i].events = POLLIN | POLLERR;
+        n = block->size - block->length < len ? block->size - block->length : len;
+        memcpy(block->data + block->length, data, n);
+        block->length += n;
+        app_ws_session->out_bytes += n;
+        data += n;
+        len -= n;
     }
-    fds[0].fd = _worker->pipe[0];
 
-    while(1)
+    if (len)
     {
-        nfds = 1;
-        ws_list_for_each(node, &worker_list)
+        size = len > APP_WEBSOCKET_OUT_BLOCK_SIZE ? len : APP_WEBSOCKET_OUT_BLOCK_SIZE;
+        block = WEBSOCKET_MALLOC(sizeof(struct app_websocket_out_block) + size);
+        if (block == NULL)
         {
-            struct websocket *ws_obj = ws_container_of(node, struct websocket, node);
-            fds[nfds].fd = ws_obj->session.socket_fd;
-            fds[nfds].revents = 0;
-            nfds += 1;
+            return -WEBSOCKET_NOMEM;
         }
+        block->next = NULL;
+        block->length = len;
+        block->offset = 0;
+        block->size = size;
+        memcpy(block->data, data, len);
+
+        if (app_ws_session->out_tail)
+            app_ws_session->out_tail->next = block;
+        else
+            app_ws_session->out_head = block;
+        app_ws_session->out_tail = block;
+        app_ws_session->out_bytes += len;
+    }
 
-        if((nfds = poll(fds, nfds, -1)) < 0)
-        {
-            if (errno == EINTR)
-                continue;
-            else
-                break;
-        }
+    return WEBSOCKET_OK;
+}
+
+static void app_websocket_out_consume(struct websocket *app_ws_session, size_t len)
+{
+    struct app_websocket_out_block *block;
+    size_t n;
 
-        if (fds[0].revents & POLLIN)
+    while (len && (block = app_ws_session->out_head) != NULL)
+    {
+        n = block->length - block->offset < len ? block->length - block->offset : len;
+        block->offset += n;
+        app_ws_session->out_bytes -= n;
+        len -= n;
+        if (block->offset == block->length)
         {
-            char recv[4];
-            read(fds[0].fd, recv, 1);
-            if(recv[0] == 'q')
-                break;
+            app_ws_session->out_head = block->next;
+            if (app_ws_session->out_head == NULL)
+                app_ws_session->out_tail = NULL;
+            WEBSOCKET_FREE(block);
         }
-        nfds = 1;
+    }
+}
+
+static void app_websocket_out_discard(struct websocket *app_ws_session)
+{
+    struct app_websocket_out_block *block;
+
+    pthread_mutex_lock(&app_ws_session->out_lock);
+#ifdef WEBSOCKET_SERVICE_USING_URING
+    /* the kernel may still read the blocks a send in flight points into, they go with the send */
+    if (app_ws_session->send_req)
+    {
+        struct app_websocket_uring_send *req = app_ws_session->send_req;
+        struct app_websocket_out_block **tail = &req->orphan;
 
-        pthread_mutex_lock(&_worker->lock);
-        ws_list_for_each_safe(pos, node, &websocket_session_list)
+        while (*tail)
+            tail = &(*tail)->next;
+        for (; req->blocks > 0 && (block = app_ws_session->out_head) != NULL; req->blocks--)
         {
-            ws_list_remove(pos);
-            ws_list_insert_before(&worker_list, pos);
+            app_ws_session->out_head = block->next;
+            block->next = NULL;
+            *tail = block;
+            tail = &block->next;
         }
-        pthread_mutex_unlock(&_worker->lock);
+    }
+#endif
+    while ((block = app_ws_session->out_head) != NULL)
+    {
+        app_ws_session->out_head = block->next;
+        WEBSOCKET_FREE(block);
+    }
+    app_ws_session->out_tail = NULL;
+    app_ws_session->out_bytes = 0;
+    app_ws_session->out_errno = 0;
+    __atomic_store_n(&app_ws_session->out_blocked, 0, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&app_ws_session->out_lock);
+}
 
-        ws_list_for_each_safe(pos, node, &worker_list)
-        {
-            websocket_session = ws_container_of(pos, struct websocket, node);
-            if (fds[nfds].revents & POLLIN)
-            {
-                if (websocket_session->server_status.server_close == 0)
-                {
-                    websocket_session->state = WEBSOCKET_STATE_READ;
-                }
-                else
+/* under out_lock: a refusing queue down to the low watermark takes writes again, 1 on that change */
+static int app_websocket_out_unblock(struct websocket *app_ws_session)
+{
+    if (app_ws_session->out_blocked && app_ws_session->out_bytes <= app_ws_session->out_low)
+    {
+        __atomic_store_n(&app_ws_session->out_blocked, 0, __ATOMIC_RELEASE);
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Write as much of the queue as the socket takes, up to WEBSOCKET_SERVICE_WRITE_BUDGET bytes so one
+ * session does not hold the worker while others wait. Returns 1 while bytes are left and -1 on error,
+ * *drained tells whether this flush let a refusing queue take writes again.
+ */
+static int app_websocket_out_flush(struct websocket *app_ws_session, int *drained)
+{
+    struct iovec iov[APP_WEBSOCKET_OUT_IOV_MAX];
+    struct app_websocket_out_block *block;
+    struct msghdr msg;
+    size_t sent = 0;
+    int iovcnt, res;
+    ssize_t n;
+
+    pthread_mutex_lock(&app_ws_session->out_lock);
+    while (app_ws_session->out_head && !app_ws_session->out_errno && sent < WEBSOCKET_SERVICE_WRITE_BUDGET)
+    {
+        iovcnt = 0;
+        for (block = app_ws_session->out_head; block && iovcnt < APP_WEBSOCKET_OUT_IOV_MAX; block = block->next)
+        {
+            iov[iovcnt].iov_base = block->data + block->offset;
+            iov[iovcnt].iov_len = block->length - block->offset;
+            iovcnt += 1;
+        }
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+        n = sendmsg(app_ws_session->session.socket_fd, &msg, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                app_ws_session->out_errno = errno;
+            break;
+        }
+        app_websocket_out_consume(app_ws_session, n);
+        sent += n;
+    }
+
+    *drained = app_websocket_out_unblock(app_ws_session);
+    res = app_ws_session->out_errno ? -1 : (app_ws_session->out_head != NULL);
+    pthread_mutex_unlock(&app_ws_session->out_lock);
+
+    return res;
+}
+
+/*
+ * session.send_to of plain sockets, called by any writer with the session's tx_lock held. With nothing
+ * queued the bytes go straight to the socket, whatever it does not take is queued for the worker.
+ * On an io_uring worker everything is queued and the worker sends it on the ring.
+ */
+static int app_websocket_out_send(void *ctx, const void *buf, size_t len, int flags)
+{
+    struct websocket *app_ws_session = (struct websocket *)ctx;
+    size_t done = 0;
+    int post = 0, direct, n;
+
+    pthread_mutex_lock(&app_ws_session->out_lock);
+    if (app_ws_session->out_errno)
+    {
+        errno = app_ws_session->out_errno;
+        pthread_mutex_unlock(&app_ws_session->out_lock);
+        return -1;
+    }
+
+    direct = (app_ws_session->out_head == NULL);
+#ifdef WEBSOCKET_SERVICE_USING_URING
+    /* a queue that was not empty is sent on by the completion of the send in flight */
+    if (app_ws_session->uring_io)
+    {
+        post = direct;
+        direct = 0;
+    }
+#endif
+    if (direct)
+    {
+        n = send(app_ws_session->session.socket_fd, buf, len, flags | MSG_NOSIGNAL);
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+            pthread_mutex_unlock(&app_ws_session->out_lock);
+            return -1;
+        }
+        done = n > 0 ? n : 0;
+        post = (done < len);
+    }
+
+    if (done < len && app_websocket_out_append(app_ws_session, (const char *)buf + done, len - done) != WEBSOCKET_OK)
+    {
+        pthread_mutex_unlock(&app_ws_session->out_lock);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if (app_ws_session->out_high && app_ws_session->out_bytes > app_ws_session->out_high)
+    {
+        __atomic_store_n(&app_ws_session->out_blocked, 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&app_ws_session->out_lock);
+
+    /* The worker's own writes, e.g. the close frame or a ping, never post: the session may be freed
+     * before the worker comes round to the command queue. It flushes them before it waits instead. */
+    if (post && pthread_equal(pthread_self(), app_ws_session->worker->tid))
+    {
+        if (app_ws_session->arm_node.next == &app_ws_session->arm_node)
+        {
+            ws_list_insert_before(&app_ws_session->worker->armed, &app_ws_session->arm_node);
+        }
+    }
+    else if (post)
+    {
+        app_websocket_worker_post(app_ws_session->worker, app_ws_session, APP_WEBSOCKET_CMD_WRITE);
+    }
+
+    return (int)len;
+}
+
+/* ask the worker's engine to report (or stop reporting) when the socket takes more bytes */
+static int app_websocket_worker_want_write(struct websocket_worker *_worker, struct websocket *app_ws_session, int want)
+{
+#ifdef WEBSOCKET_SERVICE_USING_EPOLL
+    struct epoll_event event;
+#endif
+
+    if (app_ws_session->out_watch == want || app_ws_session->watch_fd < 0)
+    {
+        return WEBSOCKET_OK;
+    }
+
+#ifdef WEBSOCKET_SERVICE_USING_URING
+    /* sends on the ring wait for room in the kernel, TLS sockets block and never queue */
+    if (_worker->uring)
+    {
+        return WEBSOCKET_OK;
+    }
+#endif
+#ifdef WEBSOCKET_SERVICE_USING_EPOLL
+    /* an idle registration picks the interest up when it is armed again */
+    if (!app_ws_session->watch_idle)
+    {
+        event.events = want ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+        event.data.ptr = app_ws_session;
+        if (epoll_ctl(_worker->epfd, EPOLL_CTL_MOD, app_ws_session->watch_fd, &event) < 0)
+        {
+            return -WEBSOCKET_ERROR;
+        }
+    }
+#endif
+    app_ws_session->out_watch = want;
+
+    return WEBSOCKET_OK;
+}
+
+#ifdef WEBSOCKET_SERVICE_USING_EPOLL
+/*
+ * Events are level-triggered and only a session in MONITOR takes them, any other one
+ * would be reported again on every wait. Its interest is dropped until it settles.
+ */
+static void app_websocket_worker_idle(struct websocket_worker *_worker, struct websocket *app_ws_session, int idle)
+{
+    struct epoll_event event;
+
+    if (app_ws_session->watch_idle == idle || app_ws_session->watch_fd < 0)
+    {
+        return;
+    }
+#ifdef WEBSOCKET_SERVICE_USING_URING
+    if (_worker->uring)
+    {
+        return;
+    }
+#endif
+    event.events = idle ? 0 : (app_ws_session->out_watch ? (EPOLLIN | EPOLLOUT) : EPOLLIN);
+    event.data.ptr = app_ws_session;
+    if (epoll_ctl(_worker->epfd, EPOLL_CTL_MOD, app_ws_session->watch_fd, &event) == 0)
+    {
+        app_ws_session->watch_idle = idle;
+    }
+}
+#endif
+
+/* a connected plain socket is switched to non-blocking and handed to the worker */
+static int app_websocket_session_watch(struct websocket *app_ws_session)
+{
+    int nonblock = 1;
+
+    /* TLS records are written by mbedtls straight to the socket, those sockets stay blocking */
+    app_ws_session->out_watch = 0;
+    if (app_ws_session->session.tls_session == NULL)
+    {
+        ioctl(app_ws_session->session.socket_fd, FIONBIO, &nonblock);
+        app_ws_session->session.send_to = app_websocket_out_send;
+        app_ws_session->session.send_ctx = app_ws_session;
+    }
+    if (app_websocket_worker_watch(app_ws_session->worker, app_ws_session) != WEBSOCKET_OK)
+    {
+        websocket_disconnect(&app_ws_session->session);
+        return -WEBSOCKET_ERROR;
+    }
+
+    return WEBSOCKET_OK;
+}
+
+/* a session holds receive buffers only while a message is being assembled, worker thread only */
+static void app_websocket_cache_release(struct websocket *app_ws_session)
+{
+    if (app_ws_session->cache.buf)
+    {
+        websocket_pool_put(&app_ws_session->worker->pool, app_ws_session->cache.buf, app_ws_session->cache.length);
+        app_ws_session->cache.buf = NULL;
+        app_ws_session->cache.length = 0;
+    }
+
+    for (int i = 0; i < app_ws_session->seg_count; i++)
+    {
+        websocket_pool_put(&app_ws_session->worker->pool, app_ws_session->segs[i].data, WEBSOCKET_SERVICE_SEGMENT_SIZE);
+    }
+    app_ws_session->seg_count = 0;
+}
+
+static void app_websocket_session_disconnect(struct websocket *app_ws_session)
+{
+    int flush = (app_ws_session->session.socket_fd >= 0), drained;
+
+#ifdef WEBSOCKET_SERVICE_USING_URING
+    /* a send in flight on the ring owns the head of the queue */
+    flush = flush && app_ws_session->send_req == NULL;
+#endif
+    /* whatever the socket takes right away still goes out, e.g. the close frame, the rest is dropped */
+    if (flush)
+    {
+        app_websocket_out_flush(app_ws_session, &drained);
+    }
+    app_websocket_out_discard(app_ws_session);
+    app_websocket_cache_release(app_ws_session);
+    app_ws_session->recv_size = 0;
+    app_ws_session->fragment_final = 0;
+    app_ws_session->close_wait = 0;
+    websocket_timer_cancel(&app_ws_session->worker->timers, &app_ws_session->idle_timer);
+    websocket_timer_cancel(&app_ws_session->worker->timers, &app_ws_session->close_timer);
+    app_websocket_worker_unwatch(app_ws_session->worker, app_ws_session);
+    websocket_disconnect(&app_ws_session->session);
+}
+
+static int app_websocket_reconnect_acquire(struct websocket *app_ws_session)
+{
+    if (!websocket_backoff_acquire(&websocket_reconnect_limit))
+    {
+        return 0;
+    }
+
+    app_ws_session->retry_slot = 1;
+    return 1;
+}
+
+static void app_websocket_reconnect_release(struct websocket *app_ws_session)
+{
+    if (app_ws_session->retry_slot)
+    {
+        app_ws_session->retry_slot = 0;
+        websocket_backoff_release(&websocket_reconnect_limit);
+    }
+}
+
+static void app_websocket_session_clean(struct websocket *app_ws_session)
+{
+    /* a command posted by another thread still has the node on the queue, it is freed when taken */
+    if (__atomic_load_n(&app_ws_session->cmd, __ATOMIC_ACQUIRE) != 0)
+    {
+        app_ws_session->clean_due = 1;
+        return;
+    }
+
+    ws_list_remove(&app_ws_session->node);
+    ws_list_remove(&app_ws_session->arm_node);
+    ws_list_remove(&app_ws_session->ready_node);
+    app_websocket_out_discard(app_ws_session);
+    websocket_timer_cancel(&app_ws_session->worker->timers, &app_ws_session->idle_timer);
+    websocket_timer_cancel(&app_ws_session->worker->timers, &app_ws_session->close_timer);
+    websocket_timer_cancel(&app_ws_session->worker->timers, &app_ws_session->retry_timer);
+    app_websocket_reconnect_release(app_ws_session);
+    pthread_mutex_destroy(&app_ws_session->out_lock);
+    websocket_session_deinit(&app_ws_session->session);
+
+    if (app_ws_session->url)
+    {
+        WEBSOCKET_FREE((void *)app_ws_session->url);
+    }
+
+    if (app_ws_session->subprotocol)
+    {
+        WEBSOCKET_FREE((void *)app_ws_session->subprotocol);
+    }
+
+    app_websocket_cache_release(app_ws_session);
+    WEBSOCKET_FREE(app_ws_session->segs);
+
+    if (app_ws_session->kv.kv_tab)
+    {
+        for (int i = 0; i < app_ws_session->kv.kv_use; i++)
+        {
+            WEBSOCKET_FREE(app_ws_session->kv.kv_tab[i].key);
+            WEBSOCKET_FREE(app_ws_session->kv.kv_tab[i].value);
+        }
+        WEBSOCKET_FREE(app_ws_session->kv.kv_tab);
+    }
+
+    if (app_ws_session->server_status.status.reason)
+    {
+        WEBSOCKET_FREE(app_ws_session->server_status.status.reason);
+    }
+
+    if (app_ws_session->client_status.status.reason)
+    {
+        WEBSOCKET_FREE(app_ws_session->client_status.status.reason);
+    }
+
+    /* last, the worker may be destroyed once its load is 0 and the buffers above went back to its pool */
+    __atomic_sub_fetch(&app_ws_session->worker->load, 1, __ATOMIC_RELEASE);
+    WEBSOCKET_MEMSET(app_ws_session, 0, sizeof(struct websocket));
+    WEBSOCKET_FREE(app_ws_session);
+}
+
+static int app_websocket_cache_reserve(struct websocket *app_session, uint64_t length)
+{
+    char *new_addr;
+    size_t new_length;
+    uint64_t buf_size = app_session->recv_size + length + 1;
+
+    if (buf_size <= app_session->cache.length)
+    {
+        return WEBSOCKET_OK;
+    }
+
+    if (buf_size <= WEBSOCKET_SERVICE_CACHE_SIZE_MAX)
+    {
+        /* the next class up, the part assembled so far moves along */
+        new_addr = websocket_pool_get(&app_session->worker->pool, buf_size, &new_length);
+        if (new_addr != NULL)
+        {
+            if (app_session->recv_size)
+            {
+                memcpy(new_addr, app_session->cache.buf, app_session->recv_size);
+            }
+            websocket_pool_put(&app_session->worker->pool, app_session->cache.buf, app_session->cache.length);
+            app_session->cache.length = new_length;
+            app_session->cache.buf = new_addr;
+            return WEBSOCKET_OK;
+        }
+    }
+
+    app_session->error_reason = "Resource Starvation!!";
+    return -WEBSOCKET_NOMEM;
+}
+
+static size_t app_websocket_message_limit(struct websocket *app_session)
+{
+    return app_session->max_message > WEBSOCKET_SERVICE_CACHE_SIZE_MAX ? app_session->max_message : WEBSOCKET_SERVICE_CACHE_SIZE_MAX;
+}
+
+/* segments are filled one after the other and never move, only the table of them grows */
+static int app_websocket_chain_append(struct websocket *app_session, const char *data, size_t length)
+{
+    struct app_websocket_iovec *seg;
+    size_t n, size;
+
+    while (length > 0)
+    {
+        seg = app_session->seg_count ? &app_session->segs[app_session->seg_count - 1] : NULL;
+        if (seg == NULL || seg->length == WEBSOCKET_SERVICE_SEGMENT_SIZE)
+        {
+            if (app_session->seg_count == app_session->seg_cap)
+            {
+                int cap = app_session->seg_cap ? app_session->seg_cap * 2 : 16;
+                seg = WEBSOCKET_REALLOC(app_session->segs, cap * sizeof(struct app_websocket_iovec));
+                if (seg == NULL)
                 {
-                    websocket_session->state = WEBSOCKET_STATE_CLOSE;
+                    app_session->error_reason = "Resource Starvation!!";
+                    return -WEBSOCKET_NOMEM;
                 }
+                app_session->segs = seg;
+                app_session->seg_cap = cap;
             }
-            else if (fds[nfds].revents & POLLERR)
+
+            seg = &app_session->segs[app_session->seg_count];
+            seg->data = websocket_pool_get(&app_session->worker->pool, WEBSOCKET_SERVICE_SEGMENT_SIZE, &size);
+            if (seg->data == NULL)
             {
-                websocket_session->state = WEBSOCKET_STATE_ERROR;
+                app_session->error_reason = "Resource Starvation!!";
+                return -WEBSOCKET_NOMEM;
             }
+            seg->length = 0;
+            app_session->seg_count += 1;
+        }
+
+        n = WEBSOCKET_SERVICE_SEGMENT_SIZE - seg->length;
+        if (n > length)
+            n = length;
+        memcpy((char *)seg->data + seg->length, data, n);
+        seg->length += n;
+        app_session->recv_size += n;
+        data += n;
+        length -= n;
+    }
 
-            if (websocket_session->state < WEBSOCKET_STATE_MONITOR)
+    return WEBSOCKET_OK;
+}
+
+static int app_websocket_control_frame_handle(struct websocket *app_session, websocket_frame_type_t type)
+{
+    struct websocket_session *session = &app_session->session;
+    struct websocket_control *control = &app_session->control;
+    int res = WEBSOCKET_OK;
+
+    switch (type)
+    {
+    case WEBSOCKET_PING_FRAME:
+        res = websocket_send_pong(session, control->length ? control->buf : NULL, control->length);
+        break;
+    case WEBSOCKET_CLOSE_FRAME:
+        control->buf[control->length] = '\0';
+        if (control->length > 2)
+        {
+            websocket_send_close(session, WEBSOCKET_STATUS_CLOSE_NORMAL, &control->buf[2], control->length - 2);
+            if (app_session->server_status.status.reason)
             {
-                fsm_driver(websocket_session);
+                WEBSOCKET_FREE(app_session->server_status.status.reason);
             }
-            nfds += 1;
+            app_session->server_status.status.reason = WEBSOCKET_STRDUP(&control->buf[2]);
+        }
+        else
+        {
+            websocket_send_close(session, WEBSOCKET_STATUS_CLOSE_NORMAL, NULL, 0);
+        }
+
+        if (control->length >= 2)
+        {
+            memcpy(&app_session->server_status.status.status_code, control->buf, 2);
+            app_session->server_status.status.status_code = ntohs(app_session->server_status.status.status_code);
+        }
+        app_session->server_status.server_close = 1;
+        res = 1;
+        break;
+    default:
+        break;
+    }
+
+    if (res < 0)
+    {
+        app_session->error_reason = "Error writing data!!";
+    }
+
+    return res;
+}
+
+static int app_websocket_fragment_notify(struct websocket *app_session, const void *data, size_t length, int is_final, websocket_frame_type_t type)
+{
+    int res = WEBSOCKET_OK;
+
+    if (app_websocket_enter_critical(app_session) == WEBSOCKET_OK)
+    {
+        if (app_session->app_websocket && app_session->callback.onfragment &&
+            app_session->callback.onfragment(app_session->app_websocket, data, length, is_final, type) != WEBSOCKET_OK)
+        {
+            app_session->error_reason = "Fragment handler failed!!";
+            res = -WEBSOCKET_ERROR;
+        }
+        app_websocket_exit_critical(app_session);
+    }
+
+    return res;
+}
+
+static int app_websocket_on_frame_head(struct websocket_parser *parser, void *ctx)
+{
+    struct websocket *app_session = (struct websocket *)ctx;
+
+    if (websocket_parser_is_control(parser->info.frame_type))
+    {
+        app_session->control.length = 0;
+        return WEBSOCKET_OK;
+    }
+
+    /* a streamed message is never held, so it has no size limit */
+    if (app_session->callback.onfragment)
+    {
+        return WEBSOCKET_OK;
+    }
+
+    /* the buffer is borrowed once data has to be copied, a message read in place needs none */
+    if (!parser->message_rsv && app_session->recv_size + parser->info.total_len > app_websocket_message_limit(app_session))
+    {
+        app_session->error_reason = "Resource Starvation!!";
+        return -WEBSOCKET_NOMEM;
+    }
+
+    return WEBSOCKET_OK;
+}
+
+static int app_websocket_on_frame_data(struct websocket_parser *parser, void *ctx, const char *data, size_t length)
+{
+    struct websocket *app_session = (struct websocket *)ctx;
+
+    if (websocket_parser_is_control(parser->info.frame_type))
+    {
+        memcpy(app_session->control.buf + app_session->control.length, data, length);
+        app_session->control.length += length;
+    }
+    else if (app_session->callback.onfragment)
+    {
+        /* without deflate the last payload byte marks the end, inflated data may still follow it */
+        int is_final = parser->fin && parser->info.remain_len == 0 && !parser->message_rsv;
+
+        app_session->fragment_final = is_final;
+        return app_websocket_fragment_notify(app_session, data, length, is_final, parser->message_type);
+    }
+    else if (parser->fin && parser->info.frame_type != WEBSOCKET_CONTINUE_FRAME && !parser->message_rsv && length == parser->info.total_len &&
+             (app_session->feed_end == NULL || data + length < app_session->feed_end))
+    {
+        /* a single-frame message that sits whole in the receive buffer is delivered in place, the byte
+         * behind it is borrowed for the terminator so it has to be inside the same buffer */
+        app_session->message = data;
+        app_session->recv_size = length;
+    }
+    else if (app_session->seg_count == 0 &&
+             app_session->recv_size + length + (parser->message_rsv ? 0 : parser->info.remain_len) + 1 <= WEBSOCKET_SERVICE_CACHE_SIZE_MAX)
+    {
+        /* room for the rest of the frame as well, an inflated message grows chunk by chunk */
+        if (app_websocket_cache_reserve(app_session, parser->message_rsv ? length : length + parser->info.remain_len) != WEBSOCKET_OK)
+        {
+            return -WEBSOCKET_NOMEM;
+        }
+        memcpy(app_session->cache.buf + app_session->recv_size, data, length);
+        app_session->recv_size += length;
+        app_session->message = app_session->cache.buf;
+    }
+    else
+    {
+        /* too large for one buffer, the message continues in a chain of segments */
+        if (app_session->recv_size + length > app_websocket_message_limit(app_session))
+        {
+            app_session->error_reason = "Resource Starvation!!";
+            return -WEBSOCKET_NOMEM;
         }
 
-        ws_list_for_each_safe(pos, node, &worker_list)
+        if (app_session->seg_count == 0 && app_session->recv_size)
         {
-            websocket_session = ws_container_of(pos, struct websocket, node);
-            if (websocket_session->state > WEBSOCKET_STATE_MONITOR)
+            size_t part = app_session->recv_size;
+
+            app_session->recv_size = 0;
+            if (app_websocket_chain_append(app_session, app_session->cache.buf, part) != WEBSOCKET_OK)
             {
-                fsm_driver(websocket_session);
+                return -WEBSOCKET_NOMEM;
             }
+            websocket_pool_put(&app_session->worker->pool, app_session->cache.buf, app_session->cache.length);
+            app_session->cache.buf = NULL;
+            app_session->cache.length = 0;
         }
+
+        if (app_websocket_chain_append(app_session, data, length) != WEBSOCKET_OK)
+        {
+            return -WEBSOCKET_NOMEM;
+        }
+        app_session->message = NULL;
+    }
+
+    return WEBSOCKET_OK;
+}
+
+static int app_websocket_on_frame_end(struct websocket_parser *parser, void *ctx)
+{
+    struct websocket *app_session = (struct websocket *)ctx;
+
+    if (websocket_parser_is_control(parser->info.frame_type))
+    {
+        return app_websocket_control_frame_handle(app_session, parser->info.frame_type);
+    }
+
+    if (parser->in_message)
+    {
+        return WEBSOCKET_OK;
+    }
+
+    if (app_session->callback.onfragment)
+    {
+        /* an empty last frame or an inflated message ends with an empty final fragment */
+        if (app_session->fragment_final)
+        {
+            app_session->fragment_final = 0;
+            return WEBSOCKET_OK;
+        }
+        return app_websocket_fragment_notify(app_session, "", 0, 1, parser->message_type);
+    }
+
+    /* the whole message is assembled, pause the parser and hand it to onmessage */
+    if (app_session->seg_count)
+    {
+        /* a chained message is not terminated, it is only read through app_websocket_read_iov */
+        app_session->message = NULL;
+    }
+    else if (app_session->message == NULL || app_session->message == app_session->cache.buf)
+    {
+        if (app_websocket_cache_reserve(app_session, 0) != WEBSOCKET_OK)
+        {
+            return -WEBSOCKET_NOMEM;
+        }
+        app_session->message = app_session->cache.buf;
+        app_session->cache.buf[app_session->recv_size] = '\0';
+    }
+    else
+    {
+        /* the byte after an in-place message may already belong to the next frame, it is put back after onmessage */
+        app_session->message_end = (char *)app_session->message + app_session->recv_size;
+        app_session->message_tail = *app_session->message_end;
+        *app_session->message_end = '\0';
+    }
+    app_session->message_type = parser->message_type;
+    app_session->message_ready = 1;
+
+    return 1;
+}
+
+static void app_websocket_message_release(struct websocket *app_session)
+{
+    if (app_session->message_end)
+    {
+        *app_session->message_end = app_session->message_tail;
+        app_session->message_end = NULL;
+    }
+    app_session->message = NULL;
+    app_session->message_ready = 0;
+    app_session->recv_size = 0;
+    app_websocket_cache_release(app_session);
+#ifdef WEBSOCKET_SERVICE_USING_URING
+    /* the buffer an in-place message was read from */
+    if (app_session->uring_io)
+    {
+        app_websocket_uring_chunks_trim(app_session->worker, app_session);
+    }
+#endif
+}
+
+static const struct websocket_parser_callback app_websocket_parser_cb =
+{
+    app_websocket_on_frame_head,
+    app_websocket_on_frame_data,
+    app_websocket_on_frame_end
+};
+
+#ifdef WEBSOCKET_SERVICE_USING_URING
+/* the parser runs over the provided buffers themselves, nothing is copied into the session first */
+static int app_websocket_uring_feed(struct websocket *app_session)
+{
+    struct websocket_worker *_worker = app_session->worker;
+    const char *buf;
+    uint16_t bid;
+    int res;
+
+    /* bytes that came in behind the handshake response are still in the read-ahead buffer */
+    if (websocket_recv_pending(&app_session->session))
+    {
+        return websocket_feed(&app_session->session, &app_websocket_parser_cb, app_session);
+    }
+    websocket_recv_release(&app_session->session);
+
+    app_websocket_uring_chunks_trim(_worker, app_session);
+    if (app_session->chunk_head == APP_WEBSOCKET_URING_NO_CHUNK)
+    {
+        if (app_session->recv_errno)
+        {
+            return -WEBSOCKET_READ_ERROR;
+        }
+        return app_session->recv_eof ? -WEBSOCKET_DISCONNECT : -WEBSOCKET_AGAIN;
+    }
+
+    bid = app_session->chunk_head;
+    buf = websocket_uring_buffer(_worker->uring, bid);
+    app_session->feed_end = buf + _worker->chunk_len[bid];
+    res = websocket_feed_buffer(&app_session->session, &app_websocket_parser_cb, app_session,
+                                buf + app_session->chunk_off, _worker->chunk_len[bid] - app_session->chunk_off);
+    app_session->feed_end = NULL;
+    if (res > 0)
+    {
+        app_session->chunk_off += res;
+    }
+
+    return res;
+}
+#endif
+
+/* Parse whatever the socket has without blocking, stop once a message or a close frame is complete. */
+static int app_websocket_recv_frames(struct websocket *app_session)
+{
+    int res = WEBSOCKET_OK;
+
+    while (!app_session->message_ready && !app_session->server_status.server_close)
+    {
+#ifdef WEBSOCKET_SERVICE_USING_URING
+        if (app_session->uring_io)
+            res = app_websocket_uring_feed(app_session);
+        else
+#endif
+        res = websocket_feed(&app_session->session, &app_websocket_parser_cb, app_session);
+        if (res < 0)
+        {
+            if (res != -WEBSOCKET_AGAIN && res != -WEBSOCKET_INVALID_UTF8 && app_session->error_reason == NULL)
+            {
+                app_session->error_reason = "Error reading data!!";
+            }
+            break;
+        }
+        res = WEBSOCKET_OK;
+    }
+
+    return res;
+}
+
+static int app_websocket_reconnect_status(websocket_status_code_t code)
+{
+    return code == 1001 || code == 1011 || code == 1012 || code == 1013;
+}
+
+/* called under the session lock; -WEBSOCKET_ERROR once max_attempts failures in a row used up the attempts */
+static int app_websocket_reconnect_schedule(struct websocket *app_ws_session)
+{
+    int64_t delay;
+
+    if (app_ws_session->retry.base_ms == 0)
+    {
+        return WEBSOCKET_OK;
+    }
+
+    if ((delay = websocket_backoff_next(&app_ws_session->retry)) < 0)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    websocket_timer_arm(&app_ws_session->worker->timers, &app_ws_session->retry_timer, (uint32_t)delay);
+    return WEBSOCKET_OK;
+}
+
+static int fsm_driver(struct websocket *app_ws_session)
+{
+    int err = WEBSOCKET_OK;
+    switch (app_ws_session->state)
+    {
+    case WEBSOCKET_STATE_INIT:
+    {
+        struct websocket_kv *kv_tab = app_ws_session->kv.kv_tab;
+        struct websocket_socket_options sockopt = app_ws_session->sockopt;
+        /* the previous connection was reset by its disconnect already, this only makes sure of it */
+        websocket_disconnect(&app_ws_session->session);
+        app_ws_session->server_status.server_close = 0;
+        app_ws_session->server_status.status.status_code = WEBSOCKET_STATUS_CLOSE_NORMAL;
+        if (app_ws_session->send_cache_size)
+        {
+            websocket_set_cache_size(&app_ws_session->session, app_ws_session->send_cache_size);
+        }
+        /* connect and the handshake block the worker, a socket timeout is the only deadline they can have */
+        if (sockopt.timeout_ms == 0)
+        {
+            sockopt.timeout_ms = app_ws_session->timeouts.handshake_ms;
+        }
+        websocket_set_socket_options(&app_ws_session->session, &sockopt);
+        if (app_ws_session->deflate.enable)
+            websocket_set_deflate(&app_ws_session->session, &app_ws_session->deflate);
+        websocket_set_utf8_validation(&app_ws_session->session, app_ws_session->utf8_validate);
+        websocket_set_max_frame_payload(&app_ws_session->session, app_ws_session->max_frame_payload);
+
+        if (kv_tab != NULL)
+        {
+            for (int i = 0; i < app_ws_session->kv.kv_use; i++)
+            {
+                websocket_header_fields_add(&app_ws_session->session, "%s: %s\r\n", kv_tab->key, kv_tab->value);
+                kv_tab += 1;
+            }
+        }
+
+        if (websocket_connect(&app_ws_session->session, app_ws_session->url, app_ws_session->subprotocol) == WEBSOCKET_OK &&
+            app_websocket_session_watch(app_ws_session) == WEBSOCKET_OK)
+        {
+            if (app_ws_session->sockopt.timeout_ms == 0 && sockopt.timeout_ms)
+            {
+                websocket_set_timeout_ms(&app_ws_session->session, 0);
+            }
+            app_websocket_reconnect_release(app_ws_session);
+            websocket_backoff_reset(&app_ws_session->retry);
+            websocket_timer_cancel(&app_ws_session->worker->timers, &app_ws_session->retry_timer);
+            if (app_ws_session->timeouts.idle_ms)
+            {
+                app_ws_session->last_recv = app_ws_session->worker->timers.tick;
+                websocket_timer_arm(&app_ws_session->worker->timers, &app_ws_session->idle_timer, app_ws_session->timeouts.idle_ms);
+            }
+            err = app_websocket_enter_critical(app_ws_session);
+            if (err == WEBSOCKET_OK)
+            {
+                if (app_ws_session->app_websocket)
+                {
+                    app_ws_session->state = WEBSOCKET_STATE_MONITOR;
+                    app_ws_session->is_connect = 1;
+                    if (app_ws_session->callback.onopen)
+                    {
+                        app_ws_session->callback.onopen(app_ws_session->app_websocket);
+                    }
+                }
+                else
+                {
+                    app_ws_session->state = WEBSOCKET_STATE_CLOSE;
+                    app_ws_session->is_connect = 0;
+                }
+                app_websocket_exit_critical(app_ws_session);
+            }
+        }
+        else
+        {
+            app_websocket_reconnect_release(app_ws_session);
+            err = app_websocket_enter_critical(app_ws_session);
+            if (err == WEBSOCKET_OK)
+            {
+                if (app_ws_session->app_websocket)
+                {
+                    app_ws_session->state = WEBSOCKET_STATE_ERROR;
+                    app_ws_session->error_reason = "Failed to connect to the server!!";
+                }
+                else
+                {
+                    app_ws_session->state = WEBSOCKET_STATE_CLOSE;
+                }
+                app_websocket_exit_critical(app_ws_session);
+            }
+        }
+    }
+    break;
+    case WEBSOCKET_STATE_MONITOR:
+        break;
+    case WEBSOCKET_STATE_CLOSE:
+    {
+        if (app_ws_session->is_connect && !app_ws_session->server_status.server_close && !app_ws_session->close_wait)
+        {
+            int reason_len = 0;
+            if (app_ws_session->client_status.status.reason)
+            {
+                reason_len = strlen(app_ws_session->client_status.status.reason);
+            }
+            websocket_send_close(&app_ws_session->session, app_ws_session->client_status.status.status_code, app_ws_session->client_status.status.reason, reason_len);
+
+            /* RFC 6455 7.1.1: the server answers and closes the TCP connection first, it gets close_ms to do so */
+            if (app_ws_session->timeouts.close_ms && app_ws_session->watch_fd >= 0)
+            {
+                app_ws_session->close_wait = 1;
+                websocket_timer_cancel(&app_ws_session->worker->timers, &app_ws_session->idle_timer);
+                websocket_timer_arm(&app_ws_session->worker->timers, &app_ws_session->close_timer, app_ws_session->timeouts.close_ms);
+                app_ws_session->state = WEBSOCKET_STATE_MONITOR;
+                break;
+            }
+        }
+        /* the server going away or restarting is a reason to come back, our own close is not */
+        app_ws_session->retry_due = app_ws_session->is_connect && app_ws_session->server_status.server_close && !app_ws_session->close_wait &&
+                                    app_websocket_reconnect_status(app_ws_session->server_status.status.status_code);
+        app_ws_session->is_connect = 0;
+        app_websocket_session_disconnect(app_ws_session);
+        app_ws_session->state = WEBSOCKET_STATE_EXIT;
+    }
+    break;
+    case WEBSOCKET_STATE_READ:
+    {
+        app_ws_session->last_recv = app_ws_session->worker->timers.tick;
+        err = app_websocket_recv_frames(app_ws_session);
+        if (err == -WEBSOCKET_AGAIN)
+        {
+            app_ws_session->state = WEBSOCKET_STATE_MONITOR;
+            err = WEBSOCKET_OK;
+            break;
+        }
+        else if (err == -WEBSOCKET_INVALID_UTF8)
+        {
+            /* RFC 6455 8.1: a text message that is not UTF-8 fails the connection with 1007 */
+            app_ws_session->error_reason = "Invalid UTF-8 in text message!!";
+            websocket_send_close(&app_ws_session->session, WEBSOCKET_STATUS_UNSUPPORTED_DATA, NULL, 0);
+            app_ws_session->state = WEBSOCKET_STATE_ERROR;
+            break;
+        }
+        else if (err != WEBSOCKET_OK)
+        {
+            /* a server that drops the connection instead of answering our close frame still closes it */
+            app_ws_session->state = app_ws_session->close_wait ? WEBSOCKET_STATE_CLOSE : WEBSOCKET_STATE_ERROR;
+            break;
+        }
+
+        err = app_websocket_enter_critical(app_ws_session);
+        if (err == WEBSOCKET_OK)
+        {
+            if (app_ws_session->app_websocket)
+            {
+                app_ws_session->state = app_ws_session->server_status.server_close ? WEBSOCKET_STATE_CLOSE : WEBSOCKET_STATE_MONITOR;
+                if (app_ws_session->message_ready && app_ws_session->callback.onmessage)
+                {
+                    if (app_ws_session->callback.onmessage(app_ws_session->app_websocket) != WEBSOCKET_OK)
+                    {
+                        app_ws_session->state = WEBSOCKET_STATE_ERROR;
+                    }
+                }
+            }
+            else
+            {
+                app_ws_session->state = WEBSOCKET_STATE_CLOSE;
+                app_ws_session->is_connect = 0;
+            }
+            app_websocket_message_release(app_ws_session);
+            app_websocket_exit_critical(app_ws_session);
+        }
+    }
+    break;
+    case WEBSOCKET_STATE_ERROR:
+    {
+        err = app_websocket_enter_critical(app_ws_session);
+        if (err == WEBSOCKET_OK)
+        {
+            if (app_ws_session->app_websocket)
+            {
+                if (app_ws_session->callback.onerror)
+                {
+                    app_ws_session->callback.onerror(app_ws_session->app_websocket);
+                }
+            }
+            app_websocket_exit_critical(app_ws_session);
+        }
+        app_ws_session->is_connect = 0;
+        app_websocket_session_disconnect(app_ws_session);
+        app_ws_session->state = WEBSOCKET_STATE_MONITOR;
+        err = app_websocket_enter_critical(app_ws_session);
+        if (err == WEBSOCKET_OK)
+        {
+            /* out of attempts: the session closes, onclose tells the application that it gave up */
+            if (app_ws_session->app_websocket && app_websocket_reconnect_schedule(app_ws_session) != WEBSOCKET_OK)
+            {
+                if (app_ws_session->server_status.status.reason)
+                {
+                    WEBSOCKET_FREE(app_ws_session->server_status.status.reason);
+                    app_ws_session->server_status.status.reason = NULL;
+                }
+                app_ws_session->server_status.status.status_code = WEBSOCKET_STATUS_CLOSE_ABNORMAL;
+                app_ws_session->error_reason = "Reconnect attempts exhausted!!";
+                app_ws_session->state = WEBSOCKET_STATE_EXIT;
+            }
+            app_websocket_exit_critical(app_ws_session);
+        }
+    }
+    break;
+    case WEBSOCKET_STATE_EXIT:
+    {
+        char app_close = 0;
+        err = app_websocket_enter_critical(app_ws_session);
+        if (err == WEBSOCKET_OK)
+        {
+            if (app_ws_session->app_websocket)
+            {
+                if (app_ws_session->callback.onclose)
+                {
+                    app_ws_session->callback.onclose(app_ws_session->app_websocket);
+                }
+                if (app_ws_session->retry_due)
+                {
+                    app_ws_session->retry_due = 0;
+                    app_websocket_reconnect_schedule(app_ws_session);
+                }
+            }
+            else
+            {
+                app_close = 1;
+            }
+            app_websocket_exit_critical(app_ws_session);
+        }
+
+        if (app_close)
+        {
+            app_websocket_session_clean(app_ws_session);
+        }
+    }
+    break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+static void worker_ready(ws_list_t *ready, struct websocket *app_ws_session)
+{
+    if (app_ws_session->ready_node.next == &app_ws_session->ready_node)
+    {
+        ws_list_insert_before(ready, &app_ws_session->ready_node);
+    }
+}
+
+/* move every entry of `ready` onto the empty list `run` */
+static void worker_take_ready(ws_list_t *ready, ws_list_t *run)
+{
+    if (ready->next != ready)
+    {
+        run->next = ready->next;
+        run->prev = ready->prev;
+        run->next->prev = run;
+        run->prev->next = run;
+        ws_list_init(ready);
+    }
+}
+
+static void worker_session_event(ws_list_t *ready, struct websocket *app_ws_session, int readable, int error)
+{
+    if (app_ws_session->state != WEBSOCKET_STATE_MONITOR)
+    {
+        return;
+    }
+
+    if (readable)
+    {
+        app_ws_session->state = app_ws_session->server_status.server_close ? WEBSOCKET_STATE_CLOSE : WEBSOCKET_STATE_READ;
+    }
+    else if (error)
+    {
+        app_ws_session->state = app_ws_session->close_wait ? WEBSOCKET_STATE_CLOSE : WEBSOCKET_STATE_ERROR;
+    }
+    else
+    {
+        return;
+    }
+    worker_ready(ready, app_ws_session);
+}
+
+/* reads only stamp last_recv, the timer is pushed back when it fires instead of on every read */
+static void worker_idle_expire(struct websocket_timer *timer, void *ctx)
+{
+    struct websocket *app_ws_session = ws_container_of(timer, struct websocket, idle_timer);
+    struct websocket_timer_wheel *timers = &app_ws_session->worker->timers;
+    uint64_t quiet = (timers->tick - app_ws_session->last_recv) * WEBSOCKET_TIMER_TICK_MS;
+
+    if (quiet < app_ws_session->timeouts.idle_ms || app_ws_session->state != WEBSOCKET_STATE_MONITOR)
+    {
+        websocket_timer_arm(timers, timer, quiet < app_ws_session->timeouts.idle_ms ? app_ws_session->timeouts.idle_ms - quiet : app_ws_session->timeouts.idle_ms);
+        return;
+    }
+
+    app_ws_session->error_reason = "Idle timeout!!";
+    app_ws_session->state = WEBSOCKET_STATE_ERROR;
+    worker_ready((ws_list_t *)ctx, app_ws_session);
+}
+
+static void worker_close_expire(struct websocket_timer *timer, void *ctx)
+{
+    struct websocket *app_ws_session = ws_container_of(timer, struct websocket, close_timer);
+
+    if (app_ws_session->close_wait && app_ws_session->state == WEBSOCKET_STATE_MONITOR)
+    {
+        app_ws_session->state = WEBSOCKET_STATE_CLOSE;
+        worker_ready((ws_list_t *)ctx, app_ws_session);
+    }
+}
+
+static void worker_retry_expire(struct websocket_timer *timer, void *ctx)
+{
+    struct websocket *app_ws_session = ws_container_of(timer, struct websocket, retry_timer);
+    int ready = 0;
+
+    if (app_websocket_enter_critical(app_ws_session) != WEBSOCKET_OK)
+    {
+        return;
+    }
+
+    /* not closed or connected again in the meantime */
+    if (!app_ws_session->is_connect && app_ws_session->app_websocket != NULL &&
+        (app_ws_session->state == WEBSOCKET_STATE_MONITOR || app_ws_session->state == WEBSOCKET_STATE_EXIT))
+    {
+        if (app_websocket_reconnect_acquire(app_ws_session))
+        {
+            app_ws_session->state = WEBSOCKET_STATE_INIT;
+            ready = 1;
+        }
+        else
+        {
+            websocket_timer_arm(&app_ws_session->worker->timers, timer, websocket_backoff_jitter(app_ws_session->retry.base_ms));
+        }
+    }
+    app_websocket_exit_critical(app_ws_session);
+
+    if (ready)
+    {
+        worker_ready((ws_list_t *)ctx, app_ws_session);
+    }
+}
+
+/* the queue went down to the low watermark, producers may write again */
+static void worker_session_drained(struct websocket *app_ws_session)
+{
+    if (app_websocket_enter_critical(app_ws_session) == WEBSOCKET_OK)
+    {
+        if (app_ws_session->app_websocket && app_ws_session->callback.ondrain)
+        {
+            app_ws_session->callback.ondrain(app_ws_session->app_websocket);
+        }
+        app_websocket_exit_critical(app_ws_session);
+    }
+}
+
+#ifdef WEBSOCKET_SERVICE_USING_URING
+/*
+ * One send per session is in flight, its iovecs point straight into the queue blocks. Every session
+ * that has bytes queued gets its send prepared here and the next enter submits them together.
+ */
+static int app_websocket_uring_send(struct websocket_worker *_worker, struct websocket *app_ws_session)
+{
+    struct app_websocket_uring_send *req;
+    struct app_websocket_out_block *block;
+    struct io_uring_sqe *sqe;
+    int iovcnt = 0;
+
+    if (app_ws_session->send_req || app_ws_session->uring_slot == 0)
+    {
+        return WEBSOCKET_OK;
+    }
+
+    req = WEBSOCKET_MALLOC(sizeof(struct app_websocket_uring_send));
+    if (req == NULL)
+    {
+        return -WEBSOCKET_NOMEM;
+    }
+
+    pthread_mutex_lock(&app_ws_session->out_lock);
+    for (block = app_ws_session->out_head; block && iovcnt < APP_WEBSOCKET_OUT_IOV_MAX && !app_ws_session->out_errno; block = block->next)
+    {
+        req->iov[iovcnt].iov_base = block->data + block->offset;
+        req->iov[iovcnt].iov_len = block->length - block->offset;
+        iovcnt += 1;
+    }
+    pthread_mutex_unlock(&app_ws_session->out_lock);
+
+    if (iovcnt == 0 || (sqe = app_websocket_uring_sqe(_worker->uring)) == NULL)
+    {
+        WEBSOCKET_FREE(req);
+        return iovcnt == 0 ? WEBSOCKET_OK : -WEBSOCKET_ERROR;
+    }
+
+    memset(&req->msg, 0, sizeof(req->msg));
+    req->msg.msg_iov = req->iov;
+    req->msg.msg_iovlen = iovcnt;
+    req->next = NULL;
+    req->blocks = iovcnt;
+    req->orphan = NULL;
+    req->user_data = app_websocket_uring_user_data(_worker, app_ws_session) | APP_WEBSOCKET_URING_SEND;
+    websocket_uring_prep_sendmsg(sqe, app_ws_session->watch_fd, &req->msg, MSG_NOSIGNAL, req->user_data);
+    app_ws_session->send_req = req;
+
+    return WEBSOCKET_OK;
+}
+#endif
+
+/* drain the outbound queue on a write command or once the socket takes bytes again */
+static void worker_session_writable(struct websocket_worker *_worker, ws_list_t *ready, struct websocket *app_ws_session)
+{
+    int drained, res;
+
+    if (app_ws_session->watch_fd < 0)
+    {
+        return;
+    }
+
+#ifdef WEBSOCKET_SERVICE_USING_URING
+    if (app_ws_session->uring_io)
+    {
+        if (app_websocket_uring_send(_worker, app_ws_session) != WEBSOCKET_OK)
+        {
+            worker_session_event(ready, app_ws_session, 0, 1);
+        }
+        return;
+    }
+#endif
+
+    res = app_websocket_out_flush(app_ws_session, &drained);
+    if (res < 0 || app_websocket_worker_want_write(_worker, app_ws_session, res > 0) != WEBSOCKET_OK)
+    {
+        worker_session_event(ready, app_ws_session, 0, 1);
+        return;
+    }
+
+    if (drained)
+    {
+        worker_session_drained(app_ws_session);
+    }
+}
+
+static void worker_drain_wakeup(struct websocket_worker *_worker)
+{
+    char buf[64];
+
+    /* non-blocking, one read resets an eventfd, a pipe is read until it is empty */
+    while (read(_worker->wakeup[0], buf, sizeof(buf)) == (int)sizeof(buf))
+    {
+    }
+}
+
+#ifdef WEBSOCKET_SERVICE_USING_URING
+static int worker_uring_watch_wakeup(struct websocket_worker *_worker)
+{
+    struct io_uring_sqe *sqe = app_websocket_uring_sqe(_worker->uring);
+
+    if (sqe == NULL)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+    websocket_uring_prep_poll_multishot(sqe, _worker->wakeup[0], POLLIN, APP_WEBSOCKET_URING_WAKEUP);
+
+    return WEBSOCKET_OK;
+}
+
+/* a send finished, the bytes it took leave the queue and the rest goes out with the next one */
+static void worker_uring_sent(struct websocket_worker *_worker, ws_list_t *ready, struct websocket *app_ws_session, uint64_t user_data, int res)
+{
+    struct app_websocket_uring_send *req, **link;
+    int drained = 0;
+
+    if (app_ws_session == NULL || app_ws_session->send_req == NULL || app_ws_session->send_req->user_data != user_data)
+    {
+        for (link = &_worker->orphans; (req = *link) != NULL; link = &req->next)
+        {
+            if (req->user_data == user_data)
+            {
+                *link = req->next;
+                app_websocket_uring_send_free(req);
+                break;
+            }
+        }
+        return;
+    }
+
+    req = app_ws_session->send_req;
+    app_ws_session->send_req = NULL;
+    if (req->orphan)
+    {
+        /* the queue was discarded meanwhile */
+        app_websocket_uring_send_free(req);
+        return;
+    }
+    WEBSOCKET_FREE(req);
+
+    pthread_mutex_lock(&app_ws_session->out_lock);
+    if (res < 0)
+    {
+        app_ws_session->out_errno = -res;
+    }
+    else
+    {
+        app_websocket_out_consume(app_ws_session, res);
+        drained = app_websocket_out_unblock(app_ws_session);
+    }
+    pthread_mutex_unlock(&app_ws_session->out_lock);
+
+    if (res < 0 || app_websocket_uring_send(_worker, app_ws_session) != WEBSOCKET_OK)
+    {
+        worker_session_event(ready, app_ws_session, 0, 1);
+        return;
+    }
+
+    if (drained)
+    {
+        worker_session_drained(app_ws_session);
+    }
+}
+
+/* buffers came back, the receives that ran out of them are armed again */
+static void worker_uring_rearm_starved(struct websocket_worker *_worker, ws_list_t *ready)
+{
+    struct websocket *app_ws_session;
+
+    while (_worker->starved.next != &_worker->starved)
+    {
+        app_ws_session = ws_container_of(_worker->starved.next, struct websocket, starve_node);
+        ws_list_remove(&app_ws_session->starve_node);
+        if (app_websocket_uring_arm(_worker, app_ws_session) != WEBSOCKET_OK)
+        {
+            app_ws_session->recv_errno = ENOMEM;
+            worker_session_event(ready, app_ws_session, 1, 0);
+        }
+    }
+}
+
+static void worker_uring_complete(struct websocket_worker *_worker, ws_list_t *ready, uint64_t user_data, int res, uint32_t flags)
+{
+    struct websocket *app_ws_session = NULL;
+    uint32_t slot = (uint32_t)user_data & ~APP_WEBSOCKET_URING_SEND;
+    uint16_t bid;
+
+    if (slot > 0 && slot <= _worker->slot_len && _worker->slots[slot - 1].gen == (uint32_t)(user_data >> 32))
+    {
+        app_ws_session = _worker->slots[slot - 1].session;
+    }
+
+    if (flags & IORING_CQE_F_BUFFER)
+    {
+        bid = (uint16_t)(flags >> IORING_CQE_BUFFER_SHIFT);
+        if (app_ws_session == NULL || res <= 0)
+        {
+            websocket_uring_buffer_recycle(_worker->uring, bid);
+        }
+        else
+        {
+            _worker->chunk_len[bid] = res;
+            _worker->chunk_next[bid] = APP_WEBSOCKET_URING_NO_CHUNK;
+            _worker->chunk_held += 1;
+            if (app_ws_session->chunk_tail == APP_WEBSOCKET_URING_NO_CHUNK)
+                app_ws_session->chunk_head = bid;
+            else
+                _worker->chunk_next[app_ws_session->chunk_tail] = bid;
+            app_ws_session->chunk_tail = bid;
+        }
+    }
+
+    if ((uint32_t)user_data & APP_WEBSOCKET_URING_SEND)
+    {
+        worker_uring_sent(_worker, ready, app_ws_session, user_data, res);
+        return;
+    }
+
+    if (app_ws_session == NULL || res == -ECANCELED)
+    {
+        return;
+    }
+
+    if (!app_ws_session->uring_io)
+    {
+        worker_session_event(ready, app_ws_session, res > 0 && (res & POLLIN), res < 0 || (res & (POLLERR | POLLHUP)));
+    }
+    else if (res != -ENOBUFS)
+    {
+        /* end of stream and errors are handed to the reader behind the data that came before them */
+        if (res == 0)
+            app_ws_session->recv_eof = 1;
+        else if (res < 0)
+            app_ws_session->recv_errno = -res;
+        worker_session_event(ready, app_ws_session, 1, 0);
+    }
+
+    if (flags & IORING_CQE_F_MORE)
+    {
+        return;
+    }
+
+    /* out of buffers, arming again right away would only fail again until some come back */
+    if (res == -ENOBUFS)
+    {
+        if (app_ws_session->starve_node.next == &app_ws_session->starve_node)
+        {
+            ws_list_insert_before(&_worker->starved, &app_ws_session->starve_node);
+        }
+    }
+    else if (res > 0 && app_websocket_uring_arm(_worker, app_ws_session) != WEBSOCKET_OK)
+    {
+        app_ws_session->recv_errno = ENOMEM;
+        worker_session_event(ready, app_ws_session, app_ws_session->uring_io, !app_ws_session->uring_io);
+    }
+}
+
+/* Receive requests stay armed, so one enter submits everything queued and reaps the completions in a batch. */
+static int worker_wait_uring(struct websocket_worker *_worker, ws_list_t *ready, int timeout)
+{
+    struct websocket_uring *ring = _worker->uring;
+    struct io_uring_cqe *cqe;
+    uint64_t user_data;
+    uint32_t flags;
+    int quit = 0, res;
+
+    /* Buffers the sessions parsed since the last turn go back first. The out of buffers completion may
+     * arrive after the buffers that would end it were committed, so a starved receive is armed again
+     * whenever the kernel holds any buffer rather than when this turn happened to return some. */
+    websocket_uring_buffers_commit(ring);
+    if (_worker->starved.next != &_worker->starved && _worker->chunk_held < WEBSOCKET_SERVICE_URING_BUFFERS)
+    {
+        worker_uring_rearm_starved(_worker, ready);
+    }
+    if (ready->next != ready)
+    {
+        timeout = 0;
+    }
+    if (websocket_uring_enter(ring, 1, timeout) < 0)
+    {
+        return 1;
+    }
+
+    while ((cqe = websocket_uring_peek_cqe(ring)) != NULL)
+    {
+        user_data = cqe->user_data;
+        res = cqe->res;
+        flags = cqe->flags;
+        websocket_uring_cqe_seen(ring);
+
+        if (user_data == APP_WEBSOCKET_URING_WAKEUP)
+        {
+            worker_drain_wakeup(_worker);
+            if (!(flags & IORING_CQE_F_MORE) && worker_uring_watch_wakeup(_worker) != WEBSOCKET_OK)
+            {
+                quit = 1;
+            }
+        }
+        else if (user_data != APP_WEBSOCKET_URING_IGNORE)
+        {
+            worker_uring_complete(_worker, ready, user_data, res, flags);
+        }
+    }
+
+    return quit;
+}
+#endif
+
+#ifdef WEBSOCKET_SERVICE_USING_EPOLL
+/* Sockets stay registered with data.ptr pointing at their session, so a wait costs only the ready ones. */
+static int worker_wait(struct websocket_worker *_worker, ws_list_t *sessions, ws_list_t *ready, int timeout)
+{
+    struct epoll_event events[APP_WEBSOCKET_EVENTS_MAX];
+    struct websocket *ws_obj;
+    int quit = 0, n;
+
+    /* only the poll variant walks the sessions */
+    (void)sessions;
+
+#ifdef WEBSOCKET_SERVICE_USING_URING
+    if (_worker->uring)
+    {
+        return worker_wait_uring(_worker, ready, timeout);
+    }
+#endif
+
+    n = epoll_wait(_worker->epfd, events, APP_WEBSOCKET_EVENTS_MAX, timeout);
+    if (n < 0)
+    {
+        return errno == EINTR ? 0 : 1;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        if (events[i].data.ptr == NULL)
+        {
+            worker_drain_wakeup(_worker);
+            continue;
+        }
+        ws_obj = (struct websocket *)events[i].data.ptr;
+        if (ws_obj->state != WEBSOCKET_STATE_MONITOR)
+        {
+            /* the session runs this turn anyway, otherwise keep it quiet until it is back in MONITOR */
+            if (ws_obj->ready_node.next == &ws_obj->ready_node)
+            {
+                app_websocket_worker_idle(_worker, ws_obj, 1);
+            }
+            continue;
+        }
+        if (events[i].events & EPOLLOUT)
+        {
+            worker_session_writable(_worker, ready, ws_obj);
+        }
+        worker_session_event(ready, ws_obj, events[i].events & EPOLLIN, events[i].events & (EPOLLERR | EPOLLHUP));
+    }
+
+    return quit;
+}
+#else
+static int worker_wait(struct websocket_worker *_worker, ws_list_t *sessions, ws_list_t *ready, int timeout)
+{
+    struct websocket *ws_obj;
+    ws_list_t *node;
+    size_t nfds = 1;
+    int quit = 0;
+
+    ws_list_for_each(node, sessions)
+    {
+        nfds += 1;
+    }
+
+    if (nfds > _worker->poll_len)
+    {
+        struct pollfd *fds = WEBSOCKET_REALLOC(_worker->poll, nfds * sizeof(struct pollfd));
+        if (fds == NULL)
+        {
+            return 1;
+        }
+        _worker->poll = fds;
+        _worker->poll_len = nfds;
+    }
+
+    _worker->poll[0].fd = _worker->wakeup[0];
+    _worker->poll[0].events = POLLIN;
+    nfds = 1;
+    ws_list_for_each(node, sessions)
+    {
+        ws_obj = ws_container_of(node, struct websocket, node);
+        /* level-triggered, a session out of MONITOR would only report the same event again */
+        _worker->poll[nfds].fd = ws_obj->state == WEBSOCKET_STATE_MONITOR ? ws_obj->watch_fd : -1;
+        _worker->poll[nfds].events = ws_obj->out_watch ? (POLLIN | POLLOUT) : POLLIN;
+        _worker->poll[nfds].revents = 0;
+        nfds += 1;
+    }
+
+    if (poll(_worker->poll, nfds, timeout) < 0)
+    {
+        return errno == EINTR ? 0 : 1;
+    }
+
+    if (_worker->poll[0].revents & POLLIN)
+    {
+        worker_drain_wakeup(_worker);
+    }
+
+    nfds = 1;
+    ws_list_for_each(node, sessions)
+    {
+        ws_obj = ws_container_of(node, struct websocket, node);
+        if (_worker->poll[nfds].revents & POLLOUT)
+        {
+            worker_session_writable(_worker, ready, ws_obj);
+        }
+        worker_session_event(ready, ws_obj, _worker->poll[nfds].revents & POLLIN, _worker->poll[nfds].revents & (POLLERR | POLLHUP));
+        nfds += 1;
+    }
+
+    return quit;
+}
+#endif
+
+/* bytes the session has taken off the socket but not parsed yet */
+static int app_websocket_recv_pending(struct websocket *app_ws_session)
+{
+    if (app_ws_session->session.socket_fd < 0)
+    {
+        return 0;
+    }
+
+#ifdef WEBSOCKET_SERVICE_USING_URING
+    if (app_ws_session->uring_io && app_websocket_uring_pending(app_ws_session->worker, app_ws_session))
+    {
+        return 1;
+    }
+#endif
+
+    return websocket_recv_pending(&app_ws_session->session);
+}
+
+static void worker_take_commands(struct websocket_worker *_worker, ws_list_t *sessions, ws_list_t *ready)
+{
+    struct websocket *app_ws_session;
+    ws_mpsc_node_t *node;
+    int cmd;
+
+    while ((node = ws_mpsc_pop(&_worker->commands)) != NULL)
+    {
+        app_ws_session = ws_container_of(node, struct websocket, cmd_node);
+        cmd = __atomic_exchange_n(&app_ws_session->cmd, 0, __ATOMIC_ACQ_REL);
+
+        if (app_ws_session->clean_due)
+        {
+            app_websocket_session_clean(app_ws_session);
+            continue;
+        }
+
+        if (cmd & APP_WEBSOCKET_CMD_CONNECT)
+        {
+            if (app_ws_session->node.next == &app_ws_session->node)
+            {
+                ws_list_insert_before(sessions, &app_ws_session->node);
+            }
+            /* a session that has been closed connects again */
+            if (app_ws_session->state == WEBSOCKET_STATE_EXIT)
+            {
+                app_ws_session->state = WEBSOCKET_STATE_INIT;
+            }
+        }
+
+        if (cmd & APP_WEBSOCKET_CMD_WRITE)
+        {
+            worker_session_writable(_worker, ready, app_ws_session);
+        }
+
+        if ((cmd & (APP_WEBSOCKET_CMD_DISCONNECT | APP_WEBSOCKET_CMD_CLOSE)) && app_ws_session->state != WEBSOCKET_STATE_EXIT)
+        {
+            app_ws_session->state = WEBSOCKET_STATE_CLOSE;
+        }
+
+        if (cmd != APP_WEBSOCKET_CMD_WRITE)
+        {
+            worker_ready(ready, app_ws_session);
+        }
+    }
+}
+
+/* one turn of the state machine, the session may be freed when it returns */
+static void worker_session_run(ws_list_t *ready, struct websocket *app_ws_session)
+{
+    if (app_ws_session->state < WEBSOCKET_STATE_MONITOR)
+    {
+        fsm_driver(app_ws_session);
+    }
+
+    while (app_ws_session->state > WEBSOCKET_STATE_MONITOR && app_ws_session->state != WEBSOCKET_STATE_EXIT)
+    {
+        fsm_driver(app_ws_session);
+    }
+
+    if (app_ws_session->state == WEBSOCKET_STATE_EXIT)
+    {
+        fsm_driver(app_ws_session);
+        return;
+    }
+
+    /* data already read ahead will not wake the worker up again */
+    if (app_ws_session->state < WEBSOCKET_STATE_MONITOR || app_websocket_recv_pending(app_ws_session))
+    {
+        if (app_ws_session->state == WEBSOCKET_STATE_MONITOR)
+        {
+            app_ws_session->state = app_ws_session->server_status.server_close ? WEBSOCKET_STATE_CLOSE : WEBSOCKET_STATE_READ;
+        }
+        worker_ready(ready, app_ws_session);
+    }
+#ifdef WEBSOCKET_SERVICE_USING_EPOLL
+    else
+    {
+        app_websocket_worker_idle(app_ws_session->worker, app_ws_session, 0);
+    }
+#endif
+}
+
+static void *worker_entry(void *prma)
+{
+    struct websocket_worker *_worker = (struct websocket_worker *)prma;
+    struct websocket *websocket_session;
+    ws_list_t worker_list = WS_LIST_OBJECT_INIT(worker_list);
+    ws_list_t ready = WS_LIST_OBJECT_INIT(ready);
+    ws_list_t run = WS_LIST_OBJECT_INIT(run);
+    ws_list_t *pos;
+    int timeout;
+
+    while (1)
+    {
+        while (_worker->armed.next != &_worker->armed)
+        {
+            websocket_session = ws_container_of(_worker->armed.next, struct websocket, arm_node);
+            ws_list_remove(&websocket_session->arm_node);
+            worker_session_writable(_worker, &ready, websocket_session);
+        }
+
+        timeout = (ready.next == &ready && ws_mpsc_empty(&_worker->commands)) ? websocket_timer_wheel_timeout(&_worker->timers, ws_tick_ms()) : 0;
+        if (worker_wait(_worker, &worker_list, &ready, timeout))
+        {
+            break;
+        }
+
+        /* posts from here on signal the wakeup again */
+        __atomic_store_n(&_worker->wakeup_pending, 0, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&_worker->quit, __ATOMIC_ACQUIRE))
+        {
+            break;
+        }
+        worker_take_commands(_worker, &worker_list, &ready);
+        websocket_timer_wheel_advance(&_worker->timers, ws_tick_ms(), &ready);
+
+        /* sessions made ready while running go to the next turn */
+        worker_take_ready(&ready, &run);
+        while (run.next != &run)
+        {
+            pos = run.next;
+            ws_list_remove(pos);
+            websocket_session = ws_container_of(pos, struct websocket, ready_node);
+            worker_session_run(&ready, websocket_session);
+        }
+    }
+
+    return "byby";
+}
+
+static void app_websocket_worker_free(struct websocket_worker *_worker)
+{
+#ifdef WEBSOCKET_SERVICE_USING_EPOLL
+    if (_worker->epfd >= 0)
+        close(_worker->epfd);
+#ifdef WEBSOCKET_SERVICE_USING_URING
+    if (_worker->uring)
+    {
+        websocket_uring_exit(_worker->uring);
+        WEBSOCKET_FREE(_worker->uring);
+    }
+    while (_worker->orphans)
+    {
+        struct app_websocket_uring_send *req = _worker->orphans;
+
+        _worker->orphans = req->next;
+        app_websocket_uring_send_free(req);
+    }
+    WEBSOCKET_FREE(_worker->slots);
+    WEBSOCKET_FREE(_worker->chunk_next);
+    WEBSOCKET_FREE(_worker->chunk_len);
+#endif
+#else
+    WEBSOCKET_FREE(_worker->poll);
+#endif
+    if (_worker->wakeup[0] >= 0)
+    {
+        close(_worker->wakeup[0]);
+        if (_worker->wakeup[1] != _worker->wakeup[0])
+            close(_worker->wakeup[1]);
+    }
+    websocket_pool_clear(&_worker->pool);
+    WEBSOCKET_FREE(_worker);
+}
+
+#ifdef WEBSOCKET_SERVICE_USING_URING
+/* on any failure the worker is left without a ring and runs on epoll */
+static int app_websocket_worker_uring_init(struct websocket_worker *_worker)
+{
+    struct websocket_uring *ring = WEBSOCKET_CALLOC(1, sizeof(struct websocket_uring));
+
+    if (ring == NULL)
+    {
+        return -WEBSOCKET_NOMEM;
+    }
+
+    if (websocket_uring_init(ring, WEBSOCKET_SERVICE_URING_ENTRIES) != WEBSOCKET_OK)
+    {
+        WEBSOCKET_FREE(ring);
+        return -WEBSOCKET_ERROR;
+    }
+
+    /* the timer wheel needs waits that time out */
+    if (!(ring->features & IORING_FEAT_EXT_ARG))
+    {
+        websocket_uring_exit(ring);
+        WEBSOCKET_FREE(ring);
+        return -WEBSOCKET_ERROR;
+    }
+
+    _worker->chunk_next = WEBSOCKET_MALLOC(WEBSOCKET_SERVICE_URING_BUFFERS * sizeof(uint16_t));
+    _worker->chunk_len = WEBSOCKET_MALLOC(WEBSOCKET_SERVICE_URING_BUFFERS * sizeof(uint32_t));
+    if (_worker->chunk_next == NULL || _worker->chunk_len == NULL ||
+        websocket_uring_buffers_init(ring, WEBSOCKET_SERVICE_URING_BUFFERS, WEBSOCKET_SERVICE_URING_BUFFER_SIZE, 0) != WEBSOCKET_OK)
+    {
+        websocket_uring_exit(ring);
+        WEBSOCKET_FREE(ring);
+        WEBSOCKET_FREE(_worker->chunk_next);
+        WEBSOCKET_FREE(_worker->chunk_len);
+        _worker->chunk_next = NULL;
+        _worker->chunk_len = NULL;
+        return -WEBSOCKET_ERROR;
+    }
+
+    _worker->uring = ring;
+    return WEBSOCKET_OK;
+}
+#endif
+
+struct websocket_worker *app_websocket_worker_create(const struct app_websocket_worker_config *cfg)
+{
+    struct websocket_worker *_worker = WEBSOCKET_CALLOC(1, sizeof(struct websocket_worker));
+
+    if (_worker == NULL)
+    {
+        return NULL;
+    }
+
+    ws_list_init(&_worker->node);
+    ws_mpsc_init(&_worker->commands);
+    ws_list_init(&_worker->armed);
+    websocket_pool_init(&_worker->pool, WEBSOCKET_SERVICE_POOL_KEEP);
+#ifdef WEBSOCKET_SERVICE_USING_URING
+    ws_list_init(&_worker->starved);
+#endif
+    websocket_timer_wheel_init(&_worker->timers, ws_tick_ms());
+    _worker->wakeup[0] = _worker->wakeup[1] = -1;
+#ifdef WEBSOCKET_SERVICE_USING_EPOLL
+    struct epoll_event event;
+
+    _worker->epfd = -1;
+#ifdef WEBSOCKET_SERVICE_USING_URING
+    if (cfg && cfg->engine == APP_WEBSOCKET_ENGINE_IO_URING)
+    {
+        app_websocket_worker_uring_init(_worker);
+    }
+    if (_worker->uring == NULL)
+#endif
+    {
+        _worker->epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (_worker->epfd < 0)
+        {
+            app_websocket_worker_free(_worker);
+            return NULL;
+        }
+    }
+#endif
+
+#ifdef WEBSOCKET_SERVICE_USING_EVENTFD
+    _worker->wakeup[0] = _worker->wakeup[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_worker->wakeup[0] < 0)
+#else
+    if (pipe(_worker->wakeup) < 0 || fcntl(_worker->wakeup[0], F_SETFL, fcntl(_worker->wakeup[0], F_GETFL) | O_NONBLOCK) < 0)
+#endif
+    {
+        app_websocket_worker_free(_worker);
+        return NULL;
+    }
+
+#ifdef WEBSOCKET_SERVICE_USING_URING
+    if (_worker->uring && worker_uring_watch_wakeup(_worker) != WEBSOCKET_OK)
+    {
+        app_websocket_worker_free(_worker);
+        return NULL;
+    }
+#endif
+#ifdef WEBSOCKET_SERVICE_USING_EPOLL
+    if (_worker->epfd >= 0)
+    {
+        event.events = EPOLLIN;
+        event.data.ptr = NULL;
+        epoll_ctl(_worker->epfd, EPOLL_CTL_ADD, _worker->wakeup[0], &event);
+    }
+#endif
+
+    if (pthread_create(&_worker->tid, NULL, worker_entry, _worker) != 0)
+    {
+        app_websocket_worker_free(_worker);
+        return NULL;
+    }
+
+#ifdef __linux__
+    if (cfg && cfg->cpu >= 0)
+    {
+        cpu_set_t cpus;
+
+        CPU_ZERO(&cpus);
+        CPU_SET(cfg->cpu, &cpus);
+        pthread_setaffinity_np(_worker->tid, sizeof(cpus), &cpus);
+    }
+#endif
+
+    pthread_mutex_lock(&websocket_worker_lock);
+    ws_list_insert_before(&websocket_worker_list, &_worker->node);
+    pthread_mutex_unlock(&websocket_worker_lock);
+
+    return _worker;
+}
+
+/* sessions still assigned to the worker are left as they are, disconnect them first */
+int app_websocket_worker_destroy(struct websocket_worker *_worker)
+{
+    if (_worker == NULL)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    /* placement charges the load under the same lock, nothing lands on the worker once it is off the list */
+    pthread_mutex_lock(&websocket_worker_lock);
+    if (__atomic_load_n(&_worker->load, __ATOMIC_ACQUIRE) > 0)
+    {
+        pthread_mutex_unlock(&websocket_worker_lock);
+        return -WEBSOCKET_AGAIN;
+    }
+    ws_list_remove(&_worker->node);
+    pthread_mutex_unlock(&websocket_worker_lock);
+
+    __atomic_store_n(&_worker->quit, 1, __ATOMIC_RELEASE);
+    app_websocket_worker_signal(_worker);
+    pthread_join(_worker->tid, NULL);
+    app_websocket_worker_free(_worker);
+
+    return WEBSOCKET_OK;
+}
+
+int app_websocket_worker_load(struct websocket_worker *_worker)
+{
+    return _worker ? __atomic_load_n(&_worker->load, __ATOMIC_RELAXED) : -WEBSOCKET_ERROR;
+}
+
+app_websocket_engine_t app_websocket_worker_engine(struct websocket_worker *_worker)
+{
+#ifdef WEBSOCKET_SERVICE_USING_URING
+    if (_worker && _worker->uring)
+    {
+        return APP_WEBSOCKET_ENGINE_IO_URING;
+    }
+#endif
+    return APP_WEBSOCKET_ENGINE_DEFAULT;
+}
+
+int app_websocket_worker_init(void)
+{
+    if (websocket_default_worker == NULL)
+    {
+        websocket_default_worker = app_websocket_worker_create(NULL);
+    }
+
+    return websocket_default_worker ? 0 : -WEBSOCKET_ERROR;
+}
+
+int app_websocket_worker_deinit(void)
+{
+    int res = app_websocket_worker_destroy(websocket_default_worker);
+
+    if (res == WEBSOCKET_OK)
+    {
+        websocket_default_worker = NULL;
+    }
+    return res;
+}
+
+int app_websocket_set_worker_policy(app_websocket_worker_policy_t policy)
+{
+    if (policy != APP_WEBSOCKET_WORKER_ROUND_ROBIN && policy != APP_WEBSOCKET_WORKER_LEAST_LOADED)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    pthread_mutex_lock(&websocket_worker_lock);
+    websocket_worker_policy = policy;
+    pthread_mutex_unlock(&websocket_worker_lock);
+
+    return WEBSOCKET_OK;
+}
+
+int app_websocket_set_worker_select(app_websocket_worker_select_t select, void *userdata)
+{
+    pthread_mutex_lock(&websocket_worker_lock);
+    websocket_worker_select = select;
+    websocket_worker_select_userdata = userdata;
+    pthread_mutex_unlock(&websocket_worker_lock);
+
+    return WEBSOCKET_OK;
+}
+
+/* place a session on its first connect, the chosen worker is charged with it right away */
+static struct websocket_worker *app_websocket_worker_pick(struct app_websocket *websocket)
+{
+    struct websocket_worker *_worker = NULL, *candidate;
+    app_websocket_worker_select_t select;
+    void *userdata;
+    ws_list_t *node;
+    unsigned int count = 0, index;
+
+    pthread_mutex_lock(&websocket_worker_lock);
+    select = websocket_worker_select;
+    userdata = websocket_worker_select_userdata;
+    pthread_mutex_unlock(&websocket_worker_lock);
+
+    if (select)
+    {
+        _worker = select(websocket, userdata);
+    }
+
+    pthread_mutex_lock(&websocket_worker_lock);
+    if (_worker == NULL)
+    {
+        ws_list_for_each(node, &websocket_worker_list)
+        {
+            count += 1;
+        }
+
+        index = count ? websocket_worker_next++ % count : 0;
+        ws_list_for_each(node, &websocket_worker_list)
+        {
+            candidate = ws_container_of(node, struct websocket_worker, node);
+            if (websocket_worker_policy == APP_WEBSOCKET_WORKER_LEAST_LOADED)
+            {
+                if (_worker == NULL || __atomic_load_n(&candidate->load, __ATOMIC_RELAXED) < __atomic_load_n(&_worker->load, __ATOMIC_RELAXED))
+                    _worker = candidate;
+            }
+            else if (index-- == 0)
+            {
+                _worker = candidate;
+                break;
+            }
+        }
+    }
+
+    if (_worker)
+    {
+        __atomic_add_fetch(&_worker->load, 1, __ATOMIC_RELAXED);
     }
+    pthread_mutex_unlock(&websocket_worker_lock);
 
-    return "byby";
+    return _worker;
 }
 
-int app_websocket_worker_init(void)
+int app_websocket_set_worker(struct app_websocket *websocket, struct websocket_worker *_worker)
 {
-    memset(&worker, 0, sizeof(worker));
-    pipe(worker.pipe);
-    pthread_mutex_init(&worker.lock, NULL);
-    pthread_create(&worker.tid, NULL, worker_entry, &worker);
-    return 0;
-}
+    if (websocket == NULL || websocket->websocket_session == NULL || _worker == NULL || websocket->websocket_session->worker != NULL)
+    {
+        return -WEBSOCKET_ERROR;
+    }
 
-int app_websocket_worker_deinit(void)
-{
-    write(worker.pipe[1], "q", 1);
-    pthread_join(worker.tid, NULL);
-    pthread_detach(worker.tid);
-    pthread_mutex_destroy(&worker.lock);
-    return 0;
+    pthread_mutex_lock(&websocket_worker_lock);
+    __atomic_add_fetch(&_worker->load, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&websocket_worker_lock);
+    websocket->websocket_session->worker = _worker;
+    return WEBSOCKET_OK;
 }
 
 void websocket_kv_table_deinit(struct websocket_kv_table *kv_tab)
@@ -520,12 +2781,10 @@ int websocket_kv_put(struct websocket_kv_table *kv_tab, const char *key, const c
 int app_websocket_init(struct app_websocket *websocket)
 {
     int res = -WEBSOCKET_ERROR;
-    char *cache_buf = NULL;
     pthread_mutex_t lock;
     int success = (
         (websocket) &&
         (websocket->websocket_session = WEBSOCKET_MALLOC(sizeof(struct websocket))) &&
-        (cache_buf = WEBSOCKET_MALLOC(WEBSOCKET_SERVICE_CACHE_SIZE_MAX)) &&
         (!pthread_mutex_init(&lock, NULL))
     );
 
@@ -533,17 +2792,28 @@ int app_websocket_init(struct app_websocket *websocket)
     {
         WEBSOCKET_MEMSET(websocket->websocket_session, 0, sizeof(struct websocket));
         ws_list_init(&websocket->websocket_session->node);
-        websocket->websocket_session->cache.buf = cache_buf;
+        ws_list_init(&websocket->websocket_session->ready_node);
+        ws_list_init(&websocket->websocket_session->arm_node);
+#ifdef WEBSOCKET_SERVICE_USING_URING
+        ws_list_init(&websocket->websocket_session->starve_node);
+#endif
+        websocket->websocket_session->watch_fd = -1;
         websocket->websocket_session->lock = lock;
+        pthread_mutex_init(&websocket->websocket_session->out_lock, NULL);
+        websocket_session_init(&websocket->websocket_session->session);
+        websocket->websocket_session->out_high = WEBSOCKET_SERVICE_WRITE_HIGH_WATERMARK;
+        websocket->websocket_session->out_low = WEBSOCKET_SERVICE_WRITE_LOW_WATERMARK;
+        websocket->websocket_session->timeouts.handshake_ms = WEBSOCKET_SERVICE_HANDSHAKE_TIMEOUT_MS;
+        websocket->websocket_session->timeouts.idle_ms = WEBSOCKET_SERVICE_IDLE_TIMEOUT_MS;
+        websocket->websocket_session->timeouts.close_ms = WEBSOCKET_SERVICE_CLOSE_TIMEOUT_MS;
+        websocket_timer_init(&websocket->websocket_session->idle_timer, worker_idle_expire);
+        websocket_timer_init(&websocket->websocket_session->close_timer, worker_close_expire);
+        websocket_timer_init(&websocket->websocket_session->retry_timer, worker_retry_expire);
         websocket->websocket_session->app_websocket = websocket;
         websocket->websocket_session->state = WEBSOCKET_STATE_INIT;
-        websocket->websocket_session->cache.length = WEBSOCKET_SERVICE_CACHE_SIZE_MAX;
-        websocket->websocket_session->cache.recv_index = 0;
-        WEBSOCKET_MEMSET(websocket->websocket_session->cache.buf, 0, WEBSOCKET_SERVICE_CACHE_SIZE_MAX);
     }
     else 
     {
-        WEBSOCKET_FREE(cache_buf);
         WEBSOCKET_FREE(websocket->websocket_session);
     }
 
@@ -555,8 +2825,14 @@ void app_websocket_deinit(struct app_websocket *websocket)
     if (websocket && websocket->websocket_session)
     {
         ws_list_remove(&websocket->websocket_session->node);
+        if (websocket->websocket_session->worker)
+            __atomic_sub_fetch(&websocket->websocket_session->worker->load, 1, __ATOMIC_RELAXED);
         if (websocket->websocket_session->cache.buf)
             WEBSOCKET_FREE(websocket->websocket_session->cache.buf);
+        for (int i = 0; i < websocket->websocket_session->seg_count; i++)
+            WEBSOCKET_FREE(websocket->websocket_session->segs[i].data);
+        if (websocket->websocket_session->segs)
+            WEBSOCKET_FREE(websocket->websocket_session->segs);
         if (websocket->websocket_session->url)
             WEBSOCKET_FREE((void *)websocket->websocket_session->url);
         if (websocket->websocket_session->subprotocol)
@@ -575,6 +2851,9 @@ void app_websocket_deinit(struct app_websocket *websocket)
             }
             WEBSOCKET_FREE(websocket->websocket_session->kv.kv_tab);
         }
+        app_websocket_out_discard(websocket->websocket_session);
+        pthread_mutex_destroy(&websocket->websocket_session->out_lock);
+        websocket_session_deinit(&websocket->websocket_session->session);
         WEBSOCKET_MEMSET(websocket->websocket_session, 0, sizeof(struct websocket));
         WEBSOCKET_FREE(websocket->websocket_session);
     }
@@ -594,6 +2873,159 @@ int app_websocket_set_subprotocol(struct app_websocket *websocket, const char *s
     return websocket->websocket_session->subprotocol ? 0 : -1;
 }
 
+int app_websocket_set_cache_size(struct app_websocket *websocket, size_t size)
+{
+    if (websocket == NULL || websocket->websocket_session == NULL)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    websocket->websocket_session->send_cache_size = size;
+    return WEBSOCKET_OK;
+}
+
+int app_websocket_set_socket_options(struct app_websocket *websocket, const struct websocket_socket_options *options)
+{
+    if (websocket == NULL || websocket->websocket_session == NULL || options == NULL)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    websocket->websocket_session->sockopt = *options;
+    return WEBSOCKET_OK;
+}
+
+int app_websocket_set_deflate(struct app_websocket *websocket, const struct websocket_deflate_options *options)
+{
+    if (websocket == NULL || websocket->websocket_session == NULL || options == NULL)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+#ifndef WEBSOCKET_USING_DEFLATE
+    if (options->enable)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+#endif
+
+    websocket->websocket_session->deflate = *options;
+    return WEBSOCKET_OK;
+}
+
+int app_websocket_set_utf8_validation(struct app_websocket *websocket, int enable)
+{
+    if (websocket == NULL || websocket->websocket_session == NULL)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    websocket->websocket_session->utf8_validate = enable;
+    return WEBSOCKET_OK;
+}
+
+int app_websocket_set_max_frame_payload(struct app_websocket *websocket, size_t size)
+{
+    if (websocket == NULL || websocket->websocket_session == NULL)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    websocket->websocket_session->max_frame_payload = size;
+    return WEBSOCKET_OK;
+}
+
+int app_websocket_set_max_message_size(struct app_websocket *websocket, size_t size)
+{
+    if (websocket == NULL || websocket->websocket_session == NULL || size > INT_MAX)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    websocket->websocket_session->max_message = size;
+    return WEBSOCKET_OK;
+}
+
+int app_websocket_set_timeouts(struct app_websocket *websocket, const struct app_websocket_timeouts *timeouts)
+{
+    if (websocket == NULL || websocket->websocket_session == NULL || timeouts == NULL)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    websocket->websocket_session->timeouts = *timeouts;
+    return WEBSOCKET_OK;
+}
+
+int app_websocket_set_reconnect(struct app_websocket *websocket, const struct app_websocket_reconnect *reconnect)
+{
+    struct websocket *ws;
+    int locked;
+
+    if (websocket == NULL || websocket->websocket_session == NULL || reconnect == NULL)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    /* the worker reads it under the session lock, which it already holds when a callback calls this */
+    ws = websocket->websocket_session;
+    locked = ws->worker == NULL || !pthread_equal(pthread_self(), ws->worker->tid);
+    if (locked && app_websocket_enter_critical(ws) != WEBSOCKET_OK)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+    ws->retry.base_ms = reconnect->base_ms;
+    ws->retry.max_ms = reconnect->max_ms;
+    ws->retry.max_attempts = reconnect->max_attempts;
+    if (locked)
+    {
+        app_websocket_exit_critical(ws);
+    }
+
+    return WEBSOCKET_OK;
+}
+
+int app_websocket_set_reconnect_limit(int limit)
+{
+    if (limit <= 0)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    __atomic_store_n(&websocket_reconnect_limit.limit, limit, __ATOMIC_RELAXED);
+    return WEBSOCKET_OK;
+}
+
+int app_websocket_set_watermarks(struct app_websocket *websocket, size_t high, size_t low)
+{
+    struct websocket *ws;
+
+    if (websocket == NULL || websocket->websocket_session == NULL || (high && low > high))
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    ws = websocket->websocket_session;
+    pthread_mutex_lock(&ws->out_lock);
+    ws->out_high = high;
+    ws->out_low = low;
+    pthread_mutex_unlock(&ws->out_lock);
+
+    return WEBSOCKET_OK;
+}
+
+size_t app_websocket_buffered_amount(struct app_websocket *websocket)
+{
+    struct websocket *ws = websocket->websocket_session;
+    size_t amount;
+
+    pthread_mutex_lock(&ws->out_lock);
+    amount = ws->out_bytes;
+    pthread_mutex_unlock(&ws->out_lock);
+
+    return amount;
+}
+
 int app_websocket_set_close_reason(struct app_websocket *websocket, websocket_status_code_t code, const char *reason)
 {
     int res = WEBSOCKET_OK;
@@ -630,6 +3062,17 @@ int app_websocket_get_close_reason(struct app_websocket *websocket, websocket_st
     return res;
 }
 
+int app_websocket_get_error_reason(struct app_websocket *websocket, const char **reason)
+{
+    if (websocket == NULL || websocket->websocket_session == NULL || reason == NULL)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    *reason = websocket->websocket_session->error_reason;
+    return WEBSOCKET_OK;
+}
+
 int app_websocket_add_header(struct app_websocket *websocket, const char *key, const char *value)
 {
     int err = WEBSOCKET_OK;
@@ -653,11 +3096,13 @@ int app_websocket_connect_server(struct app_websocket *websocket)
 {
     /* send message */
     struct websocket * ws = websocket->websocket_session;
-    pthread_mutex_lock(&worker.lock);
-    ws_list_remove(&ws->node);
-    ws_list_insert_before(&websocket_session_list, &ws->node);
-    write(worker.pipe[1], "1", 1);
-    pthread_mutex_unlock(&worker.lock);
+
+    if (ws->worker == NULL && (ws->worker = app_websocket_worker_pick(websocket)) == NULL)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    app_websocket_worker_post(ws->worker, ws, APP_WEBSOCKET_CMD_CONNECT);
     return 0;
 }
 
@@ -669,9 +3114,11 @@ int app_websocket_disconnect_server(struct app_websocket *websocket)
     {
         if (ws)
         {
-            ws->state = WEBSOCKET_STATE_CLOSE;
             ws->app_websocket = NULL;
-            write(worker.pipe[1], "0", 1);
+            if (ws->worker)
+                app_websocket_worker_post(ws->worker, ws, APP_WEBSOCKET_CMD_DISCONNECT);
+            else
+                ws->state = WEBSOCKET_STATE_CLOSE;
         }
         app_websocket_exit_critical(ws);
     }
@@ -679,259 +3126,129 @@ int app_websocket_disconnect_server(struct app_websocket *websocket)
     return err;
 }
 
-static int websocket_control_frame_handle(struct app_websocket *websocket)
+int app_websocket_close_server(struct app_websocket *websocket)
 {
-    struct websocket_frame_info *info = &websocket->websocket_session->session.info;
     struct websocket *ws = websocket->websocket_session;
-    char cache[128];
-    int read_len = 0;
-    int res = WEBSOCKET_OK;
-    switch(info->frame_type)
-    {
-    case WEBSOCKET_PING_FRAME:
-        if (info->remain_len > 0)
-        {
-            read_len = websocket_read(&ws->session, cache, info->remain_len);
-            if (read_len > 0)
-                res = websocket_send_pong(&ws->session, cache, read_len);
-            else
-                res = -WEBSOCKET_ERROR;
-        }
-        else
-        {
-            res = websocket_send_pong(&ws->session, NULL, 0);
-        }
-        break;
-    case WEBSOCKET_PONG_FRAME:
-        if (info->remain_len > 0)
-        {
-            res = websocket_read(&ws->session, cache, info->remain_len);
-        }
-        break;
-    case WEBSOCKET_CLOSE_FRAME:
-        if (info->remain_len > 0)
-        {
-            read_len = websocket_read(&ws->session, cache, info->remain_len);
-            if (read_len <= 0)
-            {
-                res = -WEBSOCKET_ERROR;
-                break;
-            }
-            cache[read_len] = '\0';
 
-            if (read_len > 2)
-                websocket_send_close(&ws->session, WEBSOCKET_STATUS_CLOSE_NORMAL, &cache[2], read_len - 2);
-            else
-                websocket_send_close(&ws->session, WEBSOCKET_STATUS_CLOSE_NORMAL, NULL, 0);
-        }
-        break;
-    default:
-        break;
+    if (ws->worker == NULL)
+    {
+        return -WEBSOCKET_ERROR;
     }
 
-    return res;
+    app_websocket_worker_post(ws->worker, ws, APP_WEBSOCKET_CMD_CLOSE);
+    return WEBSOCKET_OK;
 }
 
-static int app_websocket_control_frame_handle(struct app_websocket *websocket)
+int app_websocket_read_data(struct app_websocket *websocket, struct app_websocket_frame *frame)
 {
-    struct websocket_frame_info *info = &websocket->websocket_session->session.info;
-    struct websocket_session *session = &websocket->websocket_session->session;
-    char cache[128] = { 0 };
-    int read_length = 0;
-    int res = WEBSOCKET_OK;
-    switch (info->frame_type)
+    struct websocket *app_session = websocket->websocket_session;
+    int res = -WEBSOCKET_ERROR;
+
+    if (app_session->message_ready && app_session->seg_count)
     {
-    case WEBSOCKET_PING_FRAME:
-        if (info->remain_len != 0)
-        {
-            read_length = websocket_read(session, cache, info->remain_len);
-            if (read_length > 0)
-            {
-                if (websocket_send_pong(session, cache, read_length) != WEBSOCKET_OK)
-                {
-                    res = -WEBSOCKET_ERROR;
-                }
-            }
-            else
-            {
-                res = -WEBSOCKET_ERROR;
-            }
-        }
-        else
-        {
-            if (websocket_send_pong(session, NULL, 0) != WEBSOCKET_OK)
-            {
-                res = -WEBSOCKET_ERROR;
-            }
-        }
-        break;
-    case WEBSOCKET_PONG_FRAME:
-        if (info->remain_len != 0)
-        {
-            read_length = websocket_read(session, cache, info->remain_len);
-            if (read_length <= 0)
-            {
-                res = -WEBSOCKET_ERROR;
-            }
-        }
-        break;
-    case WEBSOCKET_CLOSE_FRAME:
-        if (info->remain_len != 0)
+        app_session->error_reason = "Message is chained, read it with app_websocket_read_iov!!";
+    }
+    else if (app_session->message_ready)
+    {
+        res = WEBSOCKET_OK;
+        if (frame)
         {
-            read_length = websocket_read(session, cache, info->remain_len);
-            if (read_length <= 0)
-            {
-                res = -WEBSOCKET_ERROR;
-                break;
-            }
-
-            cache[read_length] = '\0';
-
-            if (read_length > 2)
-            {
-                websocket_send_close(session, WEBSOCKET_STATUS_CLOSE_NORMAL, &cache[2], read_length - 2);
-                if (websocket->websocket_session->server_status.status.reason)
-                {
-                    WEBSOCKET_FREE(websocket->websocket_session->server_status.status.reason);
-                }
-
-                websocket->websocket_session->server_status.status.reason = WEBSOCKET_STRDUP(&cache[2]);
-            }
-            else
-            {
-                websocket_send_close(session, WEBSOCKET_STATUS_CLOSE_NORMAL, NULL, 0);
-                websocket->websocket_session->server_status.status.reason = NULL;
-            }
-            memcpy(&websocket->websocket_session->server_status.status.status_code, cache, 2);
-            websocket->websocket_session->server_status.status.status_code = ntohs(websocket->websocket_session->server_status.status.status_code);
+            frame->data = (void *)app_session->message;
+            frame->length = app_session->recv_size;
+            frame->type = app_session->message_type;
+            res = app_session->recv_size;
         }
-        websocket->websocket_session->server_status.server_close = 1;
-        break;
-    default:
-        break;
+        app_session->recv_size = 0;
+        app_session->message_ready = 0;
     }
-
-    if (res != WEBSOCKET_OK)
+    else
     {
-        websocket->websocket_session->error_reason = "Error reading data!!";
+        app_session->error_reason = "Error reading data!!";
     }
 
     return res;
 }
 
-static int app_websocket_recive_data(struct app_websocket *websocket)
+int app_websocket_read_iov(struct app_websocket *websocket, const struct app_websocket_iovec **iov, int *iovcnt, websocket_frame_type_t *type)
 {
-    struct websocket *app_session = websocket->websocket_session;
-    struct websocket_session *session = &websocket->websocket_session->session;
-    struct websocket_frame_info *info = &session->info;
-    int read_length = 0;
-    int res = WEBSOCKET_OK;
-    unsigned int free_spacce = app_session->cache.length - app_session->cache.recv_index;
+    struct websocket *app_session;
+    int res;
 
-    if ((unsigned int)info->remain_len >= free_spacce)
+    if (websocket == NULL || websocket->websocket_session == NULL || iov == NULL || iovcnt == NULL)
     {
-        char *new_addr;
-        int append_mem_cnt = (info->remain_len - free_spacce) / WEBSOCKET_SERVICE_CACHE_SIZE_MAX;
-        unsigned int buf_size = app_session->cache.length + (append_mem_cnt + 1) * WEBSOCKET_SERVICE_CACHE_SIZE_MAX;
+        return -WEBSOCKET_ERROR;
+    }
 
-        if (buf_size <= WEBSOCKET_SERVICE_CACHE_SIZE_MAX)
-        {
-            new_addr = WEBSOCKET_REALLOC(app_session->cache.buf, buf_size);
-            if (new_addr != NULL)
-            {
-                app_session->cache.length = buf_size;
-                app_session->cache.buf = new_addr;
-            }
-            else
-            {
-                res = -WEBSOCKET_ERROR;
-            }
-        }
-        else
-        {
-            res = -WEBSOCKET_ERROR;
-        }
+    app_session = websocket->websocket_session;
+    if (!app_session->message_ready)
+    {
+        app_session->error_reason = "Error reading data!!";
+        return -WEBSOCKET_ERROR;
+    }
 
-        if (res != WEBSOCKET_OK)
-        {
-            app_session->error_reason = "Resource Starvation!!";
-        }
+    if (app_session->seg_count)
+    {
+        *iov = app_session->segs;
+        *iovcnt = app_session->seg_count;
+    }
+    else
+    {
+        app_session->message_iov.data = (void *)app_session->message;
+        app_session->message_iov.length = app_session->recv_size;
+        *iov = &app_session->message_iov;
+        *iovcnt = 1;
     }
 
-    if (res == WEBSOCKET_OK)
+    if (type)
     {
-        do
-        {
-            if ((read_length = websocket_read(session, app_session->cache.buf + app_session->recv_size, info->remain_len)) > 0)
-            {
-                app_session->recv_size += read_length;
-            }
-            else
-            {
-                app_session->error_reason = "Error reading data!!";
-                res = -WEBSOCKET_ERROR;
-                break;
-            }
-        }
-        while (info->remain_len);
+        *type = app_session->message_type;
     }
+    res = app_session->recv_size;
+    app_session->message_ready = 0;
 
     return res;
 }
 
-int app_websocket_read_data(struct app_websocket *websocket, struct app_websocket_frame *frame)
+/* a queue above the high watermark refuses application data until ondrain */
+static int app_websocket_write_refused(struct websocket *ws)
 {
-    struct websocket_frame_info *info;
-    struct websocket_session *session = &websocket->websocket_session->session;
-    struct websocket *app_session = websocket->websocket_session;
-    int res = -WEBSOCKET_ERROR;
+    return __atomic_load_n(&ws->out_blocked, __ATOMIC_ACQUIRE);
+}
 
-    res = websocket_get_block_info_raw(session);
-    if (res == WEBSOCKET_OK && frame)
-    {
-        info = &session->info;
-        if (info->frame_type == WEBSOCKET_PING_FRAME || info->frame_type == WEBSOCKET_PONG_FRAME \
-                || info->frame_type == WEBSOCKET_CLOSE_FRAME)
-        {
-            res = app_websocket_control_frame_handle(websocket);
-        }
-        else if (info->frame_type == WEBSOCKET_CONTINUE_FRAME || info->is_slice)
-        {
-            res = app_websocket_recive_data(websocket);
-            if (!info->is_slice && res == WEBSOCKET_OK)
-            {
-                app_session->cache.buf[app_session->recv_size] = '\0';
-                frame->data = app_session->cache.buf;
-                frame->length = app_session->recv_size;
-                frame->type = info->frame_type;
-                res = app_session->recv_size;
-                app_session->recv_size = 0;
-            }
-        }
-        else
-        {
-            res = app_websocket_recive_data(websocket);
-            if (res == WEBSOCKET_OK)
-            {
-                app_session->cache.buf[app_session->recv_size] = '\0';
-                frame->data = app_session->cache.buf;
-                frame->length = app_session->recv_size;
-                frame->type = info->frame_type;
-                res = app_session->recv_size;
-                app_session->recv_size = 0;
-            }
-        }
-    }
-    else
+int app_websocket_write_data(struct app_websocket *websocket, struct app_websocket_frame *frame)
+{
+    if (app_websocket_write_refused(websocket->websocket_session))
     {
-        websocket->websocket_session->error_reason = "Error reading data!!";
+        return -WEBSOCKET_AGAIN;
     }
-    return res;
+
+    return websocket_write(&websocket->websocket_session->session, frame->data, frame->length, frame->type);
 }
 
-int app_websocket_write_data(struct app_websocket *websocket, struct app_websocket_frame *frame)
+int app_websocket_write_batch(struct app_websocket *websocket, const struct app_websocket_frame *frames, size_t n)
 {
-    return websocket_write(&websocket->websocket_session->session, frame->data, frame->length, frame->type);
+    struct ws_msg msgs[WEBSOCKET_SERVICE_BATCH_MAX];
+    size_t count;
+    int res = WEBSOCKET_OK;
+
+    if (app_websocket_write_refused(websocket->websocket_session))
+    {
+        return -WEBSOCKET_AGAIN;
+    }
+
+    for (size_t pos = 0; pos < n && res >= 0; pos += count)
+    {
+        count = (n - pos) < WEBSOCKET_SERVICE_BATCH_MAX ? (n - pos) : WEBSOCKET_SERVICE_BATCH_MAX;
+        for (size_t i = 0; i < count; i++)
+        {
+            msgs[i].data = frames[pos + i].data;
+            msgs[i].length = frames[pos + i].length;
+            msgs[i].type = frames[pos + i].type;
+        }
+        res = websocket_write_batch(&websocket->websocket_session->session, msgs, count);
+    }
+
+    return res < 0 ? res : (int)n;
 }
 
 void app_websocket_message_event(struct app_websocket *websocket, int (*onmessage)(struct app_websocket *ws))
@@ -956,4 +3273,16 @@ void app_websocket_error_event(struct app_websocket *websocket, int (*onerror)(s
 {
     if(websocket && websocket->websocket_session)
         websocket->websocket_session->callback.onerror = onerror;
+}
+
+void app_websocket_drain_event(struct app_websocket *websocket, int (*ondrain)(struct app_websocket *ws))
+{
+    if(websocket && websocket->websocket_session)
+        websocket->websocket_session->callback.ondrain = ondrain;
+}
+
+void app_websocket_fragment_event(struct app_websocket *websocket, int (*onfragment)(struct app_websocket *ws, const void *data, size_t len, int is_final, websocket_frame_type_t type))
+{
+    if(websocket && websocket->websocket_session)
+        websocket->websocket_session->callback.onfragment = onfragment;
 }
\ No newline at end of file
@@ -0,0 +1,178 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date          Author       Notes
+ * 2026-10-16    tzy          first implementation
+ */
+#include <limits.h>
+#include "websocket_timer.h"
+
+#define WEBSOCKET_TIMER_LEVEL_MASK          (WEBSOCKET_TIMER_LEVEL_SLOTS - 1)
+#define WEBSOCKET_TIMER_RANGE               ((uint64_t)1 << (WEBSOCKET_TIMER_LEVEL_BITS * WEBSOCKET_TIMER_LEVELS))
+
+/* move every timer of `slot` onto the empty list `to` */
+static void websocket_timer_take(ws_list_t *slot, ws_list_t *to)
+{
+    if (slot->next != slot)
+    {
+        to->next = slot->next;
+        to->prev = slot->prev;
+        to->next->prev = to;
+        to->prev->next = to;
+        ws_list_init(slot);
+    }
+}
+
+/* the lowest level whose slots still tell the expiry apart from the current tick */
+static void websocket_timer_place(struct websocket_timer_wheel *wheel, struct websocket_timer *timer)
+{
+    uint64_t delta = timer->expire > wheel->tick ? timer->expire - wheel->tick : 0;
+    int level = 0;
+
+    if (delta >= WEBSOCKET_TIMER_RANGE)
+    {
+        timer->expire = wheel->tick + WEBSOCKET_TIMER_RANGE - 1;
+        delta = WEBSOCKET_TIMER_RANGE - 1;
+    }
+
+    while ((delta >> (WEBSOCKET_TIMER_LEVEL_BITS * (level + 1))) != 0)
+    {
+        level += 1;
+    }
+
+    /* an overdue timer lands on the current slot and fires with it */
+    ws_list_insert_before(&wheel->slots[level][((delta ? timer->expire : wheel->tick) >> (WEBSOCKET_TIMER_LEVEL_BITS * level)) & WEBSOCKET_TIMER_LEVEL_MASK],
+                          &timer->node);
+}
+
+static void websocket_timer_cascade(struct websocket_timer_wheel *wheel, int level)
+{
+    ws_list_t pending = WS_LIST_OBJECT_INIT(pending);
+    ws_list_t *node;
+
+    websocket_timer_take(&wheel->slots[level][(wheel->tick >> (WEBSOCKET_TIMER_LEVEL_BITS * level)) & WEBSOCKET_TIMER_LEVEL_MASK], &pending);
+    while ((node = pending.next) != &pending)
+    {
+        ws_list_remove(node);
+        websocket_timer_place(wheel, ws_container_of(node, struct websocket_timer, node));
+    }
+}
+
+void websocket_timer_wheel_init(struct websocket_timer_wheel *wheel, uint64_t now_ms)
+{
+    wheel->base_ms = now_ms;
+    wheel->tick = 0;
+    wheel->count = 0;
+    for (int level = 0; level < WEBSOCKET_TIMER_LEVELS; level++)
+    {
+        for (int slot = 0; slot < WEBSOCKET_TIMER_LEVEL_SLOTS; slot++)
+        {
+            ws_list_init(&wheel->slots[level][slot]);
+        }
+    }
+}
+
+int websocket_timer_wheel_advance(struct websocket_timer_wheel *wheel, uint64_t now_ms, void *ctx)
+{
+    ws_list_t expired = WS_LIST_OBJECT_INIT(expired);
+    struct websocket_timer *timer;
+    uint64_t target = (now_ms - wheel->base_ms) / WEBSOCKET_TIMER_TICK_MS;
+    ws_list_t *node;
+    int fired = 0;
+
+    while (wheel->tick < target)
+    {
+        /* an empty wheel has nothing to catch up on */
+        if (wheel->count == 0)
+        {
+            wheel->tick = target;
+            break;
+        }
+
+        wheel->tick += 1;
+        for (int level = 1; level < WEBSOCKET_TIMER_LEVELS; level++)
+        {
+            if ((wheel->tick & (((uint64_t)1 << (WEBSOCKET_TIMER_LEVEL_BITS * level)) - 1)) != 0)
+            {
+                break;
+            }
+            websocket_timer_cascade(wheel, level);
+        }
+
+        /* a handler may arm or cancel any timer, the expired list is walked from its head every time */
+        websocket_timer_take(&wheel->slots[0][wheel->tick & WEBSOCKET_TIMER_LEVEL_MASK], &expired);
+        while ((node = expired.next) != &expired)
+        {
+            ws_list_remove(node);
+            wheel->count -= 1;
+            timer = ws_container_of(node, struct websocket_timer, node);
+            timer->handler(timer, ctx);
+            fired += 1;
+        }
+    }
+
+    return fired;
+}
+
+int websocket_timer_wheel_timeout(const struct websocket_timer_wheel *wheel, uint64_t now_ms)
+{
+    uint64_t ticks = WEBSOCKET_TIMER_LEVEL_SLOTS - (wheel->tick & WEBSOCKET_TIMER_LEVEL_MASK);
+    uint64_t due;
+
+    if (wheel->count == 0)
+    {
+        return -1;
+    }
+
+    /* the nearest busy slot of level 0, otherwise the next cascade */
+    for (uint64_t i = 1; i < WEBSOCKET_TIMER_LEVEL_SLOTS; i++)
+    {
+        const ws_list_t *slot = &wheel->slots[0][(wheel->tick + i) & WEBSOCKET_TIMER_LEVEL_MASK];
+        if (slot->next != slot)
+        {
+            ticks = i;
+            break;
+        }
+    }
+
+    due = wheel->base_ms + (wheel->tick + ticks) * WEBSOCKET_TIMER_TICK_MS;
+    if (due <= now_ms)
+    {
+        return 0;
+    }
+
+    return due - now_ms > INT_MAX ? INT_MAX : (int)(due - now_ms);
+}
+
+void websocket_timer_init(struct websocket_timer *timer, websocket_timer_handler_t handler)
+{
+    ws_list_init(&timer->node);
+    timer->expire = 0;
+    timer->handler = handler;
+}
+
+void websocket_timer_arm(struct websocket_timer_wheel *wheel, struct websocket_timer *timer, uint32_t timeout_ms)
+{
+    if (websocket_timer_armed(timer))
+    {
+        ws_list_remove(&timer->node);
+    }
+    else
+    {
+        wheel->count += 1;
+    }
+
+    /* the wheel may be up to a tick behind the clock, one more keeps a timer from firing early */
+    timer->expire = wheel->tick + (timeout_ms + WEBSOCKET_TIMER_TICK_MS - 1) / WEBSOCKET_TIMER_TICK_MS + 1;
+    websocket_timer_place(wheel, timer);
+}
+
+void websocket_timer_cancel(struct websocket_timer_wheel *wheel, struct websocket_timer *timer)
+{
+    if (websocket_timer_armed(timer))
+    {
+        ws_list_remove(&timer->node);
+        wheel->count -= 1;
+    }
+}
@@ -0,0 +1,293 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date          Author       Notes
+ * 2026-10-16    tzy          first implementation
+ */
+#include "websocket.h"
+#include "websocket_uring.h"
+
+#ifdef WEBSOCKET_USING_IO_URING
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+int websocket_uring_init(struct websocket_uring *ring, unsigned int entries)
+{
+    struct io_uring_params params;
+    unsigned int *array;
+    size_t sq_size, cq_size;
+    char *ptr;
+
+    ws_memset(ring, 0, sizeof(struct websocket_uring));
+    ring->fd = -1;
+
+    /* completions are reaped by the same thread on its next enter, no need to interrupt it */
+    ws_memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_COOP_TASKRUN;
+    ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0 && errno == EINVAL)
+    {
+        ws_memset(&params, 0, sizeof(params));
+        ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+    }
+
+    if (ring->fd < 0 || !(params.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        websocket_uring_exit(ring);
+        return -WEBSOCKET_ERROR;
+    }
+    ring->features = params.features;
+
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->ring_size = sq_size > cq_size ? sq_size : cq_size;
+    ring->ring_ptr = mmap(NULL, ring->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->ring_ptr == MAP_FAILED)
+    {
+        ring->ring_ptr = NULL;
+        websocket_uring_exit(ring);
+        return -WEBSOCKET_ERROR;
+    }
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+    {
+        ring->sqes = NULL;
+        websocket_uring_exit(ring);
+        return -WEBSOCKET_ERROR;
+    }
+
+    ptr = (char *)ring->ring_ptr;
+    ring->sq_head = (unsigned int *)(ptr + params.sq_off.head);
+    ring->sq_tail = (unsigned int *)(ptr + params.sq_off.tail);
+    ring->sq_mask = *(unsigned int *)(ptr + params.sq_off.ring_mask);
+    ring->sq_entries = params.sq_entries;
+    ring->sq_local_tail = *ring->sq_tail;
+    ring->cq_head = (unsigned int *)(ptr + params.cq_off.head);
+    ring->cq_tail = (unsigned int *)(ptr + params.cq_off.tail);
+    ring->cq_mask = *(unsigned int *)(ptr + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(ptr + params.cq_off.cqes);
+
+    /* SQE slots are used in ring order, so the index array is the identity */
+    array = (unsigned int *)(ptr + params.sq_off.array);
+    for (unsigned int i = 0; i < params.sq_entries; i++)
+    {
+        array[i] = i;
+    }
+
+    return WEBSOCKET_OK;
+}
+
+void websocket_uring_exit(struct websocket_uring *ring)
+{
+    if (ring->br)
+        munmap(ring->br, ring->br_size);
+    if (ring->buf_base)
+        ws_free(ring->buf_base);
+    if (ring->sqes)
+        munmap(ring->sqes, ring->sqes_size);
+    if (ring->ring_ptr)
+        munmap(ring->ring_ptr, ring->ring_size);
+    if (ring->fd >= 0)
+        close(ring->fd);
+
+    ws_memset(ring, 0, sizeof(struct websocket_uring));
+    ring->fd = -1;
+}
+
+struct io_uring_sqe *websocket_uring_get_sqe(struct websocket_uring *ring)
+{
+    struct io_uring_sqe *sqe;
+
+    if (ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries)
+    {
+        return NULL;
+    }
+
+    sqe = &ring->sqes[ring->sq_local_tail & ring->sq_mask];
+    ring->sq_local_tail += 1;
+    ws_memset(sqe, 0, sizeof(struct io_uring_sqe));
+
+    return sqe;
+}
+
+int websocket_uring_enter(struct websocket_uring *ring, unsigned int wait_nr, int timeout_ms)
+{
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned int to_submit = ring->sq_local_tail - *ring->sq_tail;
+    unsigned int flags = 0;
+    int res;
+
+    if (timeout_ms == 0)
+    {
+        wait_nr = 0;
+    }
+
+    /* nothing to hand over and nothing to wait for, the CQ ring is read without the kernel */
+    if (to_submit == 0 && wait_nr == 0)
+    {
+        return 0;
+    }
+
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    if (wait_nr)
+    {
+        flags |= IORING_ENTER_GETEVENTS;
+    }
+
+    if (wait_nr && timeout_ms > 0 && (ring->features & IORING_FEAT_EXT_ARG))
+    {
+        ws_memset(&arg, 0, sizeof(arg));
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+        res = syscall(__NR_io_uring_enter, ring->fd, to_submit, wait_nr, flags | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    }
+    else
+    {
+        res = syscall(__NR_io_uring_enter, ring->fd, to_submit, wait_nr, flags, NULL, 0);
+    }
+
+    if (res < 0)
+    {
+        return (errno == EINTR || errno == ETIME || errno == EAGAIN || errno == EBUSY) ? 0 : -WEBSOCKET_ERROR;
+    }
+
+    return res;
+}
+
+struct io_uring_cqe *websocket_uring_peek_cqe(struct websocket_uring *ring)
+{
+    unsigned int head = *ring->cq_head;
+
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+    {
+        return NULL;
+    }
+
+    return &ring->cqes[head & ring->cq_mask];
+}
+
+void websocket_uring_cqe_seen(struct websocket_uring *ring)
+{
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+void websocket_uring_prep_recv_multishot(struct io_uring_sqe *sqe, int fd, unsigned short buf_group, uint64_t user_data)
+{
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = buf_group;
+    sqe->user_data = user_data;
+}
+
+void websocket_uring_prep_sendmsg(struct io_uring_sqe *sqe, int fd, const struct msghdr *msg, unsigned int flags, uint64_t user_data)
+{
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)msg;
+    sqe->len = 1;
+    sqe->msg_flags = flags;
+    sqe->user_data = user_data;
+}
+
+void websocket_uring_prep_poll(struct io_uring_sqe *sqe, int fd, unsigned int events, uint64_t user_data)
+{
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    events = (events << 16) | (events >> 16);
+#endif
+    sqe->poll32_events = events;
+    sqe->user_data = user_data;
+}
+
+void websocket_uring_prep_poll_multishot(struct io_uring_sqe *sqe, int fd, unsigned int events, uint64_t user_data)
+{
+    websocket_uring_prep_poll(sqe, fd, events, user_data);
+    sqe->len = IORING_POLL_ADD_MULTI;
+}
+
+void websocket_uring_prep_cancel(struct io_uring_sqe *sqe, uint64_t target, uint64_t user_data)
+{
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = user_data;
+}
+
+int websocket_uring_buffers_init(struct websocket_uring *ring, unsigned int count, unsigned int size, unsigned short group)
+{
+    struct io_uring_buf_reg reg;
+    long page = sysconf(_SC_PAGESIZE);
+
+    if (count == 0 || count > 32768 || (count & (count - 1)) != 0)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    ring->br_size = (count * sizeof(struct io_uring_buf) + page - 1) & ~(size_t)(page - 1);
+    ring->br = mmap(NULL, ring->br_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring->br == MAP_FAILED)
+    {
+        ring->br = NULL;
+        return -WEBSOCKET_NOMEM;
+    }
+
+    ring->buf_base = ws_malloc((size_t)count * size);
+    if (ring->buf_base == NULL)
+    {
+        return -WEBSOCKET_NOMEM;
+    }
+
+    ws_memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring->br;
+    reg.ring_entries = count;
+    reg.bgid = group;
+    if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    ring->buf_count = count;
+    ring->buf_size = size;
+    ring->buf_group = group;
+    ring->br_tail = 0;
+    for (unsigned int bid = 0; bid < count; bid++)
+    {
+        websocket_uring_buffer_recycle(ring, (unsigned short)bid);
+    }
+    websocket_uring_buffers_commit(ring);
+
+    return WEBSOCKET_OK;
+}
+
+char *websocket_uring_buffer(struct websocket_uring *ring, unsigned short bid)
+{
+    return ring->buf_base + (size_t)bid * ring->buf_size;
+}
+
+void websocket_uring_buffer_recycle(struct websocket_uring *ring, unsigned short bid)
+{
+    struct io_uring_buf *buf = &ring->br->bufs[ring->br_tail & (ring->buf_count - 1)];
+
+    buf->addr = (uint64_t)(uintptr_t)websocket_uring_buffer(ring, bid);
+    buf->len = ring->buf_size;
+    buf->bid = bid;
+    ring->br_tail += 1;
+}
+
+void websocket_uring_buffers_commit(struct websocket_uring *ring)
+{
+    __atomic_store_n(&ring->br->tail, ring->br_tail, __ATOMIC_RELEASE);
+}
+
+#endif /* WEBSOCKET_USING_IO_URING */
@@ -0,0 +1,532 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date          Author       Notes
+ * 2026-10-16    tzy          first implementation
+ */
+#include <string.h>
+#include "websocket.h"
+#include "websocket_utf8.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define WEBSOCKET_UTF8_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define WEBSOCKET_UTF8_NEON
+#include <arm_neon.h>
+#endif
+
+/* kernels validate a buffer that must end on a code point boundary, they return 0 if it is valid */
+typedef int (*websocket_utf8_fn)(const unsigned char *data, size_t length);
+
+/*
+ * Error classes of the lookup algorithm (Keiser & Lemire, "Validating UTF-8 In Less
+ * Than One Instruction Per Byte"). Every byte pair is classified by three 16-entry
+ * tables, indexed by the high and low nibble of the first byte and the high nibble of
+ * the second one; a pair is bad when the three lookups share a bit.
+ */
+#define UTF8_TOO_SHORT          (1 << 0)
+#define UTF8_TOO_LONG           (1 << 1)
+#define UTF8_OVERLONG_3         (1 << 2)
+#define UTF8_TOO_LARGE          (1 << 3)
+#define UTF8_SURROGATE          (1 << 4)
+#define UTF8_OVERLONG_2         (1 << 5)
+#define UTF8_TOO_LARGE_1000     (1 << 6)
+#define UTF8_OVERLONG_4         (1 << 6)
+#define UTF8_TWO_CONTS          (1 << 7)
+#define UTF8_CARRY              (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+static const unsigned char websocket_utf8_byte_1_high[16] =
+{
+    /* 0_______ ASCII */
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+    /* 10______ continuation */
+    UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+    /* 1100____ 1101____ two byte lead */
+    UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+    UTF8_TOO_SHORT,
+    /* 1110____ three byte lead */
+    UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+    /* 1111____ four byte lead */
+    UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4
+};
+
+static const unsigned char websocket_utf8_byte_1_low[16] =
+{
+    UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+    UTF8_CARRY | UTF8_OVERLONG_2,
+    UTF8_CARRY,
+    UTF8_CARRY,
+    UTF8_CARRY | UTF8_TOO_LARGE,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000
+};
+
+static const unsigned char websocket_utf8_byte_2_high[16] =
+{
+    /* ASCII after a lead byte */
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+    /* 1000____ 1001____ 101_____ continuation */
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+    /* 11______ lead byte after a lead byte */
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+};
+
+/* the largest byte that may end a buffer in each of the last three positions */
+static const unsigned char websocket_utf8_max_tail[3] = { 0xf0 - 1, 0xe0 - 1, 0xc0 - 1 };
+
+/* one byte of the scalar state machine, returns 0 on success */
+static int websocket_utf8_step(struct websocket_utf8 *utf8, unsigned char c)
+{
+    if (utf8->need)
+    {
+        if (c < utf8->lo || c > utf8->hi)
+            return -1;
+        utf8->need -= 1;
+        utf8->lo = 0x80;
+        utf8->hi = 0xbf;
+        return 0;
+    }
+
+    if (c < 0x80)
+        return 0;
+
+    utf8->lo = 0x80;
+    utf8->hi = 0xbf;
+    if (c >= 0xc2 && c <= 0xdf)
+    {
+        utf8->need = 1;
+    }
+    else if (c >= 0xe0 && c <= 0xef)
+    {
+        utf8->need = 2;
+        if (c == 0xe0)
+            utf8->lo = 0xa0;    /* overlong */
+        else if (c == 0xed)
+            utf8->hi = 0x9f;    /* surrogates */
+    }
+    else if (c >= 0xf0 && c <= 0xf4)
+    {
+        utf8->need = 3;
+        if (c == 0xf0)
+            utf8->lo = 0x90;    /* overlong */
+        else if (c == 0xf4)
+            utf8->hi = 0x8f;    /* above U+10FFFF */
+    }
+    else
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int websocket_utf8_scalar(const unsigned char *data, size_t length)
+{
+    struct websocket_utf8 utf8 = { 0 };
+    uint64_t word;
+    size_t i = 0;
+
+    while (i < length)
+    {
+        /* skip ASCII eight bytes at a time */
+        if (utf8.need == 0 && length - i >= sizeof(word))
+        {
+            memcpy(&word, data + i, sizeof(word));
+            if ((word & 0x8080808080808080ULL) == 0)
+            {
+                i += sizeof(word);
+                continue;
+            }
+        }
+
+        if (websocket_utf8_step(&utf8, data[i]) != 0)
+            return -1;
+        i += 1;
+    }
+
+    return utf8.need ? -1 : 0;
+}
+
+#ifdef WEBSOCKET_UTF8_X86
+__attribute__((target("ssse3")))
+static __inline __m128i websocket_utf8_check_ssse3(__m128i input, __m128i prev, __m128i t1, __m128i t2, __m128i t3)
+{
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    __m128i prev1 = _mm_alignr_epi8(input, prev, 15);
+    __m128i prev2 = _mm_alignr_epi8(input, prev, 14);
+    __m128i prev3 = _mm_alignr_epi8(input, prev, 13);
+    __m128i byte_1_high = _mm_shuffle_epi8(t1, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble));
+    __m128i byte_1_low = _mm_shuffle_epi8(t2, _mm_and_si128(prev1, nibble));
+    __m128i byte_2_high = _mm_shuffle_epi8(t3, _mm_and_si128(_mm_srli_epi16(input, 4), nibble));
+    __m128i special = _mm_and_si128(_mm_and_si128(byte_1_high, byte_1_low), byte_2_high);
+    /* the third and fourth byte of a sequence are only known from two and three bytes back */
+    __m128i is_third = _mm_subs_epu8(prev2, _mm_set1_epi8((char)(0xe0 - 0x80)));
+    __m128i is_fourth = _mm_subs_epu8(prev3, _mm_set1_epi8((char)(0xf0 - 0x80)));
+    __m128i must23 = _mm_and_si128(_mm_or_si128(is_third, is_fourth), _mm_set1_epi8((char)0x80));
+
+    return _mm_xor_si128(must23, special);
+}
+
+__attribute__((target("ssse3")))
+static int websocket_utf8_ssse3(const unsigned char *data, size_t length)
+{
+    const __m128i t1 = _mm_loadu_si128((const __m128i *)websocket_utf8_byte_1_high);
+    const __m128i t2 = _mm_loadu_si128((const __m128i *)websocket_utf8_byte_1_low);
+    const __m128i t3 = _mm_loadu_si128((const __m128i *)websocket_utf8_byte_2_high);
+    const __m128i max_tail = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                           (char)websocket_utf8_max_tail[0], (char)websocket_utf8_max_tail[1], (char)websocket_utf8_max_tail[2]);
+    __m128i prev = _mm_setzero_si128();
+    __m128i error = _mm_setzero_si128();
+    __m128i incomplete = _mm_setzero_si128();
+    __m128i input;
+    unsigned char tail[16];
+
+    for (size_t pos = 0; pos < length; pos += 16)
+    {
+        if (length - pos >= 16)
+        {
+            input = _mm_loadu_si128((const __m128i *)(data + pos));
+        }
+        else
+        {
+            /* zero padding is ASCII, a sequence cut by the end still shows up as too short */
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, data + pos, length - pos);
+            input = _mm_loadu_si128((const __m128i *)tail);
+        }
+
+        if (_mm_movemask_epi8(input) == 0)
+        {
+            error = _mm_or_si128(error, incomplete);
+        }
+        else
+        {
+            error = _mm_or_si128(error, websocket_utf8_check_ssse3(input, prev, t1, t2, t3));
+            incomplete = _mm_subs_epu8(input, max_tail);
+        }
+        prev = input;
+    }
+    error = _mm_or_si128(error, incomplete);
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) != 0xffff;
+}
+
+__attribute__((target("avx2")))
+static __inline __m256i websocket_utf8_check_avx2(__m256i input, __m256i prev, __m256i t1, __m256i t2, __m256i t3)
+{
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    /* the 128-bit lanes are shifted on their own, so the upper half of `prev` is joined with the lower half of `input` first */
+    __m256i carry = _mm256_permute2x128_si256(prev, input, 0x21);
+    __m256i prev1 = _mm256_alignr_epi8(input, carry, 15);
+    __m256i prev2 = _mm256_alignr_epi8(input, carry, 14);
+    __m256i prev3 = _mm256_alignr_epi8(input, carry, 13);
+    __m256i byte_1_high = _mm256_shuffle_epi8(t1, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+    __m256i byte_1_low = _mm256_shuffle_epi8(t2, _mm256_and_si256(prev1, nibble));
+    __m256i byte_2_high = _mm256_shuffle_epi8(t3, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+    __m256i special = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+    __m256i is_third = _mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xe0 - 0x80)));
+    __m256i is_fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xf0 - 0x80)));
+    __m256i must23 = _mm256_and_si256(_mm256_or_si256(is_third, is_fourth), _mm256_set1_epi8((char)0x80));
+
+    return _mm256_xor_si256(must23, special);
+}
+
+__attribute__((target("avx2")))
+static int websocket_utf8_avx2(const unsigned char *data, size_t length)
+{
+    const __m256i t1 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)websocket_utf8_byte_1_high));
+    const __m256i t2 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)websocket_utf8_byte_1_low));
+    const __m256i t3 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)websocket_utf8_byte_2_high));
+    const __m256i max_tail = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                              -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                              (char)websocket_utf8_max_tail[0], (char)websocket_utf8_max_tail[1], (char)websocket_utf8_max_tail[2]);
+    __m256i prev = _mm256_setzero_si256();
+    __m256i error = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+    __m256i input;
+    unsigned char tail[32];
+
+    for (size_t pos = 0; pos < length; pos += 32)
+    {
+        if (length - pos >= 32)
+        {
+            input = _mm256_loadu_si256((const __m256i *)(data + pos));
+        }
+        else
+        {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, data + pos, length - pos);
+            input = _mm256_loadu_si256((const __m256i *)tail);
+        }
+
+        if (_mm256_movemask_epi8(input) == 0)
+        {
+            error = _mm256_or_si256(error, incomplete);
+        }
+        else
+        {
+            error = _mm256_or_si256(error, websocket_utf8_check_avx2(input, prev, t1, t2, t3));
+            incomplete = _mm256_subs_epu8(input, max_tail);
+        }
+        prev = input;
+    }
+    error = _mm256_or_si256(error, incomplete);
+
+    return !_mm256_testz_si256(error, error);
+}
+#endif
+
+#ifdef WEBSOCKET_UTF8_NEON
+static __inline uint8x16_t websocket_utf8_check_neon(uint8x16_t input, uint8x16_t prev, uint8x16_t t1, uint8x16_t t2, uint8x16_t t3)
+{
+    uint8x16_t prev1 = vextq_u8(prev, input, 15);
+    uint8x16_t prev2 = vextq_u8(prev, input, 14);
+    uint8x16_t prev3 = vextq_u8(prev, input, 13);
+    uint8x16_t byte_1_high = vqtbl1q_u8(t1, vshrq_n_u8(prev1, 4));
+    uint8x16_t byte_1_low = vqtbl1q_u8(t2, vandq_u8(prev1, vdupq_n_u8(0x0f)));
+    uint8x16_t byte_2_high = vqtbl1q_u8(t3, vshrq_n_u8(input, 4));
+    uint8x16_t special = vandq_u8(vandq_u8(byte_1_high, byte_1_low), byte_2_high);
+    uint8x16_t is_third = vqsubq_u8(prev2, vdupq_n_u8(0xe0 - 0x80));
+    uint8x16_t is_fourth = vqsubq_u8(prev3, vdupq_n_u8(0xf0 - 0x80));
+    uint8x16_t must23 = vandq_u8(vorrq_u8(is_third, is_fourth), vdupq_n_u8(0x80));
+
+    return veorq_u8(must23, special);
+}
+
+static int websocket_utf8_neon(const unsigned char *data, size_t length)
+{
+    const uint8x16_t t1 = vld1q_u8(websocket_utf8_byte_1_high);
+    const uint8x16_t t2 = vld1q_u8(websocket_utf8_byte_1_low);
+    const uint8x16_t t3 = vld1q_u8(websocket_utf8_byte_2_high);
+    static const unsigned char max_tail_bytes[16] =
+    {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xf0 - 1, 0xe0 - 1, 0xc0 - 1
+    };
+    const uint8x16_t max_tail = vld1q_u8(max_tail_bytes);
+    uint8x16_t prev = vdupq_n_u8(0);
+    uint8x16_t error = vdupq_n_u8(0);
+    uint8x16_t incomplete = vdupq_n_u8(0);
+    uint8x16_t input;
+    unsigned char tail[16];
+
+    for (size_t pos = 0; pos < length; pos += 16)
+    {
+        if (length - pos >= 16)
+        {
+            input = vld1q_u8(data + pos);
+        }
+        else
+        {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, data + pos, length - pos);
+            input = vld1q_u8(tail);
+        }
+
+        if (vmaxvq_u8(input) < 0x80)
+        {
+            error = vorrq_u8(error, incomplete);
+        }
+        else
+        {
+            error = vorrq_u8(error, websocket_utf8_check_neon(input, prev, t1, t2, t3));
+            incomplete = vqsubq_u8(input, max_tail);
+        }
+        prev = input;
+    }
+    error = vorrq_u8(error, incomplete);
+
+    return vmaxvq_u8(error) != 0;
+}
+#endif
+
+static int websocket_utf8_resolve(const unsigned char *data, size_t length);
+
+static websocket_utf8_fn websocket_utf8_kernel_fn = websocket_utf8_resolve;
+static websocket_utf8_kernel_t websocket_utf8_kernel_id = WEBSOCKET_UTF8_KERNEL_AUTO;
+
+static const char *websocket_utf8_kernel_names[WEBSOCKET_UTF8_KERNEL_MAX] =
+{
+    "auto", "scalar", "ssse3", "avx2", "neon"
+};
+
+static websocket_utf8_fn websocket_utf8_kernel_lookup(websocket_utf8_kernel_t kernel)
+{
+    websocket_utf8_fn fn = NULL;
+
+    switch (kernel)
+    {
+    case WEBSOCKET_UTF8_KERNEL_SCALAR:
+        fn = websocket_utf8_scalar;
+        break;
+#ifdef WEBSOCKET_UTF8_X86
+    case WEBSOCKET_UTF8_KERNEL_SSSE3:
+        fn = __builtin_cpu_supports("ssse3") ? websocket_utf8_ssse3 : NULL;
+        break;
+    case WEBSOCKET_UTF8_KERNEL_AVX2:
+        fn = __builtin_cpu_supports("avx2") ? websocket_utf8_avx2 : NULL;
+        break;
+#endif
+#ifdef WEBSOCKET_UTF8_NEON
+    case WEBSOCKET_UTF8_KERNEL_NEON:
+        fn = websocket_utf8_neon;
+        break;
+#endif
+    default:
+        break;
+    }
+
+    return fn;
+}
+
+int websocket_utf8_kernel_supported(websocket_utf8_kernel_t kernel)
+{
+    return kernel == WEBSOCKET_UTF8_KERNEL_AUTO || websocket_utf8_kernel_lookup(kernel) != NULL;
+}
+
+int websocket_utf8_kernel_select(websocket_utf8_kernel_t kernel)
+{
+    const websocket_utf8_kernel_t prefer[] =
+    {
+        WEBSOCKET_UTF8_KERNEL_AVX2,
+        WEBSOCKET_UTF8_KERNEL_NEON,
+        WEBSOCKET_UTF8_KERNEL_SSSE3,
+        WEBSOCKET_UTF8_KERNEL_SCALAR
+    };
+    websocket_utf8_fn fn = NULL;
+
+    if (kernel == WEBSOCKET_UTF8_KERNEL_AUTO)
+    {
+        for (size_t i = 0; fn == NULL && i < sizeof(prefer) / sizeof(prefer[0]); i++)
+        {
+            kernel = prefer[i];
+            fn = websocket_utf8_kernel_lookup(kernel);
+        }
+    }
+    else
+    {
+        fn = websocket_utf8_kernel_lookup(kernel);
+    }
+
+    if (fn == NULL)
+    {
+        return -WEBSOCKET_ERROR;
+    }
+
+    websocket_utf8_kernel_id = kernel;
+    websocket_utf8_kernel_fn = fn;
+
+    return WEBSOCKET_OK;
+}
+
+websocket_utf8_kernel_t websocket_utf8_kernel_current(void)
+{
+    if (websocket_utf8_kernel_id == WEBSOCKET_UTF8_KERNEL_AUTO)
+    {
+        websocket_utf8_kernel_select(WEBSOCKET_UTF8_KERNEL_AUTO);
+    }
+
+    return websocket_utf8_kernel_id;
+}
+
+const char *websocket_utf8_kernel_name(websocket_utf8_kernel_t kernel)
+{
+    return (kernel < WEBSOCKET_UTF8_KERNEL_MAX) ? websocket_utf8_kernel_names[kernel] : "unknown";
+}
+
+static int websocket_utf8_resolve(const unsigned char *data, size_t length)
+{
+    websocket_utf8_kernel_select(WEBSOCKET_UTF8_KERNEL_AUTO);
+    return websocket_utf8_kernel_fn(data, length);
+}
+
+/* length of the prefix that ends on a code point boundary, at most three bytes are left over */
+static size_t websocket_utf8_boundary(const unsigned char *data, size_t length)
+{
+    for (size_t i = 1; i <= 3 && i <= length; i++)
+    {
+        unsigned char c = data[length - i];
+
+        if (c < 0x80)
+            return length;
+
+        if (c >= 0xc0)
+        {
+            size_t need = (c >= 0xf0) ? 4 : ((c >= 0xe0) ? 3 : 2);
+            return (need > i) ? length - i : length;
+        }
+    }
+
+    return length;
+}
+
+void websocket_utf8_init(struct websocket_utf8 *utf8)
+{
+    memset(utf8, 0, sizeof(struct websocket_utf8));
+}
+
+int websocket_utf8_update(struct websocket_utf8 *utf8, const void *data, size_t length)
+{
+    const unsigned char *ptr = (const unsigned char *)data;
+    size_t pos = 0, end;
+
+    if (utf8->invalid)
+        return -WEBSOCKET_INVALID_UTF8;
+
+    /* finish a code point carried over from the previous piece */
+    while (utf8->need && pos < length)
+    {
+        if (websocket_utf8_step(utf8, ptr[pos++]) != 0)
+            goto invalid;
+    }
+
+    if (pos == length)
+        return WEBSOCKET_OK;
+
+    /* the bulk goes through the vector kernel, a code point cut by the end is kept in the state */
+    end = pos + websocket_utf8_boundary(ptr + pos, length - pos);
+    if (end > pos && websocket_utf8_kernel_fn(ptr + pos, end - pos) != 0)
+        goto invalid;
+
+    for (pos = end; pos < length; pos++)
+    {
+        if (websocket_utf8_step(utf8, ptr[pos]) != 0)
+            goto invalid;
+    }
+
+    return WEBSOCKET_OK;
+
+invalid:
+    utf8->invalid = 1;
+    return -WEBSOCKET_INVALID_UTF8;
+}
+
+int websocket_utf8_final(struct websocket_utf8 *utf8)
+{
+    return (utf8->invalid || utf8->need) ? -WEBSOCKET_INVALID_UTF8 : WEBSOCKET_OK;
+}
+
+int websocket_utf8_validate(const void *data, size_t length)
+{
+    if (length == 0)
+        return WEBSOCKET_OK;
+
+    return websocket_utf8_kernel_fn((const unsigned char *)data, length) ? -WEBSOCKET_INVALID_UTF8 : WEBSOCKET_OK;
+}
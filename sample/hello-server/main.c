@@ -13,8 +13,10 @@ static void ctrl_c(int s)
 {
     printf("byby!!!\n");
     app_websocket_disconnect_server(&ws);
-    sleep(1);
-    app_websocket_worker_deinit();
+    while (app_websocket_worker_deinit() == -WEBSOCKET_AGAIN)
+    {
+        usleep(10000);
+    }
     exit(0);
 }
 
@@ -80,8 +82,10 @@ int main(int argc, char *argv[])
         if(strcmp(cmdline, "exit") == 0)
         {
             app_websocket_disconnect_server(&ws);
-            sleep(1);
-            app_websocket_worker_deinit();
+            while (app_websocket_worker_deinit() == -WEBSOCKET_AGAIN)
+            {
+                usleep(10000);
+            }
             success = 0;
         }
         else
@@ -0,0 +1,305 @@
+#ifndef __WS_TEST_SERVER_H__
+#define __WS_TEST_SERVER_H__
+
+// 测试用的 websocket 服务器, 监听 127.0.0.1 的随机端口, 每个连接一个线程
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "websocket.h"
+
+struct ws_test_frame
+{
+    int opcode;
+    bool fin;
+    std::string payload;
+};
+
+// 服务器一侧的一个连接
+struct ws_test_peer
+{
+    int fd;
+
+    bool read_exact(void *buf, size_t len)
+    {
+        size_t pos = 0;
+        while (pos < len) {
+            ssize_t n = ::recv(fd, (char *)buf + pos, len - pos, 0);
+            if (n <= 0)
+                return false;
+            pos += n;
+        }
+        return true;
+    }
+
+    bool write_all(const std::string &data)
+    {
+        size_t pos = 0;
+        while (pos < data.size()) {
+            ssize_t n = ::send(fd, data.data() + pos, data.size() - pos, MSG_NOSIGNAL);
+            if (n <= 0)
+                return false;
+            pos += n;
+        }
+        return true;
+    }
+
+    // 读一个客户端帧并去掉掩码
+    bool recv(ws_test_frame &frame)
+    {
+        unsigned char head[14], key[4] = {0};
+        uint64_t length;
+
+        if (!read_exact(head, 2))
+            return false;
+        frame.fin = head[0] & 0x80;
+        frame.opcode = head[0] & 0x0f;
+        length = head[1] & 0x7f;
+        if (length == 126) {
+            if (!read_exact(head + 2, 2))
+                return false;
+            length = (head[2] << 8) | head[3];
+        } else if (length == 127) {
+            if (!read_exact(head + 2, 8))
+                return false;
+            length = 0;
+            for (int i = 0; i < 8; i++)
+                length = (length << 8) | head[2 + i];
+        }
+        if ((head[1] & 0x80) && !read_exact(key, 4))
+            return false;
+        frame.payload.resize(length);
+        if (length && !read_exact(&frame.payload[0], length))
+            return false;
+        for (uint64_t i = 0; i < length; i++)
+            frame.payload[i] ^= key[i % 4];
+        return true;
+    }
+
+    // 读一条完整的消息, 顺便回应 ping; 收到 close 或连接断开时返回 false
+    bool recv_message(int &opcode, std::string &message)
+    {
+        ws_test_frame frame;
+
+        message.clear();
+        while (recv(frame)) {
+            if (frame.opcode == WEBSOCKET_PING_FRAME) {
+                send(WEBSOCKET_PONG_FRAME, frame.payload);
+                continue;
+            }
+            if (frame.opcode == WEBSOCKET_PONG_FRAME)
+                continue;
+            if (frame.opcode == WEBSOCKET_CLOSE_FRAME) {
+                send(WEBSOCKET_CLOSE_FRAME, frame.payload.substr(0, 2));
+                return false;
+            }
+            if (frame.opcode != WEBSOCKET_CONTINUE_FRAME)
+                opcode = frame.opcode;
+            message += frame.payload;
+            if (frame.fin)
+                return true;
+        }
+        return false;
+    }
+
+    static std::string frame(int opcode, const std::string &payload, bool fin = true)
+    {
+        std::string data;
+
+        data += (char)((fin ? 0x80 : 0) | opcode);
+        if (payload.size() < 126) {
+            data += (char)payload.size();
+        } else if (payload.size() < 65536) {
+            data += (char)126;
+            data += (char)(payload.size() >> 8);
+            data += (char)(payload.size() & 0xff);
+        } else {
+            data += (char)127;
+            for (int i = 7; i >= 0; i--)
+                data += (char)((uint64_t)payload.size() >> (i * 8));
+        }
+        return data + payload;
+    }
+
+    bool send(int opcode, const std::string &payload, bool fin = true)
+    {
+        return write_all(frame(opcode, payload, fin));
+    }
+
+    bool close(uint16_t code)
+    {
+        std::string payload;
+        payload += (char)(code >> 8);
+        payload += (char)(code & 0xff);
+        return send(WEBSOCKET_CLOSE_FRAME, payload);
+    }
+
+    bool handshake()
+    {
+        static const char guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+        std::string request, key;
+        unsigned char sha1[20], accept[64];
+        int accept_len = sizeof(accept);
+        char c;
+
+        while (request.find("\r\n\r\n") == std::string::npos) {
+            if (::recv(fd, &c, 1, 0) != 1)
+                return false;
+            request += c;
+        }
+        size_t pos = request.find("Sec-WebSocket-Key: ");
+        if (pos == std::string::npos)
+            return false;
+        pos += strlen("Sec-WebSocket-Key: ");
+        key = request.substr(pos, request.find("\r\n", pos) - pos) + guid;
+        ws_sha1((unsigned char *)&key[0], key.size(), sha1);
+        ws_base64_encode(accept, &accept_len, sha1, sizeof(sha1));
+        return write_all(std::string("HTTP/1.1 101 Switching Protocols\r\n"
+                                     "Upgrade: websocket\r\n"
+                                     "Connection: Upgrade\r\n"
+                                     "Sec-WebSocket-Accept: ") + (const char *)accept + "\r\n\r\n");
+    }
+};
+
+class ws_test_server
+{
+public:
+    typedef std::function<void(ws_test_peer &)> handler_t;
+
+    // 默认的处理函数: 原样回显每条消息
+    static void echo(ws_test_peer &peer)
+    {
+        std::string message;
+        int opcode = 0;
+
+        while (peer.recv_message(opcode, message)) {
+            if (!peer.send(opcode, message))
+                break;
+        }
+    }
+
+    explicit ws_test_server(handler_t handler = echo) : handler_(handler)
+    {
+        start();
+    }
+
+    ~ws_test_server()
+    {
+        stop();
+    }
+
+    std::string url() const
+    {
+        return "ws://127.0.0.1:" + std::to_string(port_) + "/";
+    }
+
+    int port() const
+    {
+        return port_;
+    }
+
+    // 已经完成握手的连接数
+    int accepted() const
+    {
+        return accepted_;
+    }
+
+    // 关闭监听和所有连接, 之后可以在同一个端口上再 start
+    void stop()
+    {
+        if (listen_fd_ < 0)
+            return;
+        ::shutdown(listen_fd_, SHUT_RDWR);
+        acceptor_.join();
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+
+        std::vector<std::thread> threads;
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            for (int fd : fds_)
+                ::shutdown(fd, SHUT_RDWR);
+            threads.swap(threads_);
+        }
+        for (auto &t : threads)
+            t.join();
+    }
+
+    void start()
+    {
+        struct sockaddr_in addr = {};
+        socklen_t len = sizeof(addr);
+        int one = 1;
+
+        listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(port_);
+        ::bind(listen_fd_, (struct sockaddr *)&addr, sizeof(addr));
+        ::listen(listen_fd_, 128);
+        getsockname(listen_fd_, (struct sockaddr *)&addr, &len);
+        port_ = ntohs(addr.sin_port);
+        acceptor_ = std::thread([this] { accept_loop(); });
+    }
+
+private:
+    void accept_loop()
+    {
+        int fd;
+
+        while ((fd = ::accept(listen_fd_, NULL, NULL)) >= 0) {
+            std::lock_guard<std::mutex> guard(lock_);
+            fds_.push_back(fd);
+            threads_.emplace_back([this, fd] {
+                ws_test_peer peer = {fd};
+                if (peer.handshake()) {
+                    accepted_ += 1;
+                    handler_(peer);
+                }
+                std::lock_guard<std::mutex> guard(lock_);
+                for (auto it = fds_.begin(); it != fds_.end(); ++it) {
+                    if (*it == fd) {
+                        fds_.erase(it);
+                        break;
+                    }
+                }
+                ::close(fd);
+            });
+        }
+    }
+
+    handler_t handler_;
+    int listen_fd_ = -1;
+    int port_ = 0;
+    std::atomic<int> accepted_{0};
+    std::mutex lock_;
+    std::vector<int> fds_;
+    std::vector<std::thread> threads_;
+    std::thread acceptor_;
+};
+
+// 等待条件成立, 最多 timeout_ms 毫秒
+static inline bool ws_test_wait(std::function<bool()> pred, int timeout_ms = 5000)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+#endif //__WS_TEST_SERVER_H__
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include "websocket_backoff.h"
+
+// 上限从 base_ms 开始每次翻倍, 到 max_ms 为止
+TEST(backoff, bound_doubles_up_to_max)
+{
+    struct websocket_backoff b = {100, 1000, 0, 0};
+    const uint32_t bounds[] = {100, 200, 400, 800, 1000, 1000};
+
+    for (uint32_t bound : bounds) {
+        EXPECT_EQ(websocket_backoff_bound(&b), bound) << "attempt " << b.attempt;
+        b.attempt += 1;
+    }
+}
+
+// max_ms 为 0 时不封顶, 但移位停在 20 次, 也不会溢出
+TEST(backoff, bound_uncapped)
+{
+    struct websocket_backoff b = {1, 0, 0, 20};
+
+    EXPECT_EQ(websocket_backoff_bound(&b), 1u << 20);
+    b.attempt = 1000;
+    EXPECT_EQ(websocket_backoff_bound(&b), 1u << 20);
+    b.base_ms = UINT32_MAX;
+    EXPECT_EQ(websocket_backoff_bound(&b), UINT32_MAX);
+}
+
+// 抖动落在 [0, bound] 里, 两端都取得到
+TEST(backoff, jitter_range)
+{
+    uint32_t lo = UINT32_MAX, hi = 0;
+
+    for (int i = 0; i < 10000; i++) {
+        uint32_t j = websocket_backoff_jitter(7);
+        ASSERT_LE(j, 7u);
+        lo = j < lo ? j : lo;
+        hi = j > hi ? j : hi;
+    }
+    EXPECT_EQ(lo, 0u);
+    EXPECT_EQ(hi, 7u);
+
+    EXPECT_EQ(websocket_backoff_jitter(0), 0u);
+    for (int i = 0; i < 1000; i++)
+        ASSERT_LE(websocket_backoff_jitter(UINT32_MAX), UINT32_MAX);
+}
+
+// 每次 next 记一次尝试, 延迟不超过这次的上限, 用完之后返回 -1
+TEST(backoff, next_counts_attempts)
+{
+    struct websocket_backoff b = {10, 25, 3, 0};
+    const int64_t bounds[] = {10, 20, 25};
+
+    for (int64_t bound : bounds) {
+        int64_t delay = websocket_backoff_next(&b);
+        EXPECT_GE(delay, 0);
+        EXPECT_LE(delay, bound);
+    }
+    EXPECT_EQ(b.attempt, 3);
+    EXPECT_EQ(websocket_backoff_next(&b), -1);
+    EXPECT_EQ(b.attempt, 3);
+}
+
+// 连上之后清零, 又有 max_attempts 次机会, 上限也回到 base_ms
+TEST(backoff, reset)
+{
+    struct websocket_backoff b = {10, 0, 2, 0};
+
+    websocket_backoff_next(&b);
+    websocket_backoff_next(&b);
+    EXPECT_EQ(websocket_backoff_next(&b), -1);
+
+    websocket_backoff_reset(&b);
+    EXPECT_EQ(websocket_backoff_bound(&b), 10u);
+    EXPECT_LE(websocket_backoff_next(&b), 10);
+    EXPECT_GE(websocket_backoff_next(&b), 0);
+    EXPECT_EQ(websocket_backoff_next(&b), -1);
+}
+
+// base_ms 为 0 不重连, max_attempts 为 0 不限次数
+TEST(backoff, off_and_unlimited)
+{
+    struct websocket_backoff off = {0, 100, 0, 0};
+    struct websocket_backoff unlimited = {1, 4, 0, 0};
+
+    EXPECT_EQ(websocket_backoff_next(&off), -1);
+    for (int i = 0; i < 100; i++)
+        ASSERT_GE(websocket_backoff_next(&unlimited), 0);
+}
+
+// 名额用完后拿不到, 还回一个又能拿到; 调大上限立刻生效
+TEST(backoff, limit_acquire_release)
+{
+    struct websocket_backoff_limit limit = {2, 0};
+
+    EXPECT_EQ(websocket_backoff_acquire(&limit), 1);
+    EXPECT_EQ(websocket_backoff_acquire(&limit), 1);
+    EXPECT_EQ(websocket_backoff_acquire(&limit), 0);
+    EXPECT_EQ(limit.active, 2);
+
+    websocket_backoff_release(&limit);
+    EXPECT_EQ(limit.active, 1);
+    EXPECT_EQ(websocket_backoff_acquire(&limit), 1);
+    EXPECT_EQ(websocket_backoff_acquire(&limit), 0);
+
+    limit.limit = 3;
+    EXPECT_EQ(websocket_backoff_acquire(&limit), 1);
+    for (int i = 0; i < 3; i++)
+        websocket_backoff_release(&limit);
+    EXPECT_EQ(limit.active, 0);
+}
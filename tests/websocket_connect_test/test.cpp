@@ -1,5 +1,100 @@
 #include <gtest/gtest.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "websocket.h"
+#include "ws_test_server.h"
 
 TEST(connect, connect) {
     EXPECT_EQ(1,1);
-}
\ No newline at end of file
+}
+
+// 连上测试服务器, 之后用 getsockopt 读回 socket 上的选项
+struct connected
+{
+    ws_test_server server;
+    struct websocket_session session;
+
+    explicit connected(const struct websocket_socket_options *options)
+    {
+        websocket_session_init(&session);
+        if (options)
+            EXPECT_EQ(websocket_set_socket_options(&session, options), WEBSOCKET_OK);
+        EXPECT_EQ(websocket_connect(&session, server.url().c_str(), NULL), WEBSOCKET_OK);
+    }
+
+    ~connected()
+    {
+        websocket_disconnect(&session);
+        websocket_session_deinit(&session);
+    }
+
+    int get(int level, int name)
+    {
+        int value = -1;
+        socklen_t len = sizeof(value);
+        EXPECT_EQ(getsockopt(session.socket_fd, level, name, &value, &len), 0);
+        return value;
+    }
+
+    long timeout_ms(int name)
+    {
+        struct timeval tv = {};
+        socklen_t len = sizeof(tv);
+        EXPECT_EQ(getsockopt(session.socket_fd, SOL_SOCKET, name, &tv, &len), 0);
+        return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    }
+};
+
+TEST(connect, socket_options_applied) {
+    struct websocket_socket_options options = {};
+
+    options.nodelay = 1;
+    options.sndbuf = 256 << 10;
+    options.rcvbuf = 128 << 10;
+    options.timeout_ms = 1500;
+    connected c(&options);
+    ASSERT_GE(c.session.socket_fd, 0);
+
+    EXPECT_EQ(c.get(IPPROTO_TCP, TCP_NODELAY), 1);
+    // linux 把设置的值翻倍记账, 读回来的不会小于设置的
+    EXPECT_GE(c.get(SOL_SOCKET, SO_SNDBUF), 256 << 10);
+    EXPECT_GE(c.get(SOL_SOCKET, SO_RCVBUF), 128 << 10);
+    EXPECT_EQ(c.timeout_ms(SO_RCVTIMEO), 1500);
+    EXPECT_EQ(c.timeout_ms(SO_SNDTIMEO), 1500);
+}
+
+// 没有设置的选项保持系统默认
+TEST(connect, socket_options_default) {
+    connected c(NULL);
+    ASSERT_GE(c.session.socket_fd, 0);
+
+    EXPECT_EQ(c.get(IPPROTO_TCP, TCP_NODELAY), 0);
+    EXPECT_EQ(c.get(SOL_SOCKET, SO_KEEPALIVE), 0);
+    EXPECT_EQ(c.timeout_ms(SO_RCVTIMEO), 0);
+}
+
+TEST(connect, socket_preset_low_latency) {
+    connected c(&websocket_socket_low_latency);
+    ASSERT_GE(c.session.socket_fd, 0);
+
+    EXPECT_EQ(c.get(IPPROTO_TCP, TCP_NODELAY), 1);
+    EXPECT_EQ(c.get(SOL_SOCKET, SO_KEEPALIVE), 1);
+    EXPECT_EQ(c.get(IPPROTO_TCP, TCP_KEEPIDLE), 30);
+    EXPECT_EQ(c.get(IPPROTO_TCP, TCP_KEEPINTVL), 5);
+    EXPECT_EQ(c.get(IPPROTO_TCP, TCP_KEEPCNT), 3);
+    EXPECT_EQ(c.get(IPPROTO_TCP, TCP_USER_TIMEOUT), 10000);
+}
+
+TEST(connect, socket_preset_bulk_throughput) {
+    connected plain(NULL);
+    connected c(&websocket_socket_bulk_throughput);
+    ASSERT_GE(c.session.socket_fd, 0);
+
+    EXPECT_EQ(c.get(IPPROTO_TCP, TCP_NODELAY), 1);
+    // 4MB 会被 net.core.wmem_max/rmem_max 截断, 只比较是不是比默认的大
+    EXPECT_GT(c.get(SOL_SOCKET, SO_SNDBUF), plain.get(SOL_SOCKET, SO_SNDBUF));
+    EXPECT_GT(c.get(SOL_SOCKET, SO_RCVBUF), plain.get(SOL_SOCKET, SO_RCVBUF));
+    EXPECT_EQ(c.get(IPPROTO_TCP, TCP_KEEPIDLE), 60);
+    EXPECT_EQ(c.get(IPPROTO_TCP, TCP_USER_TIMEOUT), 30000);
+}
@@ -0,0 +1,314 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "websocket.h"
+#include "websocket_parser.h"
+#include "websocket_deflate.h"
+
+#ifdef WEBSOCKET_USING_DEFLATE
+#include <zlib.h>
+
+struct wire_frame
+{
+    int opcode;
+    bool fin;
+    bool rsv1;
+    std::string payload;
+};
+
+// 用 socketpair 代替服务器, 手动完成 permessage-deflate 协商
+struct deflate_wire
+{
+    int fd[2];
+    struct websocket_session session;
+
+    deflate_wire(const char *answer = "permessage-deflate", int no_context_takeover = 0)
+    {
+        struct websocket_deflate_options opt = {};
+        int size = 4 << 20;
+
+        socketpair(AF_UNIX, SOCK_STREAM, 0, fd);
+        setsockopt(fd[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+        setsockopt(fd[1], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+        websocket_session_init(&session);
+        opt.enable = 1;
+        opt.client_no_context_takeover = no_context_takeover;
+        websocket_set_deflate(&session, &opt);
+        session.socket_fd = fd[0];
+        session.cache_len = 4096;
+        session.cache = (char *)malloc(session.cache_len);
+        session.recv_buf_len = 4096;
+        session.recv_buf = (char *)malloc(session.recv_buf_len + 1);
+        session.parser = (struct websocket_parser *)malloc(sizeof(struct websocket_parser));
+        websocket_parser_init(session.parser);
+        EXPECT_EQ(websocket_deflate_accept(&session, answer), WEBSOCKET_OK);
+    }
+
+    ~deflate_wire()
+    {
+        websocket_disconnect(&session);
+        websocket_session_deinit(&session);
+        close(fd[1]);
+    }
+
+    void read_exact(void *buf, size_t len)
+    {
+        size_t pos = 0;
+        while (pos < len) {
+            ssize_t n = read(fd[1], (char *)buf + pos, len - pos);
+            ASSERT_GT(n, 0);
+            pos += n;
+        }
+    }
+
+    // 解析一个客户端帧(带掩码)
+    wire_frame next()
+    {
+        unsigned char head[14], key[4];
+        wire_frame frame;
+        uint64_t length;
+
+        read_exact(head, 2);
+        frame.fin = head[0] & 0x80;
+        frame.rsv1 = head[0] & 0x40;
+        frame.opcode = head[0] & 0x0f;
+        length = head[1] & 0x7f;
+        if (length == 126) {
+            read_exact(head + 2, 2);
+            length = (head[2] << 8) | head[3];
+        } else if (length == 127) {
+            read_exact(head + 2, 8);
+            length = 0;
+            for (int i = 0; i < 8; i++)
+                length = (length << 8) | head[2 + i];
+        }
+        read_exact(key, 4);
+        frame.payload.resize(length);
+        read_exact(&frame.payload[0], length);
+        for (uint64_t i = 0; i < length; i++)
+            frame.payload[i] ^= key[i % 4];
+        return frame;
+    }
+
+    // 读完一条消息的所有帧
+    std::vector<wire_frame> message()
+    {
+        std::vector<wire_frame> frames;
+        do {
+            frames.push_back(next());
+        } while (!frames.back().fin);
+        return frames;
+    }
+
+    // 以服务器身份发送一个不带掩码的帧
+    void send_frame(int opcode, bool fin, bool rsv1, const std::string &payload)
+    {
+        std::string frame;
+        frame += (char)((fin ? 0x80 : 0) | (rsv1 ? 0x40 : 0) | opcode);
+        if (payload.size() < 126) {
+            frame += (char)payload.size();
+        } else {
+            frame += (char)126;
+            frame += (char)(payload.size() >> 8);
+            frame += (char)(payload.size() & 0xff);
+        }
+        frame += payload;
+        ASSERT_EQ(write(fd[1], frame.data(), frame.size()), (ssize_t)frame.size());
+    }
+
+    std::string read_message(size_t length)
+    {
+        std::string data(length, '\0');
+        size_t pos = 0;
+        while (pos < length) {
+            int n = websocket_read(&session, &data[pos], length - pos);
+            EXPECT_GT(n, 0);
+            if (n <= 0)
+                break;
+            pos += n;
+        }
+        return data;
+    }
+};
+
+// 对端的解压器, 默认保留上下文
+struct peer_inflate
+{
+    z_stream strm = {};
+
+    peer_inflate() { inflateInit2(&strm, -15); }
+    ~peer_inflate() { inflateEnd(&strm); }
+
+    std::string operator()(std::string data)
+    {
+        std::string out;
+        char buf[16384];
+
+        data.append("\x00\x00\xff\xff", 4);
+        strm.next_in = (Bytef *)&data[0];
+        strm.avail_in = data.size();
+        do {
+            strm.next_out = (Bytef *)buf;
+            strm.avail_out = sizeof(buf);
+            int res = inflate(&strm, Z_SYNC_FLUSH);
+            EXPECT_TRUE(res == Z_OK || res == Z_BUF_ERROR);
+            out.append(buf, sizeof(buf) - strm.avail_out);
+        } while (strm.avail_in || strm.avail_out == 0);
+        return out;
+    }
+};
+
+// 对端的压缩器, 默认保留上下文
+struct peer_deflate
+{
+    z_stream strm = {};
+
+    peer_deflate() { deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY); }
+    ~peer_deflate() { deflateEnd(&strm); }
+
+    std::string operator()(const std::string &data)
+    {
+        std::string out(deflateBound(&strm, data.size()) + 16, '\0');
+        strm.next_in = (Bytef *)data.data();
+        strm.avail_in = data.size();
+        strm.next_out = (Bytef *)&out[0];
+        strm.avail_out = out.size();
+        deflate(&strm, Z_SYNC_FLUSH);
+        out.resize(out.size() - strm.avail_out - 4);
+        return out;
+    }
+};
+
+static std::string sample(size_t length)
+{
+    std::string data;
+    while (data.size() < length)
+        data += "{\"px\":101.25,\"qty\":300,\"sym\":\"ABC\",\"seq\":" + std::to_string(data.size()) + "}";
+    data.resize(length);
+    return data;
+}
+
+static std::string noise(size_t length)
+{
+    std::string data(length, '\0');
+    uint32_t x = 2463534242u;
+    for (auto &c : data) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        c = (char)x;
+    }
+    return data;
+}
+
+static std::string join(const std::vector<wire_frame> &frames)
+{
+    std::string payload;
+    for (auto &f : frames)
+        payload += f.payload;
+    return payload;
+}
+
+// 压缩后的消息可以被对端解压, RSV1 只出现在第一帧
+TEST(deflate, round_trip) {
+    deflate_wire w;
+    peer_inflate inflate;
+    std::string msg = sample(5000);
+
+    ASSERT_EQ(websocket_write(&w.session, msg.data(), msg.size(), WEBSOCKET_TEXT_FRAME), (int)msg.size());
+    auto frames = w.message();
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_TRUE(frames[0].rsv1);
+    EXPECT_EQ(frames[0].opcode, WEBSOCKET_TEXT_FRAME);
+    EXPECT_LT(frames[0].payload.size(), msg.size());
+    EXPECT_EQ(inflate(frames[0].payload), msg);
+}
+
+// 不可压缩的大消息按固定大小的块发出, 内存不随消息增长
+TEST(deflate, large_message_in_bounded_chunks) {
+    deflate_wire w;
+    peer_inflate inflate;
+    std::string msg = noise(1 << 20);
+
+    int write_res = 0;
+
+    // 消息比 socket 缓冲区大, 边写边读
+    std::thread writer([&] { write_res = websocket_write(&w.session, msg.data(), msg.size(), WEBSOCKET_BIN_FRAME); });
+    auto frames = w.message();
+    writer.join();
+    ASSERT_EQ(write_res, (int)msg.size());
+    ASSERT_GT(frames.size(), 1u);
+    for (size_t i = 0; i < frames.size(); i++) {
+        EXPECT_LE(frames[i].payload.size(), (size_t)WEBSOCKET_DEFLATE_OUT_SIZE);
+        EXPECT_EQ(frames[i].rsv1, i == 0);
+        EXPECT_EQ(frames[i].opcode, i == 0 ? WEBSOCKET_BIN_FRAME : WEBSOCKET_CONTINUE_FRAME);
+    }
+    EXPECT_EQ(inflate(join(frames)), msg);
+}
+
+// 保留上下文时第二条相同消息引用前一条, 压缩后更小
+TEST(deflate, context_takeover) {
+    deflate_wire w;
+    peer_inflate inflate;
+    std::string msg = noise(2000);
+
+    ASSERT_EQ(websocket_write(&w.session, msg.data(), msg.size(), WEBSOCKET_BIN_FRAME), (int)msg.size());
+    ASSERT_EQ(websocket_write(&w.session, msg.data(), msg.size(), WEBSOCKET_BIN_FRAME), (int)msg.size());
+    std::string first = join(w.message()), second = join(w.message());
+    EXPECT_LT(second.size(), first.size() / 4);
+    EXPECT_EQ(inflate(first), msg);
+    EXPECT_EQ(inflate(second), msg);
+}
+
+// client_no_context_takeover 时每条消息独立压缩
+TEST(deflate, no_context_takeover) {
+    deflate_wire w("permessage-deflate; client_no_context_takeover", 1);
+    std::string msg = noise(2000);
+
+    ASSERT_EQ(websocket_write(&w.session, msg.data(), msg.size(), WEBSOCKET_BIN_FRAME), (int)msg.size());
+    ASSERT_EQ(websocket_write(&w.session, msg.data(), msg.size(), WEBSOCKET_BIN_FRAME), (int)msg.size());
+    std::string first = join(w.message()), second = join(w.message());
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(peer_inflate()(first), msg);
+    EXPECT_EQ(peer_inflate()(second), msg);
+}
+
+// 分片写入的消息是一个压缩流, RSV1 只在第一帧
+TEST(deflate, slices_form_one_stream) {
+    deflate_wire w;
+    peer_inflate inflate;
+    std::string a = sample(3000), b = sample(40000), c = sample(10);
+
+    ASSERT_EQ(websocket_write_slice(&w.session, a.data(), a.size(), WEBSOCKET_TEXT_FRAME, WEBSOCKET_WRITE_FIRST_SLICE), (int)a.size());
+    ASSERT_EQ(websocket_write_slice(&w.session, b.data(), b.size(), WEBSOCKET_TEXT_FRAME, WEBSOCKET_WRITE_MIDDLE_SLICE), (int)b.size());
+    ASSERT_EQ(websocket_write_slice(&w.session, c.data(), c.size(), WEBSOCKET_TEXT_FRAME, WEBSOCKET_WRITE_END_SLICE), (int)c.size());
+    auto frames = w.message();
+    ASSERT_GE(frames.size(), 3u);
+    for (size_t i = 0; i < frames.size(); i++) {
+        EXPECT_EQ(frames[i].rsv1, i == 0);
+        EXPECT_EQ(frames[i].opcode, i == 0 ? WEBSOCKET_TEXT_FRAME : WEBSOCKET_CONTINUE_FRAME);
+    }
+    EXPECT_EQ(inflate(join(frames)), a + b + c);
+}
+
+// 服务器发来的压缩消息, 分成两帧且保留上下文
+TEST(deflate, inflate_fragmented_with_context) {
+    deflate_wire w;
+    peer_deflate deflate;
+    std::string msg = sample(6000);
+    std::string first = deflate(msg), second = deflate(msg);
+
+    w.send_frame(WEBSOCKET_TEXT_FRAME, false, true, first.substr(0, first.size() / 2));
+    w.send_frame(WEBSOCKET_CONTINUE_FRAME, true, false, first.substr(first.size() / 2));
+    EXPECT_EQ(w.read_message(msg.size()), msg);
+
+    // 第二条只靠上一条的上下文才能解开
+    EXPECT_LT(second.size(), first.size());
+    w.send_frame(WEBSOCKET_TEXT_FRAME, true, true, second);
+    EXPECT_EQ(w.read_message(msg.size()), msg);
+}
+
+#endif
@@ -0,0 +1,32 @@
+#include <benchmark/benchmark.h>
+#include <vector>
+#include "websocket_mask.h"
+
+// 每个 kernel 的吞吐量, 输出中的 bytes_per_second 即为 GB/s
+static void bench_mask_kernel(benchmark::State& state, websocket_mask_kernel_t kernel)
+{
+    const unsigned char key[4] = {0x12, 0x34, 0x56, 0x78};
+    std::vector<unsigned char> src(state.range(0) + 1, 0x5a);
+    std::vector<unsigned char> dst(state.range(0) + 1);
+
+    if (websocket_mask_kernel_select(kernel) != 0)
+    {
+        state.SkipWithError("kernel not supported on this cpu");
+        return;
+    }
+
+    for (auto _: state) {
+        // 源和目的都错开一个字节, 模拟未对齐的 payload
+        websocket_mask(dst.data() + 1, src.data() + 1, state.range(0), key, 1);
+        benchmark::DoNotOptimize(dst.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(0));
+    state.SetLabel(websocket_mask_kernel_name(kernel));
+    websocket_mask_kernel_select(WEBSOCKET_MASK_KERNEL_AUTO);
+}
+BENCHMARK_CAPTURE(bench_mask_kernel, scalar, WEBSOCKET_MASK_KERNEL_SCALAR)->Arg(4 << 10)->Arg(1 << 20);
+BENCHMARK_CAPTURE(bench_mask_kernel, sse2, WEBSOCKET_MASK_KERNEL_SSE2)->Arg(4 << 10)->Arg(1 << 20);
+BENCHMARK_CAPTURE(bench_mask_kernel, avx2, WEBSOCKET_MASK_KERNEL_AVX2)->Arg(4 << 10)->Arg(1 << 20);
+BENCHMARK_CAPTURE(bench_mask_kernel, avx512, WEBSOCKET_MASK_KERNEL_AVX512)->Arg(4 << 10)->Arg(1 << 20);
+BENCHMARK_CAPTURE(bench_mask_kernel, neon, WEBSOCKET_MASK_KERNEL_NEON)->Arg(4 << 10)->Arg(1 << 20);
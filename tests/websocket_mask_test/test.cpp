@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "websocket_mask.h"
+
+static void reference_mask(unsigned char *dst, const unsigned char *src, size_t len, const unsigned char key[4], size_t offset)
+{
+    for (size_t i = 0; i < len; i++)
+        dst[i] = src[i] ^ key[(offset + i) % 4];
+}
+
+TEST(mask, kernels_match_reference) {
+    const unsigned char key[4] = {0xde, 0xad, 0xbe, 0xef};
+    std::vector<unsigned char> src(600), expect(600), out(600);
+    for (size_t i = 0; i < src.size(); i++)
+        src[i] = (unsigned char)(i * 7 + 3);
+
+    for (int k = WEBSOCKET_MASK_KERNEL_SCALAR; k < WEBSOCKET_MASK_KERNEL_MAX; k++) {
+        websocket_mask_kernel_t kernel = (websocket_mask_kernel_t)k;
+        if (!websocket_mask_kernel_supported(kernel))
+            continue;
+        ASSERT_EQ(websocket_mask_kernel_select(kernel), 0);
+        for (size_t align = 0; align < 8; align++) {
+            for (size_t len : {0, 1, 3, 4, 15, 16, 31, 33, 63, 64, 65, 127, 255, 257, 511}) {
+                for (size_t offset = 0; offset < 4; offset++) {
+                    reference_mask(expect.data(), src.data() + align, len, key, offset);
+                    EXPECT_EQ(websocket_mask(out.data() + (7 - align), src.data() + align, len, key, offset), (offset + len) % 4);
+                    EXPECT_EQ(0, memcmp(expect.data(), out.data() + (7 - align), len)) << websocket_mask_kernel_name(kernel)
+                        << " align " << align << " len " << len << " offset " << offset;
+                }
+            }
+        }
+    }
+    websocket_mask_kernel_select(WEBSOCKET_MASK_KERNEL_AUTO);
+}
+
+TEST(mask, chunked_phase_carry) {
+    const unsigned char key[4] = {1, 2, 3, 4};
+    std::vector<unsigned char> src(1000, 0xaa), expect(1000), out(1000);
+    size_t phase = 0, pos = 0;
+
+    reference_mask(expect.data(), src.data(), src.size(), key, 0);
+    for (size_t chunk : {7, 13, 100, 1, 379, 500}) {
+        phase = websocket_mask(out.data() + pos, src.data() + pos, chunk, key, phase);
+        pos += chunk;
+    }
+    EXPECT_EQ(0, memcmp(expect.data(), out.data(), src.size()));
+}
+
+TEST(mask, in_place) {
+    const unsigned char key[4] = {9, 8, 7, 6};
+    std::vector<unsigned char> buf(300, 0x11), expect(300);
+
+    reference_mask(expect.data(), buf.data(), buf.size(), key, 2);
+    websocket_mask(buf.data(), buf.data(), buf.size(), key, 2);
+    EXPECT_EQ(0, memcmp(expect.data(), buf.data(), buf.size()));
+    EXPECT_NE(websocket_mask_kernel_current(), WEBSOCKET_MASK_KERNEL_AUTO);
+}
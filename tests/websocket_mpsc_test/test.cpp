@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include "websocket_list.h"
+#include "websocket_mpsc.h"
+
+struct item
+{
+    ws_mpsc_node_t node;
+    int producer;
+    int seq;
+};
+
+static item *pop(ws_mpsc_t *q)
+{
+    ws_mpsc_node_t *node = ws_mpsc_pop(q);
+    return node ? ws_container_of(node, item, node) : nullptr;
+}
+
+TEST(mpsc, empty)
+{
+    ws_mpsc_t q;
+
+    ws_mpsc_init(&q);
+    EXPECT_TRUE(ws_mpsc_empty(&q));
+    EXPECT_EQ(pop(&q), nullptr);
+    EXPECT_TRUE(ws_mpsc_empty(&q));
+}
+
+TEST(mpsc, fifo)
+{
+    ws_mpsc_t q;
+    std::vector<item> items(8);
+
+    ws_mpsc_init(&q);
+    for (int i = 0; i < 8; i++) {
+        items[i].seq = i;
+        ws_mpsc_push(&q, &items[i].node);
+    }
+    EXPECT_FALSE(ws_mpsc_empty(&q));
+    for (int i = 0; i < 8; i++) {
+        item *it = pop(&q);
+        ASSERT_NE(it, nullptr);
+        EXPECT_EQ(it->seq, i);
+    }
+    EXPECT_EQ(pop(&q), nullptr);
+    EXPECT_TRUE(ws_mpsc_empty(&q));
+}
+
+// 取到只剩最后一个节点时要把 stub 重新挂回去, 交替 push/pop 每次都走这条路径
+TEST(mpsc, last_node_goes_through_stub)
+{
+    ws_mpsc_t q;
+    item a = {}, b = {};
+
+    ws_mpsc_init(&q);
+    for (int i = 0; i < 1000; i++) {
+        item *it = (i & 1) ? &b : &a;
+        it->seq = i;
+        ws_mpsc_push(&q, &it->node);
+        item *out = pop(&q);
+        ASSERT_EQ(out, it);
+        EXPECT_EQ(out->seq, i);
+        EXPECT_EQ(pop(&q), nullptr);
+        EXPECT_TRUE(ws_mpsc_empty(&q));
+    }
+}
+
+// 节点出队后可以马上再入队, 会话的 cmd_node 就是这样反复使用的
+TEST(mpsc, node_reused_after_pop)
+{
+    ws_mpsc_t q;
+    item a = {}, b = {};
+
+    ws_mpsc_init(&q);
+    ws_mpsc_push(&q, &a.node);
+    ws_mpsc_push(&q, &b.node);
+    ASSERT_EQ(pop(&q), &a);
+    ws_mpsc_push(&q, &a.node);
+    ASSERT_EQ(pop(&q), &b);
+    ASSERT_EQ(pop(&q), &a);
+    EXPECT_EQ(pop(&q), nullptr);
+    EXPECT_TRUE(ws_mpsc_empty(&q));
+}
+
+// 多个生产者同时入队, 消费者同时出队: 一个不丢, 每个生产者自己的顺序不变
+TEST(mpsc, producers_keep_their_order)
+{
+    const int producers = 4, per_producer = 100000;
+    ws_mpsc_t q;
+    std::vector<std::vector<item>> items(producers, std::vector<item>(per_producer));
+    std::vector<int> next(producers, 0);
+    std::vector<std::thread> threads;
+    int received = 0;
+
+    ws_mpsc_init(&q);
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&items, &q, p] {
+            for (int i = 0; i < per_producer; i++) {
+                items[p][i].producer = p;
+                items[p][i].seq = i;
+                ws_mpsc_push(&q, &items[p][i].node);
+            }
+        });
+    }
+
+    while (received < producers * per_producer) {
+        item *it = pop(&q);
+        if (it == nullptr) {
+            // 队列空, 或者有生产者入队到一半, 两种情况都只能等
+            std::this_thread::yield();
+            continue;
+        }
+        EXPECT_EQ(it->seq, next[it->producer]) << "producer " << it->producer;
+        next[it->producer] += 1;
+        received += 1;
+    }
+    for (auto &t : threads)
+        t.join();
+
+    for (int p = 0; p < producers; p++)
+        EXPECT_EQ(next[p], per_producer);
+    EXPECT_EQ(pop(&q), nullptr);
+    EXPECT_TRUE(ws_mpsc_empty(&q));
+}
@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "websocket_parser.h"
+
+struct frame_event
+{
+    std::vector<std::string> frames;
+    std::string payload;
+    int heads = 0;
+    int pause_on_end = 0;
+};
+
+static int on_head(struct websocket_parser *, void *ctx)
+{
+    static_cast<frame_event *>(ctx)->heads++;
+    return 0;
+}
+
+static int on_data(struct websocket_parser *, void *ctx, const char *data, size_t length)
+{
+    static_cast<frame_event *>(ctx)->payload.append(data, length);
+    return 0;
+}
+
+static int on_end(struct websocket_parser *parser, void *ctx)
+{
+    frame_event *ev = static_cast<frame_event *>(ctx);
+    if (!websocket_parser_is_control(parser->info.frame_type) && !parser->in_message)
+    {
+        ev->frames.push_back(ev->payload);
+        ev->payload.clear();
+        return ev->pause_on_end;
+    }
+    return 0;
+}
+
+static const struct websocket_parser_callback cb = { on_head, on_data, on_end };
+
+static std::string server_frame(int opcode, const std::string &payload, bool fin = true)
+{
+    std::string frame;
+    frame += (char)((fin ? 0x80 : 0) | opcode);
+    if (payload.size() < 126) {
+        frame += (char)payload.size();
+    } else if (payload.size() <= 0xffff) {
+        frame += (char)126;
+        frame += (char)(payload.size() >> 8);
+        frame += (char)payload.size();
+    } else {
+        frame += (char)127;
+        for (int i = 7; i >= 0; i--)
+            frame += (char)((uint64_t)payload.size() >> (8 * i));
+    }
+    return frame + payload;
+}
+
+TEST(parser, byte_by_byte) {
+    struct websocket_parser parser;
+    frame_event ev;
+    std::string big(70000, 'b');
+    std::string stream = server_frame(WEBSOCKET_TEXT_FRAME, "hello") + server_frame(WEBSOCKET_BIN_FRAME, big)
+                       + server_frame(WEBSOCKET_TEXT_FRAME, std::string(300, 'm'));
+
+    websocket_parser_init(&parser);
+    for (char c : stream)
+        ASSERT_EQ(websocket_parser_execute(&parser, &cb, &ev, &c, 1), 1);
+
+    ASSERT_EQ(ev.frames.size(), 3u);
+    EXPECT_EQ(ev.frames[0], "hello");
+    EXPECT_EQ(ev.frames[1], big);
+    EXPECT_EQ(ev.frames[2], std::string(300, 'm'));
+    EXPECT_EQ(parser.state, WEBSOCKET_PARSER_HEAD);
+}
+
+TEST(parser, fragments_with_interleaved_ping) {
+    struct websocket_parser parser;
+    frame_event ev;
+    std::string stream = server_frame(WEBSOCKET_TEXT_FRAME, "hel", false) + server_frame(WEBSOCKET_PING_FRAME, "")
+                       + server_frame(WEBSOCKET_CONTINUE_FRAME, "lo", false) + server_frame(WEBSOCKET_CONTINUE_FRAME, "!");
+
+    websocket_parser_init(&parser);
+    ASSERT_EQ(websocket_parser_execute(&parser, &cb, &ev, stream.data(), stream.size()), (int)stream.size());
+    ASSERT_EQ(ev.frames.size(), 1u);
+    EXPECT_EQ(ev.frames[0], "hello!");
+    EXPECT_EQ(ev.heads, 4);
+    EXPECT_EQ(parser.message_type, WEBSOCKET_TEXT_FRAME);
+}
+
+TEST(parser, pause_and_resume) {
+    struct websocket_parser parser;
+    frame_event ev;
+    std::string first = server_frame(WEBSOCKET_TEXT_FRAME, "one");
+    std::string stream = first + server_frame(WEBSOCKET_TEXT_FRAME, "two");
+
+    ev.pause_on_end = 1;
+    websocket_parser_init(&parser);
+    ASSERT_EQ(websocket_parser_execute(&parser, &cb, &ev, stream.data(), stream.size()), (int)first.size());
+    ASSERT_EQ(ev.frames.size(), 1u);
+    ASSERT_EQ(websocket_parser_execute(&parser, &cb, &ev, stream.data() + first.size(), stream.size() - first.size()), (int)(stream.size() - first.size()));
+    ASSERT_EQ(ev.frames.size(), 2u);
+    EXPECT_EQ(ev.frames[1], "two");
+}
+
+TEST(parser, protocol_errors) {
+    struct websocket_parser parser;
+    frame_event ev;
+    const char masked[] = { (char)0x81, (char)0x81, 1, 2, 3, 4, 'x' };
+    const char fragmented_ping[] = { (char)0x09, 0x00 };
+    const char orphan_continue[] = { (char)0x80, 0x00 };
+    const char rsv_set[] = { (char)0xc1, 0x00 };
+
+    websocket_parser_init(&parser);
+    EXPECT_LT(websocket_parser_execute(&parser, &cb, &ev, masked, sizeof(masked)), 0);
+    websocket_parser_init(&parser);
+    EXPECT_LT(websocket_parser_execute(&parser, &cb, &ev, fragmented_ping, sizeof(fragmented_ping)), 0);
+    websocket_parser_init(&parser);
+    EXPECT_LT(websocket_parser_execute(&parser, &cb, &ev, orphan_continue, sizeof(orphan_continue)), 0);
+    websocket_parser_init(&parser);
+    EXPECT_LT(websocket_parser_execute(&parser, &cb, &ev, rsv_set, sizeof(rsv_set)), 0);
+}
+
+TEST(parser, rsv1_on_first_frame_only) {
+    struct websocket_parser parser;
+    frame_event ev;
+    std::string first = server_frame(0x1, "ab", false);
+    std::string stream;
+
+    first[0] |= 0x40;
+    stream = first + server_frame(0x0, "cd");
+    websocket_parser_init(&parser);
+    parser.rsv_allowed = 0x04;
+    ASSERT_EQ(websocket_parser_execute(&parser, &cb, &ev, stream.data(), stream.size()), (int)stream.size());
+    ASSERT_EQ(ev.frames.size(), 1u);
+    EXPECT_EQ(parser.message_rsv, 0x04);
+
+    /* a compressed continuation or control frame is a protocol error */
+    std::string bad_continue = server_frame(0x1, "ab", false) + server_frame(0x0, "cd");
+    bad_continue[4] |= 0x40;
+    websocket_parser_init(&parser);
+    parser.rsv_allowed = 0x04;
+    EXPECT_LT(websocket_parser_execute(&parser, &cb, &ev, bad_continue.data(), bad_continue.size()), 0);
+
+    std::string bad_ping = server_frame(0x9, "");
+    bad_ping[0] |= 0x40;
+    websocket_parser_init(&parser);
+    parser.rsv_allowed = 0x04;
+    EXPECT_LT(websocket_parser_execute(&parser, &cb, &ev, bad_ping.data(), bad_ping.size()), 0);
+}
@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "websocket.h"
+#include "websocket_parser.h"
+
+// 用 socketpair 代替服务器, 客户端一端不阻塞, 没有数据时 peek 立即返回
+struct peek_wire
+{
+    int fd[2];
+    struct websocket_session session;
+
+    peek_wire()
+    {
+        socketpair(AF_UNIX, SOCK_STREAM, 0, fd);
+        fcntl(fd[0], F_SETFL, fcntl(fd[0], F_GETFL) | O_NONBLOCK);
+        websocket_session_init(&session);
+        session.socket_fd = fd[0];
+        session.cache_len = 4096;
+        session.cache = (char *)malloc(session.cache_len);
+        session.recv_buf_len = 4096;
+        session.recv_buf = (char *)malloc(session.recv_buf_len + 1);
+        session.parser = (struct websocket_parser *)malloc(sizeof(struct websocket_parser));
+        websocket_parser_init(session.parser);
+    }
+
+    ~peek_wire()
+    {
+        websocket_disconnect(&session);
+        websocket_session_deinit(&session);
+        close(fd[1]);
+    }
+
+    // 以服务器身份编码一个不带掩码的帧
+    static std::string frame(int opcode, const std::string &payload, bool fin = true)
+    {
+        std::string frame;
+        frame += (char)((fin ? 0x80 : 0) | opcode);
+        if (payload.size() < 126) {
+            frame += (char)payload.size();
+        } else {
+            frame += (char)126;
+            frame += (char)(payload.size() >> 8);
+            frame += (char)(payload.size() & 0xff);
+        }
+        return frame + payload;
+    }
+
+    void send(const std::string &bytes)
+    {
+        ASSERT_EQ(write(fd[1], bytes.data(), bytes.size()), (ssize_t)bytes.size());
+    }
+
+    // 返回 peek 看到的数据, 出错时返回 "<error>"
+    std::string peek()
+    {
+        const void *data = NULL;
+        size_t length = 0;
+        int n = websocket_peek(&session, &data, &length);
+
+        if (n < 0)
+            return "<error>";
+        EXPECT_EQ((size_t)n, length);
+        return std::string((const char *)data, length);
+    }
+};
+
+// 帧头不完整或者只有帧头时没有数据可看, 剩下的字节到了之后接着解析
+TEST(peek, partial_frame_returns_no_data) {
+    peek_wire w;
+    std::string f = peek_wire::frame(WEBSOCKET_TEXT_FRAME, "hello");
+
+    EXPECT_EQ(w.peek(), "<error>");
+    w.send(f.substr(0, 1));
+    EXPECT_EQ(w.peek(), "<error>");
+    w.send(f.substr(1, 1));
+    EXPECT_EQ(w.peek(), "<error>");
+    EXPECT_EQ(w.session.info.frame_type, WEBSOCKET_TEXT_FRAME);
+    EXPECT_EQ(w.session.info.remain_len, 5u);
+
+    w.send(f.substr(2));
+    EXPECT_EQ(w.peek(), "hello");
+    EXPECT_EQ(websocket_consume(&w.session, 5), 5);
+    EXPECT_EQ(w.session.info.remain_len, 0u);
+}
+
+// 一个帧分两次到达: 先看到已到的部分, 消费之后再看到剩下的
+TEST(peek, frame_split_across_fills) {
+    peek_wire w;
+    std::string payload(300, 'x');
+    std::string f;
+
+    for (size_t i = 0; i < payload.size(); i++)
+        payload[i] = (char)('a' + i % 26);
+    f = peek_wire::frame(WEBSOCKET_BIN_FRAME, payload);
+    w.send(f.substr(0, 4 + 100));
+    EXPECT_EQ(w.peek(), payload.substr(0, 100));
+    // 没有消费时再看一次还是同样的数据
+    EXPECT_EQ(w.peek(), payload.substr(0, 100));
+    EXPECT_EQ(websocket_consume(&w.session, 100), 100);
+
+    w.send(f.substr(4 + 100));
+    EXPECT_EQ(w.peek(), payload.substr(100));
+    EXPECT_EQ(websocket_consume(&w.session, 200), 200);
+    EXPECT_EQ(w.session.info.remain_len, 0u);
+}
+
+// 一次读到几个帧, peek 只看到当前帧, 逐个消费; 中间的 ping 被跳过
+TEST(peek, frames_in_one_fill) {
+    peek_wire w;
+
+    w.send(peek_wire::frame(WEBSOCKET_TEXT_FRAME, "one") + peek_wire::frame(WEBSOCKET_PING_FRAME, "p") +
+           peek_wire::frame(WEBSOCKET_TEXT_FRAME, "two") + peek_wire::frame(WEBSOCKET_BIN_FRAME, "three"));
+
+    EXPECT_EQ(w.peek(), "one");
+    EXPECT_EQ(websocket_consume(&w.session, 3), 3);
+    EXPECT_EQ(w.peek(), "two");
+    EXPECT_EQ(w.session.info.frame_type, WEBSOCKET_TEXT_FRAME);
+    EXPECT_EQ(websocket_consume(&w.session, 3), 3);
+    EXPECT_EQ(w.peek(), "three");
+    EXPECT_EQ(w.session.info.frame_type, WEBSOCKET_BIN_FRAME);
+    EXPECT_EQ(websocket_consume(&w.session, 5), 5);
+    EXPECT_EQ(w.peek(), "<error>");
+}
+
+// 消费的字节不能多于 peek 看到的, 被拒绝后状态不变
+TEST(peek, consume_more_than_peeked) {
+    peek_wire w;
+    std::string f = peek_wire::frame(WEBSOCKET_TEXT_FRAME, "abcdef");
+
+    // 帧里的字节还没有到齐
+    w.send(f.substr(0, 2 + 3));
+    EXPECT_EQ(w.peek(), "abc");
+    EXPECT_LT(websocket_consume(&w.session, 4), 0);
+    EXPECT_EQ(w.peek(), "abc");
+
+    // 到齐了也不能越过帧的边界
+    w.send(f.substr(2 + 3) + peek_wire::frame(WEBSOCKET_TEXT_FRAME, "next"));
+    EXPECT_EQ(websocket_consume(&w.session, 3), 3);
+    EXPECT_EQ(w.peek(), "def");
+    EXPECT_LT(websocket_consume(&w.session, 4), 0);
+    EXPECT_EQ(websocket_consume(&w.session, 3), 3);
+    EXPECT_EQ(w.peek(), "next");
+}
+
+// 消费一部分后再看, 看到的是剩下的部分; 整帧消费完看到的是下一帧
+TEST(peek, peek_after_consume) {
+    peek_wire w;
+
+    w.send(peek_wire::frame(WEBSOCKET_TEXT_FRAME, "first frame") + peek_wire::frame(WEBSOCKET_TEXT_FRAME, "second"));
+    EXPECT_EQ(w.peek(), "first frame");
+    EXPECT_EQ(websocket_consume(&w.session, 6), 6);
+    EXPECT_EQ(w.peek(), "frame");
+    EXPECT_EQ(websocket_consume(&w.session, 5), 5);
+    EXPECT_EQ(w.peek(), "second");
+    EXPECT_EQ(websocket_consume(&w.session, 0), 0);
+    EXPECT_EQ(w.peek(), "second");
+}
@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <vector>
+#include "websocket_pool.h"
+
+class pool : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        websocket_pool_init(&p, 4);
+    }
+
+    void TearDown() override
+    {
+        EXPECT_EQ(p.borrowed, 0);
+        websocket_pool_clear(&p);
+    }
+
+    struct websocket_pool p;
+};
+
+// 请求向上取整到 2 的幂, 最小一档是 256 字节
+TEST_F(pool, size_classes)
+{
+    const size_t sizes[][2] = {
+        {0, 256}, {1, 256}, {256, 256}, {257, 512}, {4096, 4096}, {4097, 8192}, {(size_t)1 << 20, (size_t)1 << 20},
+    };
+
+    for (auto &s : sizes) {
+        size_t length = 0;
+        void *buf = websocket_pool_get(&p, s[0], &length);
+        ASSERT_NE(buf, nullptr);
+        EXPECT_EQ(length, s[1]) << "size " << s[0];
+        memset(buf, 0x5a, length);
+        websocket_pool_put(&p, buf, length);
+    }
+}
+
+// 超过最大一档的请求拿不到缓冲, 也不算借出
+TEST_F(pool, above_largest_class)
+{
+    size_t largest = (size_t)1 << (WEBSOCKET_POOL_CLASSES - 1 + WEBSOCKET_POOL_MIN_SHIFT);
+    size_t length = 0;
+
+    EXPECT_EQ(websocket_pool_get(&p, largest + 1, &length), nullptr);
+    EXPECT_EQ(p.borrowed, 0);
+}
+
+// 还回来的缓冲被同一档的下一次请求拿走, 不同档互不影响
+TEST_F(pool, buffers_come_back)
+{
+    size_t length;
+    void *a = websocket_pool_get(&p, 1000, &length);
+    void *b = websocket_pool_get(&p, 3000, &length);
+
+    EXPECT_EQ(p.borrowed, 2);
+    websocket_pool_put(&p, a, 1024);
+    websocket_pool_put(&p, b, 4096);
+    EXPECT_EQ(p.borrowed, 0);
+    EXPECT_EQ(p.count[2], 1);
+    EXPECT_EQ(p.count[4], 1);
+
+    EXPECT_EQ(websocket_pool_get(&p, 600, &length), a);
+    EXPECT_EQ(length, 1024u);
+    EXPECT_EQ(websocket_pool_get(&p, 4096, &length), b);
+    EXPECT_EQ(p.count[2], 0);
+    EXPECT_EQ(p.count[4], 0);
+    websocket_pool_put(&p, a, 1024);
+    websocket_pool_put(&p, b, 4096);
+}
+
+// 每档最多留 keep 个空闲缓冲, 多出来的直接还给堆
+TEST_F(pool, keeps_at_most_keep)
+{
+    std::vector<void *> bufs;
+    size_t length;
+
+    for (int i = 0; i < 10; i++)
+        bufs.push_back(websocket_pool_get(&p, 256, &length));
+    for (void *buf : bufs)
+        websocket_pool_put(&p, buf, length);
+    EXPECT_EQ(p.count[0], 4);
+
+    // 最后还回来的最先被拿走
+    EXPECT_EQ(websocket_pool_get(&p, 256, &length), bufs[3]);
+    websocket_pool_put(&p, bufs[3], length);
+}
+
+TEST_F(pool, put_null)
+{
+    websocket_pool_put(&p, nullptr, 256);
+    EXPECT_EQ(p.borrowed, 0);
+    EXPECT_EQ(p.count[0], 0);
+}
+
+TEST_F(pool, clear)
+{
+    size_t length;
+    void *a = websocket_pool_get(&p, 256, &length);
+    void *b = websocket_pool_get(&p, 8192, &length);
+
+    websocket_pool_put(&p, a, 256);
+    websocket_pool_put(&p, b, 8192);
+    websocket_pool_clear(&p);
+    for (int i = 0; i < WEBSOCKET_POOL_CLASSES; i++) {
+        EXPECT_EQ(p.free[i], nullptr);
+        EXPECT_EQ(p.count[i], 0);
+    }
+}
@@ -0,0 +1,43 @@
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <ctime>
+#include "websocket.h"
+#include "websocket_random.h"
+
+// 每帧取一个 4 字节的 mask key
+static void bench_mask_key(benchmark::State& state)
+{
+    uint32_t key;
+    for (auto _: state) {
+        ws_srand_key((unsigned char *)&key, sizeof(key));
+        benchmark::DoNotOptimize(key);
+    }
+}
+BENCHMARK(bench_mask_key);
+BENCHMARK(bench_mask_key)->Threads(4);
+
+// 旧实现: 每次调用都 srand(time(0)) 再 rand()
+static void bench_mask_key_libc(benchmark::State& state)
+{
+    unsigned char key[4];
+    for (auto _: state) {
+        srand(time(0));
+        for (int i = 0; i < 4; i++)
+            key[i] = rand() % 128;
+        benchmark::DoNotOptimize(key);
+    }
+}
+BENCHMARK(bench_mask_key_libc);
+BENCHMARK(bench_mask_key_libc)->Threads(4);
+
+// 握手用的 16 字节 key
+static void bench_handshake_key(benchmark::State& state)
+{
+    unsigned char key[16];
+    for (auto _: state) {
+        websocket_random_bytes(key, sizeof(key));
+        benchmark::DoNotOptimize(key);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * sizeof(key));
+}
+BENCHMARK(bench_handshake_key);
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+#include <set>
+#include <thread>
+#include <vector>
+#include "websocket.h"
+#include "websocket_random.h"
+
+// RFC 8439 2.3.2 的测试向量
+TEST(random, chacha20_block_vector) {
+    uint32_t key[8], out[16];
+    const uint32_t nonce[3] = {0x09000000, 0x4a000000, 0x00000000};
+    const uint32_t expect[16] = {
+        0xe4e7f110, 0x15593bd1, 0x1fdd0f50, 0xc47120a3,
+        0xc7f4d1c7, 0x0368c033, 0x9aaa2204, 0x4e6cd4c3,
+        0x466482d2, 0x09aa9f07, 0x05d7c214, 0xa2028bd9,
+        0xd19c12b5, 0xb94e16de, 0xe883d0cb, 0x4e3c50a2,
+    };
+
+    for (uint32_t i = 0; i < 8; i++)
+        key[i] = (4 * i) | ((4 * i + 1) << 8) | ((4 * i + 2) << 16) | ((4 * i + 3) << 24);
+
+    websocket_chacha20_block(key, 1, nonce, out);
+    for (int i = 0; i < 16; i++)
+        EXPECT_EQ(out[i], expect[i]) << "word " << i;
+}
+
+// 连续取出的 mask key 不应重复, 跨越多次 refill
+TEST(random, keys_do_not_repeat) {
+    std::set<uint32_t> keys;
+    for (int i = 0; i < 10000; i++) {
+        uint32_t key;
+        ws_srand_key((unsigned char *)&key, sizeof(key));
+        keys.insert(key);
+    }
+    EXPECT_GT(keys.size(), 9990u);
+}
+
+// 不同长度的请求, 包括跨越 pool 边界的大块
+TEST(random, odd_lengths) {
+    std::vector<unsigned char> buf(4096);
+    for (size_t len : {1, 3, 7, 31, 479, 480, 481, 4096}) {
+        std::fill(buf.begin(), buf.end(), 0);
+        websocket_random_bytes(buf.data(), len);
+        size_t zeros = 0;
+        for (size_t i = 0; i < len; i++)
+            zeros += buf[i] == 0;
+        EXPECT_LT(zeros, len / 16 + 2) << "len " << len;
+        for (size_t i = len; i < buf.size(); i++)
+            ASSERT_EQ(buf[i], 0) << "overrun at len " << len;
+    }
+}
+
+// 每个线程独立播种, 不同线程的输出不应相同
+TEST(random, threads_are_independent) {
+    unsigned char a[32], b[32];
+    std::thread t1([&] { websocket_random_bytes(a, sizeof(a)); });
+    std::thread t2([&] { websocket_random_bytes(b, sizeof(b)); });
+    t1.join();
+    t2.join();
+    EXPECT_NE(0, memcmp(a, b, sizeof(a)));
+}
+
+TEST(random, reseed) {
+    unsigned char a[16], b[16];
+    websocket_random_reseed();
+    websocket_random_bytes(a, sizeof(a));
+    websocket_random_reseed();
+    websocket_random_bytes(b, sizeof(b));
+    EXPECT_NE(0, memcmp(a, b, sizeof(a)));
+}
@@ -0,0 +1,383 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "websocket.h"
+
+struct wire_frame
+{
+    int opcode;
+    bool fin;
+    std::string payload;
+};
+
+// 用 socketpair 代替服务器, session 的 cache 直接手动分配
+struct wire
+{
+    int fd[2];
+    int sends = 0;
+    struct websocket_session session;
+
+    wire(size_t sndbuf = 0)
+    {
+        socketpair(AF_UNIX, SOCK_STREAM, 0, fd);
+        if (sndbuf) {
+            int size = (int)sndbuf;
+            setsockopt(fd[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+        }
+        websocket_session_init(&session);
+        session.socket_fd = fd[0];
+        session.cache_len = 4096;
+        session.cache = (char *)malloc(session.cache_len);
+    }
+
+    ~wire()
+    {
+        free(session.cache);
+        websocket_session_deinit(&session);
+        close(fd[0]);
+        close(fd[1]);
+    }
+
+    void read_exact(void *buf, size_t len)
+    {
+        size_t pos = 0;
+        while (pos < len) {
+            ssize_t n = read(fd[1], (char *)buf + pos, len - pos);
+            ASSERT_GT(n, 0);
+            pos += n;
+        }
+    }
+
+    // 解析一个客户端帧(带掩码)
+    wire_frame next()
+    {
+        unsigned char head[14], key[4];
+        wire_frame frame;
+        uint64_t length;
+
+        read_exact(head, 2);
+        frame.fin = head[0] & 0x80;
+        frame.opcode = head[0] & 0x0f;
+        EXPECT_TRUE(head[1] & 0x80);
+        length = head[1] & 0x7f;
+        if (length == 126) {
+            read_exact(head + 2, 2);
+            length = (head[2] << 8) | head[3];
+        } else if (length == 127) {
+            read_exact(head + 2, 8);
+            length = 0;
+            for (int i = 0; i < 8; i++)
+                length = (length << 8) | head[2 + i];
+        }
+        read_exact(key, 4);
+        frame.payload.resize(length);
+        read_exact(&frame.payload[0], length);
+        for (uint64_t i = 0; i < length; i++)
+            frame.payload[i] ^= key[i % 4];
+        return frame;
+    }
+};
+
+// 分片消息的两个分片之间可以插入控制帧
+TEST(scheduler, control_between_slices) {
+    wire w;
+    ASSERT_EQ(websocket_write_slice(&w.session, "aaa", 3, WEBSOCKET_TEXT_FRAME, WEBSOCKET_WRITE_FIRST_SLICE), 3);
+    ASSERT_EQ(websocket_send_pong(&w.session, "p", 1), WEBSOCKET_OK);
+    ASSERT_EQ(websocket_write_slice(&w.session, "bbb", 3, WEBSOCKET_TEXT_FRAME, WEBSOCKET_WRITE_END_SLICE), 3);
+
+    wire_frame f = w.next();
+    EXPECT_EQ(f.opcode, WEBSOCKET_TEXT_FRAME);
+    EXPECT_FALSE(f.fin);
+    f = w.next();
+    EXPECT_EQ(f.opcode, WEBSOCKET_PONG_FRAME);
+    EXPECT_EQ(f.payload, "p");
+    f = w.next();
+    EXPECT_EQ(f.opcode, WEBSOCKET_CONTINUE_FRAME);
+    EXPECT_TRUE(f.fin);
+    EXPECT_EQ(f.payload, "bbb");
+}
+
+// 写线程第一次调用 send 时通知测试线程, 此时它持有 tx_lock 且帧已经开始发送
+struct first_send
+{
+    wire *w;
+    std::promise<void> started;
+    std::once_flag once;
+};
+
+static int signalling_send(void *ctx, const void *buf, size_t len, int flags)
+{
+    struct first_send *s = (struct first_send *)ctx;
+    std::call_once(s->once, [s] { s->started.set_value(); });
+    return (int)send(s->w->fd[0], buf, len, flags | MSG_NOSIGNAL);
+}
+
+// 大帧发送过程中, 控制帧不阻塞, 由发送线程在帧边界发出
+TEST(scheduler, control_queued_behind_frame_on_wire) {
+    wire w(4096);
+    std::string big(2 << 20, 'x');
+    std::atomic<bool> done{false};
+    struct first_send s;
+    int write_res = 0;
+
+    s.w = &w;
+    w.session.send_to = signalling_send;
+    w.session.send_ctx = &s;
+    std::thread writer([&] {
+        write_res = websocket_write(&w.session, big.data(), big.size(), WEBSOCKET_BIN_FRAME);
+        done = true;
+    });
+    s.started.get_future().wait();
+
+    // 没有人读 fd[1], 写线程停在这个帧里, 控制帧只能排队
+    ASSERT_EQ(websocket_send_pong(&w.session, "p1", 2), WEBSOCKET_OK);
+    ASSERT_EQ(websocket_send_ping(&w.session, "p2", 2), WEBSOCKET_OK);
+    EXPECT_FALSE(done);
+
+    wire_frame f = w.next();
+    writer.join();
+    EXPECT_EQ(write_res, (int)big.size());
+    EXPECT_EQ(f.opcode, WEBSOCKET_BIN_FRAME);
+    EXPECT_TRUE(f.payload == big);
+    f = w.next();
+    EXPECT_EQ(f.opcode, WEBSOCKET_PONG_FRAME);
+    EXPECT_EQ(f.payload, "p1");
+    f = w.next();
+    EXPECT_EQ(f.opcode, WEBSOCKET_PING_FRAME);
+    EXPECT_EQ(f.payload, "p2");
+}
+
+// close 帧之后不能再发送数据帧
+TEST(scheduler, nothing_after_close) {
+    wire w;
+    ASSERT_EQ(websocket_send_close(&w.session, WEBSOCKET_STATUS_CLOSE_NORMAL, "bye", 3), WEBSOCKET_OK);
+    EXPECT_LT(websocket_write(&w.session, "late", 4, WEBSOCKET_TEXT_FRAME), 0);
+
+    wire_frame f = w.next();
+    EXPECT_EQ(f.opcode, WEBSOCKET_CLOSE_FRAME);
+    EXPECT_EQ(f.payload.substr(2), "bye");
+}
+
+// 超过 max_frame_payload 的消息自动拆成 FIRST/MIDDLE/END 分片
+TEST(scheduler, fragments_above_max_frame_payload) {
+    wire w;
+    std::string a(1000, 'a'), b(1500, 'b'), c(10, 'c');
+    struct iovec iov[3] = {{&a[0], a.size()}, {&b[0], b.size()}, {&c[0], c.size()}};
+
+    ASSERT_EQ(websocket_set_max_frame_payload(&w.session, 1024), WEBSOCKET_OK);
+    ASSERT_EQ(websocket_writev(&w.session, iov, 3, WEBSOCKET_BIN_FRAME), 2510);
+    ASSERT_EQ(websocket_write(&w.session, "small", 5, WEBSOCKET_TEXT_FRAME), 5);
+
+    std::string payload;
+    std::vector<size_t> sizes;
+    wire_frame f;
+    do {
+        f = w.next();
+        EXPECT_EQ(f.opcode, sizes.empty() ? WEBSOCKET_BIN_FRAME : WEBSOCKET_CONTINUE_FRAME);
+        sizes.push_back(f.payload.size());
+        payload += f.payload;
+    } while (!f.fin);
+    EXPECT_EQ(sizes, (std::vector<size_t>{1024, 1024, 462}));
+    EXPECT_EQ(payload, a + b + c);
+
+    f = w.next();
+    EXPECT_EQ(f.opcode, WEBSOCKET_TEXT_FRAME);
+    EXPECT_TRUE(f.fin);
+    EXPECT_EQ(f.payload, "small");
+}
+
+// 分片之间让出 socket, 控制帧在下一个分片之前发出
+TEST(scheduler, control_between_fragments) {
+    wire w(4096);
+    std::string big(1 << 20, 'x');
+    int write_res = 0;
+
+    struct first_send s;
+
+    s.w = &w;
+    w.session.send_to = signalling_send;
+    w.session.send_ctx = &s;
+    websocket_set_max_frame_payload(&w.session, 64 << 10);
+    std::thread writer([&] { write_res = websocket_write(&w.session, big.data(), big.size(), WEBSOCKET_BIN_FRAME); });
+    s.started.get_future().wait();
+    ASSERT_EQ(websocket_send_pong(&w.session, "p", 1), WEBSOCKET_OK);
+
+    size_t before_pong = 0;
+    wire_frame f = w.next();
+    while (f.opcode != WEBSOCKET_PONG_FRAME) {
+        before_pong += f.payload.size();
+        ASSERT_FALSE(f.fin);
+        f = w.next();
+    }
+    EXPECT_LE(before_pong, (size_t)(2 * (64 << 10)));
+    do {
+        f = w.next();
+        EXPECT_EQ(f.opcode, WEBSOCKET_CONTINUE_FRAME);
+    } while (!f.fin);
+    writer.join();
+    EXPECT_EQ(write_res, (int)big.size());
+}
+
+static int counting_send(void *ctx, const void *buf, size_t len, int flags)
+{
+    struct wire *w = (struct wire *)ctx;
+    w->sends += 1;
+    return (int)send(w->fd[0], buf, len, flags | MSG_NOSIGNAL);
+}
+
+// 一批小消息超过 cache 也只调用一次 send
+TEST(scheduler, batch_in_one_send) {
+    wire w(1 << 20);
+    std::vector<std::string> data;
+    std::vector<struct ws_msg> msgs;
+
+    for (int i = 0; i < 50; i++)
+        data.push_back(std::string(200, 'a' + i % 26));
+    for (auto &d : data)
+        msgs.push_back({d.data(), d.size(), WEBSOCKET_TEXT_FRAME});
+    w.session.send_to = counting_send;
+    w.session.send_ctx = &w;
+
+    ASSERT_EQ(websocket_write_batch(&w.session, msgs.data(), msgs.size()), 50);
+    EXPECT_EQ(w.sends, 1);
+    for (auto &d : data) {
+        wire_frame f = w.next();
+        EXPECT_EQ(f.opcode, WEBSOCKET_TEXT_FRAME);
+        EXPECT_TRUE(f.fin);
+        EXPECT_EQ(f.payload, d);
+    }
+}
+
+// 按顺序读出一批消息, 分片的消息拼回一条
+static void expect_batch(wire &w, const std::vector<std::string> &data)
+{
+    for (auto &d : data) {
+        std::string payload;
+        wire_frame f = w.next();
+        EXPECT_EQ(f.opcode, WEBSOCKET_BIN_FRAME);
+        payload = f.payload;
+        while (!f.fin) {
+            f = w.next();
+            EXPECT_EQ(f.opcode, WEBSOCKET_CONTINUE_FRAME);
+            payload += f.payload;
+        }
+        EXPECT_TRUE(payload == d) << "message of " << d.size() << " bytes";
+    }
+}
+
+static std::vector<struct ws_msg> batch_of(const std::vector<std::string> &data)
+{
+    std::vector<struct ws_msg> msgs;
+
+    for (auto &d : data)
+        msgs.push_back({d.data(), d.size(), WEBSOCKET_BIN_FRAME});
+    return msgs;
+}
+
+// cache 缩小后大帧按 cache 大小分块掩码发送, 每块接着上一块的掩码相位, 对端解出原来的字节
+TEST(scheduler, small_cache_chunks_large_frame) {
+    wire w;
+    std::string data(5000, '\0');
+    std::string a, b, c;
+
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (char)(i * 131 + i / 7);
+    // 小于帧头能用的最小值时不改
+    EXPECT_LT(websocket_set_cache_size(&w.session, 511), 0);
+    EXPECT_EQ(w.session.cache_len, 4096u);
+    ASSERT_EQ(websocket_set_cache_size(&w.session, 512), WEBSOCKET_OK);
+    EXPECT_EQ(w.session.cache_len, 512u);
+    w.session.send_to = counting_send;
+    w.session.send_ctx = &w;
+
+    ASSERT_EQ(websocket_write(&w.session, data.data(), data.size(), WEBSOCKET_BIN_FRAME), (int)data.size());
+    // 第一块前面是帧头, 块的边界不是 4 的倍数, 掩码要转过来接上
+    EXPECT_GE(w.sends, (int)(data.size() / 512));
+    wire_frame f = w.next();
+    EXPECT_EQ(f.opcode, WEBSOCKET_BIN_FRAME);
+    EXPECT_TRUE(f.fin);
+    EXPECT_TRUE(f.payload == data);
+
+    // 几段长度参差的 iovec 拼成一帧, 段的边界落在块的中间
+    a = data.substr(0, 7);
+    b = data.substr(7, 1001);
+    c = data.substr(1008);
+    struct iovec iov[3] = {{&a[0], a.size()}, {&b[0], b.size()}, {&c[0], c.size()}};
+    w.sends = 0;
+    ASSERT_EQ(websocket_writev(&w.session, iov, 3, WEBSOCKET_TEXT_FRAME), (int)data.size());
+    EXPECT_GE(w.sends, (int)(data.size() / 512));
+    f = w.next();
+    EXPECT_EQ(f.opcode, WEBSOCKET_TEXT_FRAME);
+    EXPECT_TRUE(f.payload == data);
+}
+
+// 已经暂存了帧之后遇到超过 max_frame_payload 的消息, 先发出暂存的帧再分片发送
+TEST(scheduler, batch_mixed_above_max_frame_payload) {
+    wire w;
+    std::vector<std::string> data = {std::string(50, 'a'), std::string(200, 'b'), std::string(30, 'c')};
+    std::vector<struct ws_msg> msgs = batch_of(data);
+
+    ASSERT_EQ(websocket_set_max_frame_payload(&w.session, 100), WEBSOCKET_OK);
+    ASSERT_EQ(websocket_write_batch(&w.session, msgs.data(), msgs.size()), 3);
+    expect_batch(w, data);
+}
+
+// 超过 cache 的消息夹在小消息中间, 暂存区(cache 或额外分配的)里的帧不能被覆盖
+TEST(scheduler, batch_mixed_above_cache) {
+    wire w;
+    std::vector<std::vector<size_t>> batches = {{400, 600, 400, 400, 400}, {100, 100, 600}, {600, 100, 100}};
+
+    ASSERT_EQ(websocket_set_cache_size(&w.session, 512), WEBSOCKET_OK);
+    for (auto &sizes : batches) {
+        std::vector<std::string> data;
+        for (size_t i = 0; i < sizes.size(); i++)
+            data.push_back(std::string(sizes[i], 'a' + i));
+        std::vector<struct ws_msg> msgs = batch_of(data);
+
+        ASSERT_EQ(websocket_write_batch(&w.session, msgs.data(), msgs.size()), (int)msgs.size());
+        expect_batch(w, data);
+    }
+}
+
+// 另一个线程的消息不能插入分片消息的分片之间
+TEST(scheduler, message_not_split_by_other_writer) {
+    wire w(4096);
+    std::string big(1 << 20, 'x');
+    struct first_send s;
+    int big_res = 0, small_res = 0;
+
+    s.w = &w;
+    w.session.send_to = signalling_send;
+    w.session.send_ctx = &s;
+    websocket_set_max_frame_payload(&w.session, 16 << 10);
+    std::thread writer([&] { big_res = websocket_write(&w.session, big.data(), big.size(), WEBSOCKET_BIN_FRAME); });
+    s.started.get_future().wait();
+    std::thread other([&] { small_res = websocket_write(&w.session, "small", 5, WEBSOCKET_TEXT_FRAME); });
+
+    // 两条消息都读完再判断顺序, 出错时也不会让写线程卡住
+    std::string payload;
+    bool big_done = false, small_done = false, interleaved = false;
+    while (!big_done || !small_done) {
+        wire_frame f = w.next();
+        if (f.opcode == WEBSOCKET_TEXT_FRAME) {
+            EXPECT_EQ(f.payload, "small");
+            interleaved = !big_done;
+            small_done = true;
+        } else {
+            payload += f.payload;
+            big_done = f.fin;
+        }
+    }
+    EXPECT_FALSE(interleaved);
+    EXPECT_TRUE(payload == big);
+    writer.join();
+    other.join();
+    EXPECT_EQ(big_res, (int)big.size());
+    EXPECT_EQ(small_res, 5);
+}
@@ -0,0 +1,45 @@
+#include <benchmark/benchmark.h>
+#include <vector>
+#include "websocket_timer.h"
+
+static void bench_noop(struct websocket_timer *, void *)
+{
+}
+
+// 5 万个会话各自重设一次空闲定时器
+static void bench_timer_rearm(benchmark::State& state)
+{
+    static struct websocket_timer_wheel wheel;
+    std::vector<struct websocket_timer> timers(state.range(0));
+
+    websocket_timer_wheel_init(&wheel, 0);
+    for (auto &t : timers) {
+        websocket_timer_init(&t, bench_noop);
+        websocket_timer_arm(&wheel, &t, 30000);
+    }
+    for (auto _: state) {
+        for (auto &t : timers)
+            websocket_timer_arm(&wheel, &t, 30000);
+    }
+    state.SetItemsProcessed(state.iterations() * timers.size());
+}
+BENCHMARK(bench_timer_rearm)->Arg(50000);
+
+// 推进一个 tick 的开销
+static void bench_timer_advance(benchmark::State& state)
+{
+    static struct websocket_timer_wheel wheel;
+    std::vector<struct websocket_timer> timers(state.range(0));
+    uint64_t now = 0;
+
+    websocket_timer_wheel_init(&wheel, 0);
+    for (size_t i = 0; i < timers.size(); i++) {
+        websocket_timer_init(&timers[i], bench_noop);
+        websocket_timer_arm(&wheel, &timers[i], 1000000 + i);
+    }
+    for (auto _: state) {
+        now += WEBSOCKET_TIMER_TICK_MS;
+        websocket_timer_wheel_advance(&wheel, now, nullptr);
+    }
+}
+BENCHMARK(bench_timer_advance)->Arg(50000);
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+#include "websocket_timer.h"
+
+struct probe {
+    struct websocket_timer timer;
+    uint64_t fired_ms;
+    uint32_t timeout_ms;
+    int count;
+};
+
+static uint64_t clock_ms;
+
+static void probe_fire(struct websocket_timer *timer, void *ctx)
+{
+    struct probe *p = ws_container_of(timer, struct probe, timer);
+    p->fired_ms = clock_ms;
+    p->count += 1;
+    (*(int *)ctx) += 1;
+}
+
+// 逐毫秒推进, 直到 end
+static int run_until(struct websocket_timer_wheel *wheel, uint64_t end)
+{
+    int fired = 0;
+    for (; clock_ms <= end; clock_ms++)
+        websocket_timer_wheel_advance(wheel, clock_ms, &fired);
+    clock_ms = end;
+    return fired;
+}
+
+// 每一层的超时都不早于设定值, 最多晚两个 tick
+TEST(timer, fires_in_window) {
+    struct websocket_timer_wheel wheel;
+    std::vector<probe> probes(12);
+    const uint32_t timeouts[] = {0, 1, 9, 10, 11, 630, 640, 650, 40950, 40960, 41000, 2700000};
+
+    clock_ms = 1000;
+    websocket_timer_wheel_init(&wheel, clock_ms);
+    for (size_t i = 0; i < probes.size(); i++) {
+        probes[i] = probe();
+        websocket_timer_init(&probes[i].timer, probe_fire);
+        probes[i].timeout_ms = timeouts[i];
+        websocket_timer_arm(&wheel, &probes[i].timer, timeouts[i]);
+    }
+
+    EXPECT_EQ(run_until(&wheel, 1000 + 2700000 + 100), (int)probes.size());
+    for (auto &p : probes) {
+        EXPECT_EQ(p.count, 1) << p.timeout_ms;
+        EXPECT_GE(p.fired_ms, 1000 + p.timeout_ms) << p.timeout_ms;
+        EXPECT_LE(p.fired_ms, 1000 + p.timeout_ms + 2 * WEBSOCKET_TIMER_TICK_MS) << p.timeout_ms;
+    }
+    EXPECT_EQ(websocket_timer_wheel_timeout(&wheel, clock_ms), -1);
+}
+
+// 取消与重新设定, 被取消的不再触发
+TEST(timer, cancel_and_rearm) {
+    struct websocket_timer_wheel wheel;
+    probe a = probe(), b = probe();
+
+    clock_ms = 0;
+    websocket_timer_wheel_init(&wheel, clock_ms);
+    websocket_timer_init(&a.timer, probe_fire);
+    websocket_timer_init(&b.timer, probe_fire);
+    websocket_timer_arm(&wheel, &a.timer, 5000);
+    websocket_timer_arm(&wheel, &b.timer, 5000);
+    EXPECT_TRUE(websocket_timer_armed(&a.timer));
+
+    run_until(&wheel, 3000);
+    websocket_timer_cancel(&wheel, &a.timer);
+    EXPECT_FALSE(websocket_timer_armed(&a.timer));
+    websocket_timer_arm(&wheel, &b.timer, 5000);
+
+    run_until(&wheel, 7000);
+    EXPECT_EQ(a.count, 0);
+    EXPECT_EQ(b.count, 0);
+    run_until(&wheel, 8100);
+    EXPECT_EQ(b.count, 1);
+    EXPECT_GE(b.fired_ms, 8000u);
+    EXPECT_EQ(wheel.count, 0u);
+}
+
+// 时钟跳跃时一次 advance 追上所有到期的定时器
+TEST(timer, clock_jump) {
+    struct websocket_timer_wheel wheel;
+    std::vector<probe> probes(1000);
+    std::mt19937 rng(7);
+    int fired = 0;
+
+    websocket_timer_wheel_init(&wheel, 0);
+    for (auto &p : probes) {
+        p = probe();
+        websocket_timer_init(&p.timer, probe_fire);
+        websocket_timer_arm(&wheel, &p.timer, rng() % 100000);
+    }
+    clock_ms = 100000 + 2 * WEBSOCKET_TIMER_TICK_MS;
+    EXPECT_EQ(websocket_timer_wheel_advance(&wheel, clock_ms, &fired), 1000);
+    EXPECT_EQ(fired, 1000);
+}
+
+// timeout 不晚于最近的到期时间
+TEST(timer, timeout_hint) {
+    struct websocket_timer_wheel wheel;
+    probe p = probe();
+    int timeout;
+
+    clock_ms = 0;
+    websocket_timer_wheel_init(&wheel, 0);
+    websocket_timer_init(&p.timer, probe_fire);
+    websocket_timer_arm(&wheel, &p.timer, 200);
+    timeout = websocket_timer_wheel_timeout(&wheel, 0);
+    EXPECT_GE(timeout, 200);
+    EXPECT_LE(timeout, 200 + 2 * WEBSOCKET_TIMER_TICK_MS);
+
+    // 高层的定时器至少在下一次 cascade 时唤醒
+    websocket_timer_arm(&wheel, &p.timer, 60000);
+    timeout = websocket_timer_wheel_timeout(&wheel, 0);
+    EXPECT_GT(timeout, 0);
+    EXPECT_LE(timeout, WEBSOCKET_TIMER_LEVEL_SLOTS * WEBSOCKET_TIMER_TICK_MS);
+
+    // 只按 timeout 睡眠也能准时触发
+    int fired = 0;
+    while (p.count == 0) {
+        timeout = websocket_timer_wheel_timeout(&wheel, clock_ms);
+        ASSERT_GE(timeout, 0);
+        clock_ms += timeout;
+        websocket_timer_wheel_advance(&wheel, clock_ms, &fired);
+    }
+    EXPECT_GE(p.fired_ms, 60000u);
+    EXPECT_LE(p.fired_ms, 60000u + 2 * WEBSOCKET_TIMER_TICK_MS);
+}
@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "websocket.h"
+#include "websocket_uring.h"
+
+#ifdef WEBSOCKET_USING_IO_URING
+
+struct completion
+{
+    uint64_t user_data;
+    int res;
+    uint32_t flags;
+};
+
+// 一个 ring 加一对 socket, 内核不支持 io_uring 时跳过
+class uring : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        socketpair(AF_UNIX, SOCK_STREAM, 0, fd);
+        if (websocket_uring_init(&ring, 32) != WEBSOCKET_OK)
+            GTEST_SKIP() << "io_uring is not available";
+        ready = true;
+    }
+
+    void TearDown() override
+    {
+        if (ready)
+            websocket_uring_exit(&ring);
+        close(fd[0]);
+        close(fd[1]);
+    }
+
+    // 提交并等待至少一个完成事件, 把已经完成的都取出来
+    std::vector<completion> reap(int timeout_ms = 1000)
+    {
+        std::vector<completion> out;
+        struct io_uring_cqe *cqe;
+
+        websocket_uring_enter(&ring, 1, timeout_ms);
+        while ((cqe = websocket_uring_peek_cqe(&ring)) != NULL) {
+            out.push_back({cqe->user_data, cqe->res, cqe->flags});
+            websocket_uring_cqe_seen(&ring);
+        }
+        return out;
+    }
+
+    std::string buffer(const completion &c)
+    {
+        unsigned short bid = (unsigned short)(c.flags >> IORING_CQE_BUFFER_SHIFT);
+        return std::string(websocket_uring_buffer(&ring, bid), c.res);
+    }
+
+    struct websocket_uring ring;
+    bool ready = false;
+    int fd[2];
+};
+
+TEST_F(uring, recv_multishot_into_provided_buffers)
+{
+    ASSERT_EQ(websocket_uring_buffers_init(&ring, 4, 64, 1), WEBSOCKET_OK);
+    websocket_uring_prep_recv_multishot(websocket_uring_get_sqe(&ring), fd[0], 1, 7);
+    websocket_uring_enter(&ring, 0, 0);
+
+    for (const char *text : {"hello", "world"}) {
+        ASSERT_EQ(write(fd[1], text, strlen(text)), (ssize_t)strlen(text));
+        auto cqes = reap();
+        ASSERT_EQ(cqes.size(), 1u);
+        EXPECT_EQ(cqes[0].user_data, 7u);
+        ASSERT_EQ(cqes[0].res, (int)strlen(text));
+        EXPECT_TRUE(cqes[0].flags & IORING_CQE_F_BUFFER);
+        EXPECT_TRUE(cqes[0].flags & IORING_CQE_F_MORE);
+        EXPECT_EQ(buffer(cqes[0]), text);
+    }
+}
+
+// 缓冲用完后 multishot 请求以 -ENOBUFS 结束, 还回缓冲并重新提交后剩下的数据照常到达
+TEST_F(uring, buffers_run_out_and_come_back)
+{
+    std::string sent(64, 'x'), received;
+
+    for (size_t i = 0; i < sent.size(); i++)
+        sent[i] = 'a' + i % 26;
+    ASSERT_EQ(websocket_uring_buffers_init(&ring, 2, 16, 1), WEBSOCKET_OK);
+    ASSERT_EQ(write(fd[1], sent.data(), sent.size()), (ssize_t)sent.size());
+
+    std::vector<unsigned short> used;
+    for (int round = 0; round < 4 && received.size() < sent.size(); round++) {
+        websocket_uring_prep_recv_multishot(websocket_uring_get_sqe(&ring), fd[0], 1, 9);
+        bool ended = false;
+        while (!ended && received.size() < sent.size()) {
+            auto cqes = reap();
+            ASSERT_FALSE(cqes.empty());
+            for (auto &c : cqes) {
+                if (c.res > 0) {
+                    received += buffer(c);
+                    used.push_back((unsigned short)(c.flags >> IORING_CQE_BUFFER_SHIFT));
+                }
+                if (!(c.flags & IORING_CQE_F_MORE)) {
+                    ended = true;
+                    EXPECT_EQ(c.res, -ENOBUFS);
+                }
+            }
+        }
+        for (unsigned short bid : used)
+            websocket_uring_buffer_recycle(&ring, bid);
+        websocket_uring_buffers_commit(&ring);
+        used.clear();
+    }
+    EXPECT_EQ(received, sent);
+}
+
+TEST_F(uring, sendmsg_gathers_iovecs)
+{
+    char a[] = "scatter ", b[] = "gather";
+    struct iovec iov[2] = {{a, strlen(a)}, {b, strlen(b)}};
+    struct msghdr msg = {};
+    char buf[32] = {0};
+
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    websocket_uring_prep_sendmsg(websocket_uring_get_sqe(&ring), fd[0], &msg, MSG_NOSIGNAL, 3);
+    auto cqes = reap();
+    ASSERT_EQ(cqes.size(), 1u);
+    EXPECT_EQ(cqes[0].user_data, 3u);
+    EXPECT_EQ(cqes[0].res, 14);
+    ASSERT_EQ(read(fd[1], buf, sizeof(buf)), 14);
+    EXPECT_STREQ(buf, "scatter gather");
+}
+
+TEST_F(uring, poll_and_cancel)
+{
+    websocket_uring_prep_poll_multishot(websocket_uring_get_sqe(&ring), fd[0], POLLIN, 5);
+    websocket_uring_enter(&ring, 0, 0);
+    ASSERT_EQ(write(fd[1], "x", 1), 1);
+    auto cqes = reap();
+    ASSERT_EQ(cqes.size(), 1u);
+    EXPECT_TRUE(cqes[0].res & POLLIN);
+    EXPECT_TRUE(cqes[0].flags & IORING_CQE_F_MORE);
+
+    websocket_uring_prep_cancel(websocket_uring_get_sqe(&ring), 5, 6);
+    std::vector<completion> all;
+    while (all.size() < 2) {
+        auto more = reap();
+        ASSERT_FALSE(more.empty());
+        all.insert(all.end(), more.begin(), more.end());
+    }
+    for (auto &c : all) {
+        if (c.user_data == 5)
+            EXPECT_EQ(c.res, -ECANCELED);
+        else
+            EXPECT_EQ(c.res, 0);
+    }
+}
+
+TEST_F(uring, wait_times_out)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto cqes = reap(50);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+    EXPECT_TRUE(cqes.empty());
+    EXPECT_GE(ms, 40);
+    EXPECT_LT(ms, 1000);
+}
+
+// 提交队列满了以后 get_sqe 返回 NULL, enter 之后又有空位
+TEST_F(uring, full_submission_queue)
+{
+    unsigned int n = 0;
+
+    while (websocket_uring_get_sqe(&ring) != NULL)
+        n++;
+    EXPECT_EQ(n, ring.sq_entries);
+    websocket_uring_enter(&ring, 0, 0);
+    EXPECT_NE(websocket_uring_get_sqe(&ring), nullptr);
+}
+
+#endif
@@ -0,0 +1,39 @@
+#include <benchmark/benchmark.h>
+#include <string>
+#include "websocket_utf8.h"
+
+// 每个 kernel 的吞吐量, 分别测纯 ASCII 和混合文本(ASCII + 2/3/4 字节字符)
+static std::string make_text(size_t size, bool ascii_only)
+{
+    const char *pieces[] = { "{\"sym\":\"ABC\",\"px\":101.25}", "caf\xc3\xa9", "\xe8\xa1\x8c\xe6\x83\x85", "\xf0\x9f\x93\x88" };
+    std::string text;
+    for (size_t i = 0; text.size() < size; i++)
+        text += ascii_only ? pieces[0] : pieces[i % 4];
+    while (text.size() > size || (text.size() && ((unsigned char)text.back() & 0xc0) == 0x80 && size - text.size() < 4))
+        text.pop_back();
+    return text;
+}
+
+static void bench_utf8_kernel(benchmark::State& state, websocket_utf8_kernel_t kernel, bool ascii_only)
+{
+    std::string text = make_text(state.range(0), ascii_only);
+
+    if (websocket_utf8_kernel_select(kernel) != 0)
+    {
+        state.SkipWithError("kernel not supported on this cpu");
+        return;
+    }
+
+    for (auto _: state) {
+        benchmark::DoNotOptimize(websocket_utf8_validate(text.data(), text.size()));
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * text.size());
+    state.SetLabel(websocket_utf8_kernel_name(kernel));
+    websocket_utf8_kernel_select(WEBSOCKET_UTF8_KERNEL_AUTO);
+}
+BENCHMARK_CAPTURE(bench_utf8_kernel, scalar_ascii, WEBSOCKET_UTF8_KERNEL_SCALAR, true)->Arg(64 << 10);
+BENCHMARK_CAPTURE(bench_utf8_kernel, scalar_mixed, WEBSOCKET_UTF8_KERNEL_SCALAR, false)->Arg(64 << 10);
+BENCHMARK_CAPTURE(bench_utf8_kernel, ssse3_mixed, WEBSOCKET_UTF8_KERNEL_SSSE3, false)->Arg(64 << 10);
+BENCHMARK_CAPTURE(bench_utf8_kernel, avx2_ascii, WEBSOCKET_UTF8_KERNEL_AVX2, true)->Arg(64 << 10);
+BENCHMARK_CAPTURE(bench_utf8_kernel, avx2_mixed, WEBSOCKET_UTF8_KERNEL_AVX2, false)->Arg(64 << 10);
+BENCHMARK_CAPTURE(bench_utf8_kernel, neon_mixed, WEBSOCKET_UTF8_KERNEL_NEON, false)->Arg(64 << 10);
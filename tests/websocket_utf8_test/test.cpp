@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <random>
+#include "websocket.h"
+#include "websocket_utf8.h"
+
+// 逐个码点解码的参考实现, 只用来和各个 kernel 比对
+static bool reference_valid(const std::string &s)
+{
+    size_t i = 0;
+    while (i < s.size()) {
+        unsigned char c = s[i];
+        uint32_t cp;
+        size_t n;
+        if (c < 0x80) { i++; continue; }
+        else if ((c & 0xe0) == 0xc0) { n = 1; cp = c & 0x1f; }
+        else if ((c & 0xf0) == 0xe0) { n = 2; cp = c & 0x0f; }
+        else if ((c & 0xf8) == 0xf0) { n = 3; cp = c & 0x07; }
+        else return false;
+        if (i + n >= s.size()) return false;
+        for (size_t k = 1; k <= n; k++) {
+            unsigned char cc = s[i + k];
+            if ((cc & 0xc0) != 0x80) return false;
+            cp = (cp << 6) | (cc & 0x3f);
+        }
+        if ((n == 1 && cp < 0x80) || (n == 2 && cp < 0x800) || (n == 3 && cp < 0x10000)) return false;
+        if (cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) return false;
+        i += n + 1;
+    }
+    return true;
+}
+
+static const std::vector<std::string> samples = {
+    "plain ascii",
+    "caf\xc3\xa9", "\xe8\xa1\x8c\xe6\x83\x85", "\xf0\x9f\x93\x88", "\xf4\x8f\xbf\xbf", "\xef\xbf\xbf",
+    "\xc0\xaf", "\xc1\xbf", "\xe0\x80\xaf", "\xe0\x9f\xbf", "\xf0\x80\x80\xaf", "\xf0\x8f\xbf\xbf",
+    "\xed\xa0\x80", "\xed\xbf\xbf", "\xf4\x90\x80\x80", "\xf5\x80\x80\x80", "\xf8\x88\x80\x80\x80", "\xff",
+    "\x80", "\xbf", "\xc3", "\xe8\xa1", "\xf0\x9f\x93", "\xc3\x28", "\xe8\x28\xa1", "\xc3\xa9\xa9",
+};
+
+TEST(utf8, kernels_match_reference) {
+    for (int k = WEBSOCKET_UTF8_KERNEL_SCALAR; k < WEBSOCKET_UTF8_KERNEL_MAX; k++) {
+        websocket_utf8_kernel_t kernel = (websocket_utf8_kernel_t)k;
+        if (!websocket_utf8_kernel_supported(kernel))
+            continue;
+        ASSERT_EQ(websocket_utf8_kernel_select(kernel), 0);
+        for (const std::string &sample : samples) {
+            // 把样本放到不同位置, 覆盖向量块的边界和尾部
+            for (size_t pad = 0; pad < 70; pad++) {
+                std::string text = std::string(pad, 'a') + sample + std::string(pad % 5, 'b');
+                bool expect = reference_valid(text);
+                EXPECT_EQ(websocket_utf8_validate(text.data(), text.size()) == WEBSOCKET_OK, expect)
+                    << websocket_utf8_kernel_name(kernel) << " pad " << pad << " sample " << sample;
+            }
+        }
+    }
+    websocket_utf8_kernel_select(WEBSOCKET_UTF8_KERNEL_AUTO);
+}
+
+TEST(utf8, random_mutations) {
+    std::mt19937 rng(1234);
+    std::string base;
+    for (int i = 0; i < 40; i++)
+        base += samples[1 + i % 5] + "xyz";
+
+    for (int round = 0; round < 3000; round++) {
+        std::string text = base.substr(rng() % 16);
+        for (int m = rng() % 3; m >= 0; m--)
+            text[rng() % text.size()] = (char)(rng() & 0xff);
+        bool expect = reference_valid(text);
+        for (int k = WEBSOCKET_UTF8_KERNEL_SCALAR; k < WEBSOCKET_UTF8_KERNEL_MAX; k++) {
+            if (websocket_utf8_kernel_select((websocket_utf8_kernel_t)k) != 0)
+                continue;
+            ASSERT_EQ(websocket_utf8_validate(text.data(), text.size()) == WEBSOCKET_OK, expect)
+                << websocket_utf8_kernel_name((websocket_utf8_kernel_t)k) << " round " << round;
+        }
+    }
+    websocket_utf8_kernel_select(WEBSOCKET_UTF8_KERNEL_AUTO);
+}
+
+TEST(utf8, incremental_split) {
+    std::string text;
+    for (int i = 0; i < 20; i++)
+        text += samples[1 + i % 5] + std::string(i, '.');
+
+    // 任意位置切成两段, 被切开的码点要在两次调用之间延续
+    for (size_t cut = 0; cut <= text.size(); cut++) {
+        struct websocket_utf8 utf8;
+        websocket_utf8_init(&utf8);
+        ASSERT_EQ(websocket_utf8_update(&utf8, text.data(), cut), WEBSOCKET_OK) << cut;
+        ASSERT_EQ(websocket_utf8_update(&utf8, text.data() + cut, text.size() - cut), WEBSOCKET_OK) << cut;
+        EXPECT_EQ(websocket_utf8_final(&utf8), WEBSOCKET_OK) << cut;
+    }
+
+    // 逐字节喂入
+    struct websocket_utf8 utf8;
+    websocket_utf8_init(&utf8);
+    for (char c : text)
+        ASSERT_EQ(websocket_utf8_update(&utf8, &c, 1), WEBSOCKET_OK);
+    EXPECT_EQ(websocket_utf8_final(&utf8), WEBSOCKET_OK);
+}
+
+TEST(utf8, incremental_errors) {
+    struct websocket_utf8 utf8;
+
+    // 消息在码点中间结束
+    websocket_utf8_init(&utf8);
+    EXPECT_EQ(websocket_utf8_update(&utf8, "ok\xe8\xa1", 4), WEBSOCKET_OK);
+    EXPECT_EQ(websocket_utf8_final(&utf8), -WEBSOCKET_INVALID_UTF8);
+
+    // 跨段的代理对和超长编码
+    websocket_utf8_init(&utf8);
+    EXPECT_EQ(websocket_utf8_update(&utf8, "\xed", 1), WEBSOCKET_OK);
+    EXPECT_EQ(websocket_utf8_update(&utf8, "\xa0\x80", 2), -WEBSOCKET_INVALID_UTF8);
+
+    websocket_utf8_init(&utf8);
+    EXPECT_EQ(websocket_utf8_update(&utf8, "abc\xf0", 4), WEBSOCKET_OK);
+    EXPECT_EQ(websocket_utf8_update(&utf8, "\x8f", 1), -WEBSOCKET_INVALID_UTF8);
+    // 出错后状态保持失败
+    EXPECT_EQ(websocket_utf8_update(&utf8, "abc", 3), -WEBSOCKET_INVALID_UTF8);
+}
@@ -0,0 +1,921 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <time.h>
+#include "websocket_service.h"
+#include "ws_test_server.h"
+
+// 一个客户端会话, ws 必须是第一个成员, 回调里直接从 app_websocket 转回来
+struct client
+{
+    struct app_websocket ws;
+    std::mutex lock;
+    std::vector<std::string> messages;
+    std::vector<int> iovcnts;   // 每条消息由几段组成
+    std::vector<ws_test_frame> fragments;   // stream 时 onfragment 每次收到的数据, fin 即 is_final
+    std::atomic<int> opened{0};     // onopen 的次数, 重连成功也算
+    std::atomic<int> closed{0};     // onclose 或 onerror 来过
+    std::atomic<int> closes{0};     // 只数 onclose
+    std::atomic<int> errors{0};
+    std::string error_reason;   // 最后一次 onerror 时的原因
+    std::chrono::steady_clock::time_point opened_at, errored_at, closed_at;
+    std::atomic<int> drains{0};
+    int stall_ms = 0;   // 第一条消息的回调里停这么久, 让 worker 暂时不读
+    bool echo = false;  // 在回调里(worker 线程上)把消息原样写回去
+    int sndbuf = 0;     // 不为 0 时设置 SO_SNDBUF, 让一次 send 只写得进一部分
+    bool stream = false;    // 用 onfragment 边收边交, onmessage 不应再触发
+    struct app_websocket_reconnect reconnect = {};  // base_ms 为 0 时不重连
+    struct app_websocket_timeouts timeouts = {};    // 全为 0 时用默认值
+    bool utf8 = false;  // 检查收到的文本是不是 UTF-8
+
+    static client *of(struct app_websocket *ws)
+    {
+        return reinterpret_cast<client *>(ws);
+    }
+
+    static int onmessage(struct app_websocket *ws)
+    {
+        const struct app_websocket_iovec *iov;
+        std::string message;
+        int iovcnt;
+
+        if (app_websocket_read_iov(ws, &iov, &iovcnt, NULL) >= 0) {
+            for (int i = 0; i < iovcnt; i++) {
+                message.append((const char *)iov[i].data, iov[i].length);
+            }
+            if (of(ws)->echo) {
+                EXPECT_TRUE(of(ws)->write(message));
+            }
+            std::lock_guard<std::mutex> guard(of(ws)->lock);
+            of(ws)->messages.push_back(message);
+            of(ws)->iovcnts.push_back(iovcnt);
+        }
+        if (of(ws)->stall_ms) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(of(ws)->stall_ms));
+            of(ws)->stall_ms = 0;
+        }
+        return WEBSOCKET_OK;
+    }
+
+    static int onopen(struct app_websocket *ws)
+    {
+        {
+            std::lock_guard<std::mutex> guard(of(ws)->lock);
+            of(ws)->opened_at = std::chrono::steady_clock::now();
+        }
+        of(ws)->opened += 1;
+        return WEBSOCKET_OK;
+    }
+
+    static int onclose(struct app_websocket *ws)
+    {
+        {
+            std::lock_guard<std::mutex> guard(of(ws)->lock);
+            of(ws)->closed_at = std::chrono::steady_clock::now();
+        }
+        of(ws)->closes += 1;
+        of(ws)->closed = 1;
+        return WEBSOCKET_OK;
+    }
+
+    static int onerror(struct app_websocket *ws)
+    {
+        const char *reason = NULL;
+
+        app_websocket_get_error_reason(ws, &reason);
+        {
+            std::lock_guard<std::mutex> guard(of(ws)->lock);
+            of(ws)->error_reason = reason ? reason : "";
+            of(ws)->errored_at = std::chrono::steady_clock::now();
+        }
+        of(ws)->errors += 1;
+        of(ws)->closed = 1;
+        return WEBSOCKET_OK;
+    }
+
+    static int onfragment(struct app_websocket *ws, const void *data, size_t len, int is_final, websocket_frame_type_t type)
+    {
+        std::lock_guard<std::mutex> guard(of(ws)->lock);
+        of(ws)->fragments.push_back({type, is_final != 0, std::string((const char *)data, len)});
+        return WEBSOCKET_OK;
+    }
+
+    static int ondrain(struct app_websocket *ws)
+    {
+        of(ws)->drains += 1;
+        return WEBSOCKET_OK;
+    }
+
+    bool connect(struct websocket_worker *worker, const std::string &url, size_t max_message = 0)
+    {
+        app_websocket_init(&ws);
+        app_websocket_set_url(&ws, url.c_str());
+        if (max_message)
+            app_websocket_set_max_message_size(&ws, max_message);
+        if (sndbuf) {
+            struct websocket_socket_options sockopt = {};
+            sockopt.sndbuf = sndbuf;
+            app_websocket_set_socket_options(&ws, &sockopt);
+            // 高水位为 0 时从不拒绝, 所有写入都留在队列里
+            app_websocket_set_watermarks(&ws, 0, 0);
+        }
+        app_websocket_message_event(&ws, onmessage);
+        app_websocket_open_event(&ws, onopen);
+        app_websocket_close_event(&ws, onclose);
+        app_websocket_error_event(&ws, onerror);
+        app_websocket_drain_event(&ws, ondrain);
+        if (stream)
+            app_websocket_fragment_event(&ws, onfragment);
+        if (reconnect.base_ms)
+            app_websocket_set_reconnect(&ws, &reconnect);
+        if (timeouts.handshake_ms || timeouts.idle_ms || timeouts.close_ms)
+            app_websocket_set_timeouts(&ws, &timeouts);
+        if (utf8)
+            app_websocket_set_utf8_validation(&ws, 1);
+        return app_websocket_set_worker(&ws, worker) == WEBSOCKET_OK && app_websocket_connect_server(&ws) == WEBSOCKET_OK;
+    }
+
+    bool write(const std::string &data)
+    {
+        struct app_websocket_frame frame = {(void *)data.data(), data.size(), WEBSOCKET_TEXT_FRAME};
+        return app_websocket_write_data(&ws, &frame) >= 0;
+    }
+
+    size_t count()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return messages.size();
+    }
+};
+
+static double cpu_ms()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// 每个用例跑在自己的 worker 上, epoll 和 io_uring 各一遍(内核不支持 io_uring 时退回 epoll)
+class worker : public ::testing::TestWithParam<app_websocket_engine_t>
+{
+protected:
+    void SetUp() override
+    {
+        struct app_websocket_worker_config cfg = {-1, GetParam()};
+        w = app_websocket_worker_create(&cfg);
+        ASSERT_NE(w, nullptr);
+        if (app_websocket_worker_engine(w) != GetParam())
+            GTEST_SKIP() << "io_uring is not available";
+    }
+
+    void TearDown() override
+    {
+        // 会话由 worker 释放, 负载归零后才能销毁 worker
+        for (auto &c : clients)
+            app_websocket_disconnect_server(&c->ws);
+        EXPECT_TRUE(ws_test_wait([this] { return app_websocket_worker_load(w) == 0; }));
+        EXPECT_EQ(app_websocket_worker_destroy(w), WEBSOCKET_OK);
+    }
+
+    client *add(const std::string &url, size_t max_message = 0)
+    {
+        clients.emplace_back(new client);
+        EXPECT_TRUE(clients.back()->connect(w, url, max_message));
+        return clients.back().get();
+    }
+
+    struct websocket_worker *w = nullptr;
+    std::vector<std::unique_ptr<client>> clients;
+};
+
+TEST_P(worker, echo_in_order)
+{
+    ws_test_server server;
+    client *c = add(server.url());
+
+    ASSERT_TRUE(ws_test_wait([c] { return c->opened.load() == 1; }));
+    for (int i = 0; i < 10; i++)
+        ASSERT_TRUE(c->write("message-" + std::to_string(i)));
+
+    ASSERT_TRUE(ws_test_wait([c] { return c->count() == 10; }));
+    for (int i = 0; i < 10; i++)
+        EXPECT_EQ(c->messages[i], "message-" + std::to_string(i));
+}
+
+// 一次 TCP 写入里的多条消息被一次读进缓存, 只能靠就绪链表再跑一轮, 不会再有可读事件
+TEST_P(worker, messages_read_ahead)
+{
+    ws_test_server server([](ws_test_peer &peer) {
+        std::string burst;
+        for (int i = 0; i < 5; i++)
+            burst += ws_test_peer::frame(WEBSOCKET_TEXT_FRAME, "burst-" + std::to_string(i));
+        peer.write_all(burst);
+        ws_test_server::echo(peer);
+    });
+    client *c = add(server.url());
+
+    ASSERT_TRUE(ws_test_wait([c] { return c->count() == 5; }));
+    for (int i = 0; i < 5; i++)
+        EXPECT_EQ(c->messages[i], "burst-" + std::to_string(i));
+}
+
+TEST_P(worker, many_sessions)
+{
+    const int n = 32;
+    ws_test_server server;
+
+    for (int i = 0; i < n; i++)
+        add(server.url());
+    ASSERT_TRUE(ws_test_wait([this] {
+        for (auto &c : clients)
+            if (!c->opened)
+                return false;
+        return true;
+    }));
+    EXPECT_EQ(app_websocket_worker_load(w), n);
+
+    for (int i = 0; i < n; i++)
+        ASSERT_TRUE(clients[i]->write("session-" + std::to_string(i)));
+    for (int i = 0; i < n; i++) {
+        client *c = clients[i].get();
+        ASSERT_TRUE(ws_test_wait([c] { return c->count() == 1; }));
+        EXPECT_EQ(c->messages[0], "session-" + std::to_string(i));
+    }
+}
+
+// 空闲的连接不能让 worker 空转
+TEST_P(worker, idle_sessions_do_not_spin)
+{
+    ws_test_server server;
+
+    for (int i = 0; i < 8; i++)
+        add(server.url());
+    ASSERT_TRUE(ws_test_wait([this] {
+        for (auto &c : clients)
+            if (!c->opened)
+                return false;
+        return true;
+    }));
+
+    double start = cpu_ms();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    EXPECT_LT(cpu_ms() - start, 100.0);
+}
+
+// 服务器断开后会话收到 close 事件, worker 也不会因为一直可读的 socket 空转
+TEST_P(worker, server_goes_away)
+{
+    std::unique_ptr<ws_test_server> server(new ws_test_server);
+    client *c = add(server->url());
+
+    ASSERT_TRUE(ws_test_wait([c] { return c->opened.load() == 1; }));
+    server->stop();
+    ASSERT_TRUE(ws_test_wait([c] { return c->closed.load() == 1; }));
+
+    double start = cpu_ms();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    EXPECT_LT(cpu_ms() - start, 60.0);
+}
+
+// 大消息在两个方向上都要经过多个接收缓冲和多次发送
+TEST_P(worker, large_messages_both_ways)
+{
+    ws_test_server server;
+    client *c = add(server.url(), 4 << 20);
+    std::string big(1 << 20, 0);
+
+    for (size_t i = 0; i < big.size(); i++)
+        big[i] = (char)(i * 131 + (i >> 12));
+    ASSERT_TRUE(ws_test_wait([c] { return c->opened.load() == 1; }));
+    for (int i = 0; i < 3; i++) {
+        big[0] = (char)i;
+        // 超过高水位时返回 -WEBSOCKET_AGAIN, 等队列排空再写
+        ASSERT_TRUE(ws_test_wait([c, &big] { return c->write(big); }, 10000));
+    }
+
+    ASSERT_TRUE(ws_test_wait([c] { return c->count() == 3; }, 10000));
+    for (int i = 0; i < 3; i++) {
+        big[0] = (char)i;
+        EXPECT_TRUE(c->messages[i] == big) << "message " << i;
+    }
+}
+
+// worker 停在回调里时内核把接收缓冲用完, 之后数据必须完整有序地到达, 也不能空转
+TEST_P(worker, receive_survives_buffer_starvation)
+{
+    const int n = 1024;
+    ws_test_server server([n](ws_test_peer &peer) {
+        std::string burst;
+        for (int i = 0; i < n; i++)
+            burst += ws_test_peer::frame(WEBSOCKET_BIN_FRAME, std::to_string(i) + std::string(4000, 'a' + i % 26));
+        peer.write_all(burst);
+        ws_test_server::echo(peer);
+    });
+    client *c = add(server.url());
+
+    c->stall_ms = 300;
+    ASSERT_TRUE(ws_test_wait([c] { return c->count() == n; }, 20000)) << c->count();
+    for (int i = 0; i < n; i++)
+        ASSERT_EQ(c->messages[i], std::to_string(i) + std::string(4000, 'a' + i % 26));
+
+    double start = cpu_ms();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    EXPECT_LT(cpu_ms() - start, 60.0);
+}
+
+// 没有会话也没有定时器时 worker 一直阻塞, 只有 eventfd 能唤醒它; 几个线程同时投递命令也一条不漏
+TEST_P(worker, commands_wake_an_idle_worker)
+{
+    const int threads = 4, per_thread = 8;
+    ws_test_server server;
+    std::vector<std::thread> posters;
+
+    double start = cpu_ms();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT_LT(cpu_ms() - start, 40.0);
+
+    for (int i = 0; i < threads * per_thread; i++)
+        clients.emplace_back(new client);
+    for (int t = 0; t < threads; t++) {
+        posters.emplace_back([this, &server, t] {
+            for (int i = 0; i < per_thread; i++)
+                EXPECT_TRUE(clients[t * per_thread + i]->connect(w, server.url()));
+        });
+    }
+    for (auto &t : posters)
+        t.join();
+
+    ASSERT_TRUE(ws_test_wait([this] {
+        for (auto &c : clients)
+            if (!c->opened)
+                return false;
+        return true;
+    }));
+    EXPECT_EQ(server.accepted(), threads * per_thread);
+}
+
+static std::string payload(int i, size_t size)
+{
+    std::string data = std::to_string(i) + ":";
+    data.resize(size, 'a' + i % 26);
+    return data;
+}
+
+// 对端暂时不读时写入留在会话的队列里, 之后只靠可写事件把队列发完
+TEST_P(worker, outbound_queue_drains_when_writable)
+{
+    const int n = 128;
+    std::atomic<bool> reading{false};
+    ws_test_server server([&reading](ws_test_peer &peer) {
+        while (!reading)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        ws_test_server::echo(peer);
+    });
+    clients.emplace_back(new client);
+    client *c = clients.back().get();
+    c->sndbuf = 4096;
+    ASSERT_TRUE(c->connect(w, server.url(), 64 << 10));
+    ASSERT_TRUE(ws_test_wait([c] { return c->opened.load() == 1; }));
+
+    for (int i = 0; i < n; i++)
+        ASSERT_TRUE(c->write(payload(i, 16 << 10)));
+    // 2 MB 远超过 socket 缓冲, 大部分都在队列里, 有的帧只写出去了一部分
+    EXPECT_GT(app_websocket_buffered_amount(&c->ws), 0u);
+
+    reading = true;
+    ASSERT_TRUE(ws_test_wait([c] { return c->count() == n; }, 10000)) << c->count();
+    for (int i = 0; i < n; i++)
+        ASSERT_EQ(c->messages[i], payload(i, 16 << 10));
+    EXPECT_EQ(app_websocket_buffered_amount(&c->ws), 0u);
+}
+
+// worker 在回调里自己写的数据同样排队, 由它在下一次等待前发出去, 不走命令队列
+TEST_P(worker, writes_from_the_worker_thread)
+{
+    const int n = 16;
+    std::atomic<int> matched{0};
+    ws_test_server server([&matched](ws_test_peer &peer) {
+        std::string message;
+        int opcode = 0;
+
+        for (int i = 0; i < n; i++)
+            peer.send(WEBSOCKET_BIN_FRAME, payload(i, 128 << 10));
+        for (int i = 0; i < n && peer.recv_message(opcode, message); i++)
+            matched += message == payload(i, 128 << 10);
+        ws_test_server::echo(peer);
+    });
+    clients.emplace_back(new client);
+    client *c = clients.back().get();
+    c->sndbuf = 4096;
+    c->echo = true;
+    ASSERT_TRUE(c->connect(w, server.url(), 256 << 10));
+
+    ASSERT_TRUE(ws_test_wait([&matched] { return matched.load() == n; }, 10000)) << matched.load();
+    EXPECT_TRUE(ws_test_wait([c] { return app_websocket_buffered_amount(&c->ws) == 0; }));
+}
+
+// 队列超过高水位后写入返回 -WEBSOCKET_AGAIN 且什么都不写, 降到低水位时 ondrain 只触发一次
+TEST_P(worker, watermarks_refuse_and_drain)
+{
+    const size_t high = 256 << 10, low = 64 << 10;
+    std::atomic<bool> reading{false};
+    ws_test_server server([&reading](ws_test_peer &peer) {
+        // 对端的接收缓冲不再自动增长, 不读的时候内核收下的数据远小于高水位
+        int rcvbuf = 4096;
+        setsockopt(peer.fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        while (!reading)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        ws_test_server::echo(peer);
+    });
+    clients.emplace_back(new client);
+    client *c = clients.back().get();
+    c->sndbuf = 4096;
+    ASSERT_TRUE(c->connect(w, server.url()));
+    ASSERT_EQ(app_websocket_set_watermarks(&c->ws, high, low), WEBSOCKET_OK);
+    ASSERT_TRUE(ws_test_wait([c] { return c->opened.load() == 1; }));
+
+    int written = 0;
+    while (written < 1000 && c->write(payload(written, 4096)))
+        written += 1;
+    ASSERT_LT(written, 1000);
+    size_t queued = app_websocket_buffered_amount(&c->ws);
+    EXPECT_GT(queued, high);
+
+    std::string data = payload(written, 4096);
+    struct app_websocket_frame frame = {(void *)data.data(), data.size(), WEBSOCKET_TEXT_FRAME};
+    EXPECT_EQ(app_websocket_write_data(&c->ws, &frame), -WEBSOCKET_AGAIN);
+    EXPECT_EQ(app_websocket_write_batch(&c->ws, &frame, 1), -WEBSOCKET_AGAIN);
+    EXPECT_EQ(app_websocket_buffered_amount(&c->ws), queued);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(c->drains.load(), 0);
+
+    reading = true;
+    ASSERT_TRUE(ws_test_wait([c] { return c->drains.load() == 1; }));
+    EXPECT_LE(app_websocket_buffered_amount(&c->ws), low);
+    ASSERT_TRUE(c->write(data));
+    written += 1;
+
+    ASSERT_TRUE(ws_test_wait([c, written] { return c->count() == (size_t)written; })) << c->count();
+    for (int i = 0; i < written; i++)
+        ASSERT_EQ(c->messages[i], payload(i, 4096));
+    EXPECT_EQ(c->drains.load(), 1);
+}
+
+// 放不进缓存的消息按段拼接, 不管帧怎么切, 读出来的分段都是连续写满的 64KB
+TEST_P(worker, large_messages_are_chained)
+{
+    const size_t sizes[] = {WEBSOCKET_SERVICE_CACHE_SIZE_MAX, 200000, 3 * WEBSOCKET_SERVICE_SEGMENT_SIZE};
+    ws_test_server server([&sizes](ws_test_peer &peer) {
+        std::string first = payload(0, sizes[0]), second = payload(1, sizes[1]), third = payload(2, sizes[2]);
+
+        peer.send(WEBSOCKET_TEXT_FRAME, first);
+        // 第二条切成大小不一的三片, 分界不落在段的边界上
+        peer.send(WEBSOCKET_TEXT_FRAME, second.substr(0, 1000), false);
+        peer.send(WEBSOCKET_CONTINUE_FRAME, second.substr(1000, 70000), false);
+        peer.send(WEBSOCKET_CONTINUE_FRAME, second.substr(71000), true);
+        peer.send(WEBSOCKET_BIN_FRAME, third);
+        ws_test_server::echo(peer);
+    });
+    client *c = add(server.url(), 1 << 20);
+
+    ASSERT_TRUE(ws_test_wait([c] { return c->count() == 3; }, 10000)) << c->count();
+    for (int i = 0; i < 3; i++) {
+        size_t segments = (sizes[i] + WEBSOCKET_SERVICE_SEGMENT_SIZE - 1) / WEBSOCKET_SERVICE_SEGMENT_SIZE;
+        EXPECT_TRUE(c->messages[i] == payload(i, sizes[i])) << "message " << i;
+        EXPECT_EQ(c->iovcnts[i], (int)segments) << "message " << i;
+    }
+}
+
+// 正好等于上限的消息收得下, 多一个字节连接就断开, 分片拼起来超过上限也一样
+TEST_P(worker, message_size_limit)
+{
+    const size_t limit = 100000;
+    ws_test_server whole([limit](ws_test_peer &peer) {
+        peer.send(WEBSOCKET_BIN_FRAME, payload(0, limit));
+        peer.send(WEBSOCKET_BIN_FRAME, payload(1, limit + 1));
+        ws_test_server::echo(peer);
+    });
+    ws_test_server fragmented([limit](ws_test_peer &peer) {
+        peer.send(WEBSOCKET_BIN_FRAME, payload(0, limit / 2), false);
+        peer.send(WEBSOCKET_CONTINUE_FRAME, payload(0, limit / 2), false);
+        peer.send(WEBSOCKET_CONTINUE_FRAME, "x", true);
+        ws_test_server::echo(peer);
+    });
+    client *a = add(whole.url(), limit);
+    client *b = add(fragmented.url(), limit);
+
+    ASSERT_TRUE(ws_test_wait([a, b] { return a->closed.load() == 1 && b->closed.load() == 1; }));
+    ASSERT_EQ(a->count(), 1u);
+    EXPECT_TRUE(a->messages[0] == payload(0, limit));
+    EXPECT_EQ(b->count(), 0u);
+}
+
+// 把 onfragment 收到的数据按 is_final 切回一条条消息, 同时检查一条消息内的类型不变
+static std::vector<ws_test_frame> streamed_messages(client *c)
+{
+    std::vector<ws_test_frame> messages;
+    bool open = false;
+
+    std::lock_guard<std::mutex> guard(c->lock);
+    for (auto &f : c->fragments) {
+        if (!open)
+            messages.push_back({f.opcode, false, ""});
+        EXPECT_EQ(messages.back().opcode, f.opcode);
+        messages.back().payload += f.payload;
+        messages.back().fin = f.fin;
+        open = !f.fin;
+    }
+    return messages;
+}
+
+// onfragment 按到达顺序收到每一片, 中间夹着的 ping 不打乱顺序, onmessage 一次也不触发
+TEST_P(worker, fragments_stream_in_order)
+{
+    ws_test_server server([](ws_test_peer &peer) {
+        peer.send(WEBSOCKET_TEXT_FRAME, payload(0, 100), false);
+        peer.send(WEBSOCKET_PING_FRAME, "ping");
+        peer.send(WEBSOCKET_CONTINUE_FRAME, payload(1, 20000), false);
+        peer.send(WEBSOCKET_CONTINUE_FRAME, payload(2, 5), true);
+        peer.send(WEBSOCKET_BIN_FRAME, payload(3, 300000));
+        // 最后一片是空的, 也要有一次 is_final 的调用
+        peer.send(WEBSOCKET_TEXT_FRAME, payload(4, 10), false);
+        peer.send(WEBSOCKET_CONTINUE_FRAME, "", true);
+        ws_test_server::echo(peer);
+    });
+    clients.emplace_back(new client);
+    client *c = clients.back().get();
+    c->stream = true;
+    ASSERT_TRUE(c->connect(w, server.url()));
+
+    std::vector<ws_test_frame> messages;
+    ASSERT_TRUE(ws_test_wait([c, &messages] {
+        messages = streamed_messages(c);
+        return messages.size() == 3 && messages.back().fin;
+    }, 10000));
+    EXPECT_EQ(messages[0].opcode, WEBSOCKET_TEXT_FRAME);
+    EXPECT_TRUE(messages[0].payload == payload(0, 100) + payload(1, 20000) + payload(2, 5));
+    // 超过默认上限的消息流式交付时不受限制
+    EXPECT_EQ(messages[1].opcode, WEBSOCKET_BIN_FRAME);
+    EXPECT_TRUE(messages[1].payload == payload(3, 300000));
+    EXPECT_EQ(messages[2].opcode, WEBSOCKET_TEXT_FRAME);
+    EXPECT_EQ(messages[2].payload, payload(4, 10));
+    EXPECT_EQ(c->fragments.back().payload, "");
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(c->count(), 0u);
+    EXPECT_EQ(c->closed.load(), 0);
+}
+
+// 每次打开都把尝试次数清零: 服务器握手后立刻断开, max_attempts 为 1 也能一直连回来
+TEST_P(worker, reconnect_resets_after_open)
+{
+    ws_test_server server([](ws_test_peer &) {});
+    clients.emplace_back(new client);
+    client *c = clients.back().get();
+    c->reconnect = {10, 40, 1};
+    ASSERT_TRUE(c->connect(w, server.url()));
+
+    ASSERT_TRUE(ws_test_wait([c] { return c->opened.load() >= 4; }));
+    EXPECT_EQ(c->closes.load(), 0);
+}
+
+// 尝试次数用完后会话关闭, onclose 告诉应用放弃了, 关闭原因是 1006
+TEST_P(worker, reconnect_gives_up)
+{
+    std::string url;
+    {
+        ws_test_server server;
+        url = server.url();
+    }
+    clients.emplace_back(new client);
+    client *c = clients.back().get();
+    c->reconnect = {10, 40, 2};
+    ASSERT_TRUE(c->connect(w, url));
+
+    ASSERT_TRUE(ws_test_wait([c] { return c->closes.load() == 1; }));
+    // 第一次连接失败, 再加两次重连
+    EXPECT_EQ(c->errors.load(), 3);
+
+    websocket_status_code_t code;
+    const char *reason = "";
+    app_websocket_get_close_reason(&c->ws, &code, &reason);
+    EXPECT_EQ(code, WEBSOCKET_STATUS_CLOSE_ABNORMAL);
+    EXPECT_EQ(reason, nullptr);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT_EQ(c->errors.load(), 3);
+    EXPECT_EQ(c->opened.load(), 0);
+}
+
+static long elapsed_ms(std::chrono::steady_clock::time_point since, std::chrono::steady_clock::time_point until)
+{
+    return (long)std::chrono::duration_cast<std::chrono::milliseconds>(until - since).count();
+}
+
+// 服务器只读不写: idle_ms 之后连接以 "Idle timeout!!" 失败
+TEST_P(worker, idle_timeout)
+{
+    ws_test_server server([](ws_test_peer &peer) {
+        ws_test_frame f;
+        while (peer.recv(f)) {
+        }
+    });
+    clients.emplace_back(new client);
+    client *c = clients.back().get();
+    c->timeouts = {2000, 200, 1000};
+    ASSERT_TRUE(c->connect(w, server.url()));
+    ASSERT_TRUE(ws_test_wait([c] { return c->opened.load() == 1; }));
+    ASSERT_TRUE(ws_test_wait([c] { return c->errors.load() == 1; }));
+    std::lock_guard<std::mutex> guard(c->lock);
+    EXPECT_EQ(c->error_reason, "Idle timeout!!");
+    // 时间轮的一格是 WEBSOCKET_TIMER_TICK_MS, 最多提前一格
+    EXPECT_GE(elapsed_ms(c->opened_at, c->errored_at), 200 - 20);
+    EXPECT_LT(elapsed_ms(c->opened_at, c->errored_at), 1000);
+}
+
+// 每次读到数据都把空闲的期限往后推, 服务器停下之后才超时
+TEST_P(worker, reads_push_idle_back)
+{
+    ws_test_server server([](ws_test_peer &peer) {
+        ws_test_frame f;
+        for (int i = 0; i < 10; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(60));
+            if (!peer.send(WEBSOCKET_TEXT_FRAME, "tick"))
+                return;
+        }
+        while (peer.recv(f)) {
+        }
+    });
+    clients.emplace_back(new client);
+    client *c = clients.back().get();
+    c->timeouts = {2000, 200, 1000};
+    ASSERT_TRUE(c->connect(w, server.url()));
+    ASSERT_TRUE(ws_test_wait([c] { return c->opened.load() == 1; }));
+    ASSERT_TRUE(ws_test_wait([c] { return c->errors.load() == 1; }));
+    EXPECT_EQ(c->count(), 10u);
+    std::lock_guard<std::mutex> guard(c->lock);
+    EXPECT_EQ(c->error_reason, "Idle timeout!!");
+    // 10 条消息之间间隔 60ms, 都不超过 idle_ms, 没有推后的话 200ms 就超时了
+    EXPECT_GE(elapsed_ms(c->opened_at, c->errored_at), 600);
+}
+
+// 服务器不回应 close 帧, close_ms 之后客户端自己断开, onclose 照常触发
+TEST_P(worker, close_timeout)
+{
+    std::atomic<bool> close_seen{false};
+    ws_test_server server([&close_seen](ws_test_peer &peer) {
+        ws_test_frame f;
+        while (peer.recv(f)) {
+            if (f.opcode == WEBSOCKET_CLOSE_FRAME)
+                close_seen = true;
+        }
+    });
+    clients.emplace_back(new client);
+    client *c = clients.back().get();
+    c->timeouts = {2000, 0, 300};
+    ASSERT_TRUE(c->connect(w, server.url()));
+    ASSERT_TRUE(ws_test_wait([c] { return c->opened.load() == 1; }));
+
+    auto closing = std::chrono::steady_clock::now();
+    ASSERT_EQ(app_websocket_close_server(&c->ws), WEBSOCKET_OK);
+    ASSERT_TRUE(ws_test_wait([c] { return c->closes.load() == 1; }));
+    EXPECT_TRUE(close_seen.load());
+    EXPECT_EQ(c->errors.load(), 0);
+    std::lock_guard<std::mutex> guard(c->lock);
+    EXPECT_GE(elapsed_ms(closing, c->closed_at), 300 - 20);
+    EXPECT_LT(elapsed_ms(closing, c->closed_at), 2000);
+}
+
+// 服务器接受了 TCP 连接却不回握手: 连接在 handshake_ms 之后失败, 不会一直卡住 worker
+TEST_P(worker, handshake_timeout)
+{
+    struct sockaddr_in addr = {};
+    socklen_t len = sizeof(addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    // 只 listen 不 accept, 内核替它完成 TCP 握手
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(bind(fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+    ASSERT_EQ(listen(fd, 16), 0);
+    getsockname(fd, (struct sockaddr *)&addr, &len);
+
+    clients.emplace_back(new client);
+    client *c = clients.back().get();
+    c->timeouts = {300, 0, 0};
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(c->connect(w, "ws://127.0.0.1:" + std::to_string(ntohs(addr.sin_port)) + "/"));
+
+    EXPECT_TRUE(ws_test_wait([c] { return c->errors.load() == 1; }));
+    EXPECT_EQ(c->opened.load(), 0);
+    {
+        std::lock_guard<std::mutex> guard(c->lock);
+        EXPECT_EQ(c->error_reason, "Failed to connect to the server!!");
+        EXPECT_GE(elapsed_ms(start, c->errored_at), 300 - 20);
+        EXPECT_LT(elapsed_ms(start, c->errored_at), 2000);
+    }
+    close(fd);
+}
+
+// 服务器先发出 frames, 再等客户端的帧, 记下收到的 close 状态码
+static ws_test_server::handler_t send_then_wait_close(std::vector<ws_test_frame> frames, std::atomic<int> *close_code)
+{
+    return [frames, close_code](ws_test_peer &peer) {
+        ws_test_frame f;
+        for (auto &frame : frames)
+            peer.send(frame.opcode, frame.payload, frame.fin);
+        while (peer.recv(f)) {
+            if (f.opcode == WEBSOCKET_CLOSE_FRAME && f.payload.size() >= 2)
+                *close_code = ((unsigned char)f.payload[0] << 8) | (unsigned char)f.payload[1];
+        }
+    };
+}
+
+// 分在两帧里的非法 UTF-8 文本让连接以 1007 失败, 消息不交给应用
+TEST_P(worker, utf8_invalid_text_fails_with_1007)
+{
+    std::atomic<int> close_code{0};
+    // C3 后面要跟 80..BF, 28 是 '(', 在第二帧里才看得出来
+    ws_test_server server(send_then_wait_close({{WEBSOCKET_TEXT_FRAME, false, "ok \xC3"}, {WEBSOCKET_CONTINUE_FRAME, true, "\x28"}},
+                                               &close_code));
+    clients.emplace_back(new client);
+    client *c = clients.back().get();
+    c->utf8 = true;
+    ASSERT_TRUE(c->connect(w, server.url()));
+
+    ASSERT_TRUE(ws_test_wait([c] { return c->errors.load() == 1; }));
+    EXPECT_TRUE(ws_test_wait([&close_code] { return close_code.load() != 0; }));
+    EXPECT_EQ(close_code.load(), (int)WEBSOCKET_STATUS_UNSUPPORTED_DATA);
+    EXPECT_EQ(c->count(), 0u);
+    std::lock_guard<std::mutex> guard(c->lock);
+    EXPECT_EQ(c->error_reason, "Invalid UTF-8 in text message!!");
+}
+
+// 多字节字符从中间切开分在几帧里也是合法的文本
+TEST_P(worker, utf8_split_code_point_accepted)
+{
+    std::atomic<int> close_code{0};
+    // € 是 E2 82 AC, 😀 是 F0 9F 98 80
+    ws_test_server server(send_then_wait_close({{WEBSOCKET_TEXT_FRAME, false, "price \xE2"},
+                                                {WEBSOCKET_CONTINUE_FRAME, false, "\x82"},
+                                                {WEBSOCKET_CONTINUE_FRAME, false, "\xAC 5 \xF0\x9F"},
+                                                {WEBSOCKET_CONTINUE_FRAME, true, "\x98\x80"}},
+                                               &close_code));
+    clients.emplace_back(new client);
+    client *c = clients.back().get();
+    c->utf8 = true;
+    ASSERT_TRUE(c->connect(w, server.url()));
+
+    ASSERT_TRUE(ws_test_wait([c] { return c->count() == 1; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(c->errors.load(), 0);
+    EXPECT_EQ(close_code.load(), 0);
+    std::lock_guard<std::mutex> guard(c->lock);
+    EXPECT_EQ(c->messages[0], "price \xE2\x82\xAC 5 \xF0\x9F\x98\x80");
+}
+
+// 二进制消息从不检查, 开着校验也原样交付
+TEST_P(worker, utf8_binary_not_checked)
+{
+    std::atomic<int> close_code{0};
+    ws_test_server server(send_then_wait_close({{WEBSOCKET_BIN_FRAME, true, "\xFF\xFE\xC3"},
+                                                {WEBSOCKET_BIN_FRAME, false, "\xC3"},
+                                                {WEBSOCKET_CONTINUE_FRAME, true, "\x28\xF5"}},
+                                               &close_code));
+    clients.emplace_back(new client);
+    client *c = clients.back().get();
+    c->utf8 = true;
+    ASSERT_TRUE(c->connect(w, server.url()));
+
+    ASSERT_TRUE(ws_test_wait([c] { return c->count() == 2; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(c->errors.load(), 0);
+    EXPECT_EQ(close_code.load(), 0);
+    std::lock_guard<std::mutex> guard(c->lock);
+    EXPECT_EQ(c->messages[0], "\xFF\xFE\xC3");
+    EXPECT_EQ(c->messages[1], "\xC3\x28\xF5");
+}
+
+INSTANTIATE_TEST_SUITE_P(engine, worker, ::testing::Values(APP_WEBSOCKET_ENGINE_DEFAULT, APP_WEBSOCKET_ENGINE_IO_URING));
+
+// 放置策略和负载, 这些用例自己创建 worker, 结束前全部销毁
+struct placement : public ::testing::Test
+{
+    void TearDown() override
+    {
+        app_websocket_set_worker_policy(APP_WEBSOCKET_WORKER_ROUND_ROBIN);
+        app_websocket_set_worker_select(NULL, NULL);
+        for (auto &c : clients)
+            app_websocket_disconnect_server(&c->ws);
+        for (auto w : workers) {
+            EXPECT_TRUE(ws_test_wait([w] { return app_websocket_worker_load(w) == 0; }));
+            EXPECT_EQ(app_websocket_worker_destroy(w), WEBSOCKET_OK);
+        }
+    }
+
+    struct websocket_worker *create()
+    {
+        workers.push_back(app_websocket_worker_create(NULL));
+        return workers.back();
+    }
+
+    client *add(const std::string &url)
+    {
+        clients.emplace_back(new client);
+        client *c = clients.back().get();
+        app_websocket_init(&c->ws);
+        app_websocket_set_url(&c->ws, url.c_str());
+        app_websocket_open_event(&c->ws, client::onopen);
+        EXPECT_EQ(app_websocket_connect_server(&c->ws), WEBSOCKET_OK);
+        return c;
+    }
+
+    ws_test_server server;
+    std::vector<struct websocket_worker *> workers;
+    std::vector<std::unique_ptr<client>> clients;
+};
+
+TEST_F(placement, round_robin)
+{
+    struct websocket_worker *a = create(), *b = create(), *c = create();
+
+    for (int i = 0; i < 6; i++)
+        add(server.url());
+    EXPECT_EQ(app_websocket_worker_load(a), 2);
+    EXPECT_EQ(app_websocket_worker_load(b), 2);
+    EXPECT_EQ(app_websocket_worker_load(c), 2);
+}
+
+TEST_F(placement, least_loaded)
+{
+    struct websocket_worker *a = create(), *b = create();
+
+    clients.emplace_back(new client);
+    ASSERT_TRUE(clients.back()->connect(a, server.url()));
+    clients.emplace_back(new client);
+    ASSERT_TRUE(clients.back()->connect(a, server.url()));
+
+    ASSERT_EQ(app_websocket_set_worker_policy(APP_WEBSOCKET_WORKER_LEAST_LOADED), WEBSOCKET_OK);
+    add(server.url());
+    add(server.url());
+    EXPECT_EQ(app_websocket_worker_load(a), 2);
+    EXPECT_EQ(app_websocket_worker_load(b), 2);
+    add(server.url());
+    EXPECT_EQ(app_websocket_worker_load(a) + app_websocket_worker_load(b), 5);
+}
+
+static struct websocket_worker *select_userdata(struct app_websocket *, void *userdata)
+{
+    return (struct websocket_worker *)userdata;
+}
+
+static struct websocket_worker *select_none(struct app_websocket *, void *)
+{
+    return NULL;
+}
+
+TEST_F(placement, select_callback)
+{
+    struct websocket_worker *a = create(), *b = create();
+
+    app_websocket_set_worker_select(select_userdata, b);
+    for (int i = 0; i < 3; i++)
+        add(server.url());
+    EXPECT_EQ(app_websocket_worker_load(a), 0);
+    EXPECT_EQ(app_websocket_worker_load(b), 3);
+
+    // 回调返回 NULL 时退回到放置策略
+    app_websocket_set_worker_select(select_none, NULL);
+    ASSERT_EQ(app_websocket_set_worker_policy(APP_WEBSOCKET_WORKER_LEAST_LOADED), WEBSOCKET_OK);
+    add(server.url());
+    EXPECT_EQ(app_websocket_worker_load(a), 1);
+}
+
+TEST_F(placement, load_follows_sessions)
+{
+    struct websocket_worker *a = create();
+    client *c = add(server.url());
+    client idle;
+
+    // 从没连接过的会话在 deinit 时离开 worker
+    app_websocket_init(&idle.ws);
+    ASSERT_EQ(app_websocket_set_worker(&idle.ws, a), WEBSOCKET_OK);
+    EXPECT_EQ(app_websocket_worker_load(a), 2);
+    app_websocket_deinit(&idle.ws);
+    EXPECT_EQ(app_websocket_worker_load(a), 1);
+
+    ASSERT_TRUE(ws_test_wait([c] { return c->opened.load() == 1; }));
+    EXPECT_EQ(app_websocket_worker_destroy(a), -WEBSOCKET_AGAIN);
+
+    // 断开后会话由 worker 释放, 负载归零, worker 才能销毁
+    app_websocket_disconnect_server(&c->ws);
+    clients.clear();
+    ASSERT_TRUE(ws_test_wait([a] { return app_websocket_worker_load(a) == 0; }));
+    EXPECT_EQ(app_websocket_worker_destroy(a), WEBSOCKET_OK);
+    workers.clear();
+}